@@ -0,0 +1,178 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "button_gesture.h"
+
+/* timing of the speaker, see main.c */
+#define TEST_DEBOUNCE_MS         (30)
+#define TEST_CLICK_TIMEOUT_MS    (400)
+#define TEST_LONG_PRESS_MS       (3000)
+
+#define TEST_MAX_EDGES           (16)
+#define TEST_MAX_GESTURES        (4)
+#define TEST_RUN_MS              (8000)     /* long enough for every sequence to settle */
+
+/* one raw edge, as the ISR would report it */
+typedef struct {
+    int64_t ms;
+    bool    pressed;
+} test_edge_t;
+
+/* a gesture and the window it has to be reported in */
+typedef struct {
+    button_gesture_t gesture;
+    int64_t          from_ms;
+    int64_t          to_ms;
+} test_expect_t;
+
+typedef struct {
+    const char    *name;
+    test_edge_t   edges[TEST_MAX_EDGES];
+    int           edge_num;
+    test_expect_t expect[TEST_MAX_GESTURES];
+    int           expect_num;
+} test_case_t;
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* feed the edges, poll at every deadline the engine asks for, check what comes out */
+static bool test_run(const test_case_t *tc);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const test_case_t s_cases[] = {
+    {
+        "single click",
+        {{1000, true}, {1100, false}}, 2,
+        {{BUTTON_GESTURE_CLICK, 1500, 1540}}, 1,
+    },
+    {
+        "double click",
+        {{1000, true}, {1100, false}, {1250, true}, {1350, false}}, 4,
+        {{BUTTON_GESTURE_DOUBLE_CLICK, 1750, 1790}}, 1,
+    },
+    {
+        "triple click",
+        {{1000, true}, {1080, false}, {1200, true}, {1280, false}, {1400, true}, {1480, false}}, 6,
+        {{BUTTON_GESTURE_TRIPLE_CLICK, 1880, 1920}}, 1,
+    },
+    {
+        "quad click",
+        {{1000, true}, {1080, false}, {1200, true}, {1280, false}, {1400, true}, {1480, false},
+         {1600, true}, {1680, false}}, 8,
+        {{BUTTON_GESTURE_QUAD_CLICK, 2080, 2120}}, 1,
+    },
+    {
+        "five clicks are ignored",
+        {{1000, true}, {1080, false}, {1200, true}, {1280, false}, {1400, true}, {1480, false},
+         {1600, true}, {1680, false}, {1800, true}, {1880, false}}, 10,
+        {{BUTTON_GESTURE_NONE, 0, 0}}, 0,
+    },
+    {
+        "bouncing press and release count once",
+        {{1000, true}, {1003, false}, {1006, true}, {1100, false}, {1104, true}, {1108, false}}, 6,
+        {{BUTTON_GESTURE_CLICK, 1508, 1548}}, 1,
+    },
+    {
+        "glitch shorter than the debounce time is no click",
+        {{1000, true}, {1010, false}}, 2,
+        {{BUTTON_GESTURE_NONE, 0, 0}}, 0,
+    },
+    {
+        "long press fires while held, release adds nothing",
+        {{1000, true}, {5000, false}}, 2,
+        {{BUTTON_GESTURE_LONG_PRESS, 4000, 4040}}, 1,
+    },
+    {
+        "hold just short of a long press is a click",
+        {{1000, true}, {3900, false}}, 2,
+        {{BUTTON_GESTURE_CLICK, 4300, 4340}}, 1,
+    },
+    {
+        "gap longer than the click timeout splits two clicks",
+        {{1000, true}, {1100, false}, {1600, true}, {1700, false}}, 4,
+        {{BUTTON_GESTURE_CLICK, 1500, 1540}, {BUTTON_GESTURE_CLICK, 2100, 2140}}, 2,
+    },
+    {
+        "click then long press",
+        {{1000, true}, {1100, false}, {1200, true}, {4500, false}}, 4,
+        {{BUTTON_GESTURE_LONG_PRESS, 4200, 4240}}, 1,
+    },
+};
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static bool test_run(const test_case_t *tc)
+{
+    const button_gesture_config_t cfg = {
+        .debounce_ms = TEST_DEBOUNCE_MS,
+        .click_timeout_ms = TEST_CLICK_TIMEOUT_MS,
+        .long_press_ms = TEST_LONG_PRESS_MS,
+    };
+    button_gesture_engine_t engine;
+    int edge = 0;
+    int seen = 0;
+    bool ok = true;
+
+    button_gesture_init(&engine, &cfg);
+    /* wake up like the button task: on an edge or at the deadline, whichever comes first */
+    for (int64_t now = 0; now <= TEST_RUN_MS;) {
+        if (edge < tc->edge_num && tc->edges[edge].ms == now) {
+            button_gesture_edge(&engine, tc->edges[edge].pressed, now);
+            edge++;
+        }
+        button_gesture_t g = button_gesture_poll(&engine, now);
+        if (g != BUTTON_GESTURE_NONE) {
+            if (seen >= tc->expect_num) {
+                printf("FAIL %s: unexpected gesture %d at %lld ms\n", tc->name, g, (long long)now);
+                ok = false;
+            } else if (g != tc->expect[seen].gesture || now < tc->expect[seen].from_ms || now > tc->expect[seen].to_ms) {
+                printf("FAIL %s: gesture %d at %lld ms, expected %d in %lld ~ %lld ms\n", tc->name, g, (long long)now,
+                       tc->expect[seen].gesture, (long long)tc->expect[seen].from_ms, (long long)tc->expect[seen].to_ms);
+                ok = false;
+            }
+            seen++;
+        }
+
+        int64_t next = button_gesture_next_deadline(&engine);
+        if (edge < tc->edge_num && (next < 0 || tc->edges[edge].ms < next)) {
+            next = tc->edges[edge].ms;
+        }
+        if (next < 0) {
+            break;
+        }
+        /* the timer never fires in the past, at least 1 ms later */
+        now = (next > now) ? next : now + 1;
+    }
+    if (seen < tc->expect_num) {
+        printf("FAIL %s: %d of %d gestures reported\n", tc->name, seen, tc->expect_num);
+        ok = false;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    int failed = 0;
+    int num = sizeof(s_cases) / sizeof(s_cases[0]);
+
+    for (int i = 0; i < num; i++) {
+        if (!test_run(&s_cases[i])) {
+            failed++;
+        }
+    }
+    printf("%d of %d gesture cases passed\n", num - failed, num);
+    return failed ? 1 : 0;
+}
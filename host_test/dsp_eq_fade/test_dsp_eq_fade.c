@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "dsp_eq.h"
+
+/* the audio path as audio_dsp_process runs it */
+#define TEST_RATE            (44100)
+#define TEST_CH              (2)
+#define TEST_CHUNK           (128)      /* AUDIO_DSP_CHUNK, samples per dsp_eq_process call */
+#define TEST_AMPLITUDE       (12000.0f)
+
+#define TEST_SETTLE_FRAMES   (350 * TEST_CHUNK / TEST_CH)     /* ~0.5 s before the swap, filters at rest */
+#define TEST_RUN_FRAMES      (700 * TEST_CHUNK / TEST_CH)     /* ~1 s after it */
+#define TEST_STEP_MARGIN     (1.05f)
+
+/* an EQ before and after a preset swap, and the tone it plays */
+typedef struct {
+    const char    *name;
+    dsp_eq_band_t old_bands[DSP_EQ_MAX_BANDS];
+    int           old_n;
+    dsp_eq_band_t new_bands[DSP_EQ_MAX_BANDS];
+    int           new_n;
+    float         freq_hz;
+} test_case_t;
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* play a sine, swap the EQ and check no sample to sample step exceeds what the sine makes on its own */
+static bool test_run(const test_case_t *tc);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const test_case_t s_cases[] = {
+    {
+        /* home to night on the mid band */
+        "peak added",
+        {{0}}, 0,
+        {{DSP_EQ_PEAK, 2500.0f, 2.0f, 1.0f}}, 1,
+        2500.0f,
+    },
+    {
+        /* outdoor to home on the bass band, the slowest filter there is */
+        "low shelf removed",
+        {{DSP_EQ_LOW_SHELF, 80.0f, 4.0f, 0.707f}}, 1,
+        {{0}}, 0,
+        60.0f,
+    },
+    {
+        "first of two bands turned off, the second moves up a section",
+        {{DSP_EQ_PEAK, 1000.0f, 6.0f, 2.0f}, {DSP_EQ_LOW_SHELF, 100.0f, -6.0f, 0.707f}}, 2,
+        {{DSP_EQ_OFF, 1000.0f, 6.0f, 2.0f}, {DSP_EQ_LOW_SHELF, 100.0f, -6.0f, 0.707f}}, 2,
+        120.0f,
+    },
+    {
+        "large cut to a large boost",
+        {{DSP_EQ_PEAK, 200.0f, -12.0f, 1.4f}}, 1,
+        {{DSP_EQ_PEAK, 200.0f, 9.0f, 1.4f}}, 1,
+        200.0f,
+    },
+};
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static bool test_run(const test_case_t *tc)
+{
+    static dsp_eq_cache_t cache_old;
+    static dsp_eq_cache_t cache_new;
+    static dsp_eq_t eq;
+    int32_t buf[TEST_CHUNK];
+    float w = 2.0f * 3.14159265f * tc->freq_hz / TEST_RATE;
+    size_t total = TEST_SETTLE_FRAMES + TEST_RUN_FRAMES;
+    size_t swap = TEST_SETTLE_FRAMES;
+    int32_t prev = 0;
+    int32_t step_old = 0;
+    int32_t step_new = 0;
+    int32_t step_fade = 0;
+    int32_t peak_new = 0;
+    bool ok = true;
+
+    dsp_eq_cache_build(&cache_old, tc->old_bands, tc->old_n);
+    dsp_eq_cache_build(&cache_new, tc->new_bands, tc->new_n);
+    dsp_eq_init(&eq);
+    dsp_eq_select(&eq, &cache_old, TEST_RATE, TEST_CH);
+
+    for (size_t frame = 0; frame < total; frame += TEST_CHUNK / TEST_CH) {
+        if (frame == swap) {
+            dsp_eq_select(&eq, &cache_new, TEST_RATE, TEST_CH);
+        }
+        for (int i = 0; i < TEST_CHUNK / TEST_CH; i++) {
+            int32_t x = (int32_t)lrintf(TEST_AMPLITUDE * sinf(w * (float)(frame + i)));
+            buf[TEST_CH * i] = x;
+            buf[TEST_CH * i + 1] = x;
+        }
+        dsp_eq_process(&eq, buf, TEST_CHUNK);
+        if (frame == swap && eq.fade_left != DSP_EQ_FADE_FRAMES - TEST_CHUNK / TEST_CH) {
+            printf("FAIL %s: fade did not carry over into the next chunk\n", tc->name);
+            ok = false;
+        }
+
+        for (int i = 0; i < TEST_CHUNK / TEST_CH; i++) {
+            size_t f = frame + i;
+            int32_t y = buf[TEST_CH * i];
+            int32_t step = abs(y - prev);
+            prev = y;
+            if (buf[TEST_CH * i + 1] != y) {
+                printf("FAIL %s: channels differ at frame %zu\n", tc->name, f);
+                return false;
+            }
+            /* the last half second of each part is steady state */
+            if (f >= swap / 2 && f < swap) {
+                step_old = (step > step_old) ? step : step_old;
+            } else if (f >= swap && f < swap + DSP_EQ_FADE_FRAMES) {
+                step_fade = (step > step_fade) ? step : step_fade;
+            } else if (f >= total - TEST_RUN_FRAMES / 2) {
+                step_new = (step > step_new) ? step : step_new;
+                peak_new = (abs(y) > peak_new) ? abs(y) : peak_new;
+            }
+        }
+    }
+    /* a click shows up as a step far beyond the steepest slope of either steady tone */
+    int32_t bound = (int32_t)((float)((step_old > step_new) ? step_old : step_new) * TEST_STEP_MARGIN) + 2;
+    if (step_fade > bound) {
+        printf("FAIL %s: step %d during the swap, steady state at most %d\n", tc->name, (int)step_fade, (int)bound);
+        ok = false;
+    }
+    if (peak_new == 0) {
+        printf("FAIL %s: no output after the swap\n", tc->name);
+        ok = false;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    int failed = 0;
+    int num = sizeof(s_cases) / sizeof(s_cases[0]);
+
+    for (int i = 0; i < num; i++) {
+        if (!test_run(&s_cases[i])) {
+            failed++;
+        }
+    }
+    printf("%d of %d EQ swap cases passed\n", num - failed, num);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,267 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "app_ctrl.h"
+
+#define APP_CTRL_MAX_DONE_CBS    (4)
+
+typedef struct {
+    uint32_t          id;        /* 0 when the slot was never used */
+    app_ctrl_cmd_t    cmd;
+    int32_t           arg;
+    app_ctrl_status_t status;
+} app_ctrl_slot_t;
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* handler for control task */
+static void app_ctrl_task_handler(void *arg);
+/* repeating this command has no further effect */
+static bool app_ctrl_is_idempotent(app_ctrl_cmd_t cmd);
+/* oldest queued slot, NULL if none (call with lock held) */
+static app_ctrl_slot_t *app_ctrl_next_queued(void);
+/* newest queued slot, NULL if none (call with lock held) */
+static app_ctrl_slot_t *app_ctrl_last_queued(void);
+/* slot of the command being executed, NULL if none (call with lock held) */
+static app_ctrl_slot_t *app_ctrl_running(void);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const char *s_cmd_str[] = {"none", "power_on", "power_off", "power_toggle", "mode_party", "mode_home",
+                                  "mode_toggle", "play_pause", "next_track", "prev_track", "volume_set", "volume_step",
+                                  "preset_select", "preset_next", "preset_store"};
+static const char *s_status_str[] = {"unknown", "queued", "running", "done", "failed", "superseded"};
+
+static portMUX_TYPE s_ctrl_lock = portMUX_INITIALIZER_UNLOCKED;
+static app_ctrl_slot_t s_slots[APP_CTRL_SLOTS];
+static uint32_t s_next_id = 1;
+static TaskHandle_t s_ctrl_task_handle = NULL;      /* handle of control task */
+static app_ctrl_handler_t s_handler = NULL;
+static app_ctrl_done_cb_t s_done_cbs[APP_CTRL_MAX_DONE_CBS];
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static bool app_ctrl_is_idempotent(app_ctrl_cmd_t cmd)
+{
+    switch (cmd) {
+    case APP_CTRL_CMD_POWER_ON:
+    case APP_CTRL_CMD_POWER_OFF:
+    case APP_CTRL_CMD_MODE_PARTY:
+    case APP_CTRL_CMD_MODE_HOME:
+    case APP_CTRL_CMD_PRESET_SELECT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static app_ctrl_slot_t *app_ctrl_next_queued(void)
+{
+    app_ctrl_slot_t *next = NULL;
+
+    for (int i = 0; i < APP_CTRL_SLOTS; i++) {
+        if (s_slots[i].status == APP_CTRL_STATUS_QUEUED &&
+            (next == NULL || s_slots[i].id < next->id)) {
+            next = &s_slots[i];
+        }
+    }
+    return next;
+}
+
+static app_ctrl_slot_t *app_ctrl_last_queued(void)
+{
+    app_ctrl_slot_t *last = NULL;
+
+    for (int i = 0; i < APP_CTRL_SLOTS; i++) {
+        if (s_slots[i].status == APP_CTRL_STATUS_QUEUED &&
+            (last == NULL || s_slots[i].id > last->id)) {
+            last = &s_slots[i];
+        }
+    }
+    return last;
+}
+
+static app_ctrl_slot_t *app_ctrl_running(void)
+{
+    for (int i = 0; i < APP_CTRL_SLOTS; i++) {
+        if (s_slots[i].status == APP_CTRL_STATUS_RUNNING) {
+            return &s_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static void app_ctrl_task_handler(void *arg)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for (;;) {
+            app_ctrl_slot_t cur;
+
+            portENTER_CRITICAL(&s_ctrl_lock);
+            app_ctrl_slot_t *slot = app_ctrl_next_queued();
+            if (slot != NULL) {
+                slot->status = APP_CTRL_STATUS_RUNNING;
+                cur = *slot;
+            }
+            portEXIT_CRITICAL(&s_ctrl_lock);
+            if (slot == NULL) {
+                break;
+            }
+
+            ESP_LOGI(APP_CTRL_TAG, "#%" PRIu32 " %s(%" PRId32 ") running", cur.id, app_ctrl_cmd_str(cur.cmd), cur.arg);
+            bool ok = s_handler ? s_handler(cur.cmd, cur.arg) : false;
+            app_ctrl_status_t status = ok ? APP_CTRL_STATUS_DONE : APP_CTRL_STATUS_FAILED;
+
+            portENTER_CRITICAL(&s_ctrl_lock);
+            /* the slot cannot be reused while running, so it still holds this command */
+            slot->status = status;
+            portEXIT_CRITICAL(&s_ctrl_lock);
+
+            ESP_LOGI(APP_CTRL_TAG, "#%" PRIu32 " %s %s", cur.id, app_ctrl_cmd_str(cur.cmd), app_ctrl_status_str(status));
+            for (int i = 0; i < APP_CTRL_MAX_DONE_CBS; i++) {
+                if (s_done_cbs[i]) {
+                    s_done_cbs[i](cur.id, cur.cmd, status);
+                }
+            }
+        }
+    }
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void app_ctrl_start_up(app_ctrl_handler_t handler)
+{
+    s_handler = handler;
+    if (s_ctrl_task_handle == NULL) {
+        /* power commands bring up and tear down the whole Bluetooth stack in this task */
+        xTaskCreate(app_ctrl_task_handler, "AppCtrlTask", 4096, NULL, 6, &s_ctrl_task_handle);
+    }
+}
+
+uint32_t app_ctrl_submit(app_ctrl_cmd_t cmd, int32_t arg)
+{
+    uint32_t id = 0;
+    app_ctrl_slot_t *free_slot = NULL;
+
+    if (cmd == APP_CTRL_CMD_NONE || (unsigned)cmd >= APP_CTRL_CMD_MAX) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&s_ctrl_lock);
+    /* only the newest queued command can absorb this one, anything older would change the order */
+    app_ctrl_slot_t *tail = app_ctrl_last_queued();
+    app_ctrl_slot_t *running = app_ctrl_running();
+    if (tail != NULL && tail->cmd == cmd) {
+        if (cmd == APP_CTRL_CMD_VOLUME_SET) {
+            tail->arg = arg;
+            id = tail->id;
+        } else if (cmd == APP_CTRL_CMD_VOLUME_STEP) {
+            tail->arg += arg;
+            id = tail->id;
+        } else if (tail->arg == arg && app_ctrl_is_idempotent(cmd)) {
+            id = tail->id;
+        }
+    } else if (tail == NULL && running != NULL && running->cmd == cmd && running->arg == arg &&
+               app_ctrl_is_idempotent(cmd)) {
+        id = running->id;
+    }
+
+    if (id == 0) {
+        if (app_ctrl_is_idempotent(cmd) || cmd == APP_CTRL_CMD_VOLUME_SET) {
+            /* this one overrides older queued ones of its kind, they would only run to be undone */
+            for (int i = 0; i < APP_CTRL_SLOTS; i++) {
+                if (s_slots[i].cmd == cmd && s_slots[i].status == APP_CTRL_STATUS_QUEUED) {
+                    s_slots[i].status = APP_CTRL_STATUS_SUPERSEDED;
+                }
+            }
+        }
+        /* reuse the oldest finished slot */
+        for (int i = 0; i < APP_CTRL_SLOTS; i++) {
+            app_ctrl_slot_t *slot = &s_slots[i];
+            if (slot->status != APP_CTRL_STATUS_QUEUED && slot->status != APP_CTRL_STATUS_RUNNING &&
+                (free_slot == NULL || slot->id < free_slot->id)) {
+                free_slot = slot;
+            }
+        }
+    }
+
+    if (id == 0 && free_slot != NULL) {
+        id = s_next_id++;
+        if (s_next_id == 0) {
+            s_next_id = 1;
+        }
+        free_slot->id = id;
+        free_slot->cmd = cmd;
+        free_slot->arg = arg;
+        free_slot->status = APP_CTRL_STATUS_QUEUED;
+    }
+    portEXIT_CRITICAL(&s_ctrl_lock);
+
+    if (id == 0) {
+        ESP_LOGW(APP_CTRL_TAG, "%s, queue full, %s dropped", __func__, app_ctrl_cmd_str(cmd));
+        return 0;
+    }
+    if (s_ctrl_task_handle) {
+        xTaskNotifyGive(s_ctrl_task_handle);
+    }
+    return id;
+}
+
+app_ctrl_status_t app_ctrl_get_status(uint32_t id)
+{
+    app_ctrl_status_t status = APP_CTRL_STATUS_UNKNOWN;
+
+    if (id == 0) {
+        return status;
+    }
+    portENTER_CRITICAL(&s_ctrl_lock);
+    for (int i = 0; i < APP_CTRL_SLOTS; i++) {
+        if (s_slots[i].id == id) {
+            status = s_slots[i].status;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_ctrl_lock);
+    return status;
+}
+
+bool app_ctrl_register_done_cb(app_ctrl_done_cb_t cb)
+{
+    for (int i = 0; i < APP_CTRL_MAX_DONE_CBS; i++) {
+        if (s_done_cbs[i] == NULL || s_done_cbs[i] == cb) {
+            s_done_cbs[i] = cb;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *app_ctrl_cmd_str(app_ctrl_cmd_t cmd)
+{
+    return ((unsigned)cmd < APP_CTRL_CMD_MAX) ? s_cmd_str[cmd] : s_cmd_str[0];
+}
+
+const char *app_ctrl_status_str(app_ctrl_status_t status)
+{
+    return ((unsigned)status < APP_CTRL_STATUS_MAX) ? s_status_str[status] : s_status_str[0];
+}
@@ -0,0 +1,123 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __APP_CTRL_H__
+#define __APP_CTRL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* log tag */
+#define APP_CTRL_TAG    "APP_CTRL"
+
+/* number of commands tracked at once, queued and recently completed */
+#define APP_CTRL_SLOTS    (16)
+
+/* control plane commands */
+typedef enum {
+    APP_CTRL_CMD_NONE = 0,
+    APP_CTRL_CMD_POWER_ON,
+    APP_CTRL_CMD_POWER_OFF,
+    APP_CTRL_CMD_POWER_TOGGLE,
+    APP_CTRL_CMD_MODE_PARTY,
+    APP_CTRL_CMD_MODE_HOME,
+    APP_CTRL_CMD_MODE_TOGGLE,
+    APP_CTRL_CMD_PLAY_PAUSE,
+    APP_CTRL_CMD_NEXT_TRACK,
+    APP_CTRL_CMD_PREV_TRACK,
+    APP_CTRL_CMD_VOLUME_SET,       /*!< arg: absolute volume 0 ~ 127 */
+    APP_CTRL_CMD_VOLUME_STEP,      /*!< arg: signed volume change */
+    APP_CTRL_CMD_PRESET_SELECT,    /*!< arg: audio_preset_id_t */
+    APP_CTRL_CMD_PRESET_NEXT,
+    APP_CTRL_CMD_PRESET_STORE,     /*!< arg: audio_preset_id_t to overwrite */
+    APP_CTRL_CMD_MAX,
+} app_ctrl_cmd_t;
+
+/* life cycle of a submitted command */
+typedef enum {
+    APP_CTRL_STATUS_UNKNOWN = 0,   /*!< never submitted or already evicted */
+    APP_CTRL_STATUS_QUEUED,
+    APP_CTRL_STATUS_RUNNING,
+    APP_CTRL_STATUS_DONE,
+    APP_CTRL_STATUS_FAILED,
+    APP_CTRL_STATUS_SUPERSEDED,    /*!< dropped from the queue for a later command of its kind */
+    APP_CTRL_STATUS_MAX,
+} app_ctrl_status_t;
+
+/**
+ * @brief  executes one command in the control task
+ *
+ * @param [in] cmd  command
+ * @param [in] arg  command argument
+ *
+ * @return  true if the command succeeded
+ */
+typedef bool (* app_ctrl_handler_t) (app_ctrl_cmd_t cmd, int32_t arg);
+
+/**
+ * @brief  completion notification, called from the control task
+ *
+ * @param [in] id      command ID returned by app_ctrl_submit
+ * @param [in] cmd     command
+ * @param [in] status  APP_CTRL_STATUS_DONE or APP_CTRL_STATUS_FAILED
+ */
+typedef void (* app_ctrl_done_cb_t) (uint32_t id, app_ctrl_cmd_t cmd, app_ctrl_status_t status);
+
+/**
+ * @brief  start up the control task
+ *
+ * @param [in] handler  command executor
+ */
+void app_ctrl_start_up(app_ctrl_handler_t handler);
+
+/**
+ * @brief  queue a command without waiting for it to run
+ *
+ *         Commands run in the order they were submitted. One of the same kind
+ *         as the newest queued command is collapsed into it: volume sets keep
+ *         the latest value, volume steps are summed, and repeats of an
+ *         idempotent command (power on/off, mode and preset select) share its
+ *         ID; toggles, skips and play/pause always run as often as submitted.
+ *         Idempotent commands also join a running one when nothing is
+ *         queued. These and volume sets otherwise
+ *         go to the end of the queue and supersede older queued ones of their kind.
+ *
+ * @param [in] cmd  command
+ * @param [in] arg  command argument
+ *
+ * @return  command ID, 0 if the queue is full
+ */
+uint32_t app_ctrl_submit(app_ctrl_cmd_t cmd, int32_t arg);
+
+/**
+ * @brief  status of a submitted command
+ *
+ * @param [in] id  command ID
+ *
+ * @return  current status, APP_CTRL_STATUS_UNKNOWN once the slot was reused
+ */
+app_ctrl_status_t app_ctrl_get_status(uint32_t id);
+
+/**
+ * @brief  register a completion callback
+ *
+ * @param [in] cb  callback
+ *
+ * @return  true if registered, false if all callback slots are used
+ */
+bool app_ctrl_register_done_cb(app_ctrl_done_cb_t cb);
+
+/**
+ * @brief  name of a command, for logs and the web API
+ */
+const char *app_ctrl_cmd_str(app_ctrl_cmd_t cmd);
+
+/**
+ * @brief  name of a status, for logs and the web API
+ */
+const char *app_ctrl_status_str(app_ctrl_status_t status);
+
+#endif /* __APP_CTRL_H__ */
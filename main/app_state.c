@@ -0,0 +1,210 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "app_state.h"
+
+#define APP_STATE_MAX_CBS    (4)
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* publish a new state, returns the change mask (call with write lock held) */
+static uint32_t app_state_publish(const app_state_t *next);
+/* run the change callbacks */
+static void app_state_notify(uint32_t changed, const app_state_t *state);
+/* clamp a band gain to 0 ~ 1 */
+static float app_state_clamp_gain(float gain);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static portMUX_TYPE s_write_lock = portMUX_INITIALIZER_UNLOCKED;   /* serialises writers */
+static uint32_t s_seq = 0;                                        /* odd while a writer publishes */
+static app_state_t s_state = {
+    .version = 0,
+    .system_on = false,
+    .party_mode = false,
+    .preset = APP_STATE_DEFAULT_PRESET,
+    .is_playing = false,
+    .volume = APP_STATE_DEFAULT_VOLUME,
+    .volume_bass = APP_STATE_HOME_BAND_GAIN,
+    .volume_mid = APP_STATE_HOME_BAND_GAIN,
+};
+static app_state_cb_t s_cbs[APP_STATE_MAX_CBS];
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static uint32_t app_state_publish(const app_state_t *next)
+{
+    uint32_t changed = 0;
+
+    if (next->system_on != s_state.system_on) {
+        changed |= APP_STATE_F_POWER;
+    }
+    if (next->party_mode != s_state.party_mode || next->preset != s_state.preset) {
+        changed |= APP_STATE_F_MODE;
+    }
+    if (next->is_playing != s_state.is_playing) {
+        changed |= APP_STATE_F_PLAY;
+    }
+    if (next->volume != s_state.volume) {
+        changed |= APP_STATE_F_VOLUME;
+    }
+    if (next->volume_bass != s_state.volume_bass || next->volume_mid != s_state.volume_mid) {
+        changed |= APP_STATE_F_BAND_GAIN;
+    }
+    if (changed == 0) {
+        return 0;
+    }
+
+    uint32_t version = s_state.version + 1;
+    __atomic_store_n(&s_seq, s_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    s_state = *next;
+    s_state.version = version;
+    __atomic_store_n(&s_seq, s_seq + 1, __ATOMIC_RELEASE);
+    return changed;
+}
+
+static void app_state_notify(uint32_t changed, const app_state_t *state)
+{
+    if (changed == 0) {
+        return;
+    }
+    for (int i = 0; i < APP_STATE_MAX_CBS; i++) {
+        if (s_cbs[i]) {
+            s_cbs[i](changed, state);
+        }
+    }
+}
+
+static float app_state_clamp_gain(float gain)
+{
+    if (gain < 0.0f) {
+        return 0.0f;
+    }
+    if (gain > 1.0f) {
+        return 1.0f;
+    }
+    return gain;
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void app_state_read(app_state_t *state)
+{
+    for (;;) {
+        uint32_t seq = __atomic_load_n(&s_seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue;
+        }
+        memcpy(state, &s_state, sizeof(*state));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s_seq, __ATOMIC_RELAXED) == seq) {
+            return;
+        }
+    }
+}
+
+uint32_t app_state_seq(void)
+{
+    return __atomic_load_n(&s_seq, __ATOMIC_ACQUIRE);
+}
+
+void app_state_set_power(bool on)
+{
+    app_state_t next;
+
+    portENTER_CRITICAL(&s_write_lock);
+    next = s_state;
+    next.system_on = on;
+    uint32_t changed = app_state_publish(&next);
+    next = s_state;
+    portEXIT_CRITICAL(&s_write_lock);
+    app_state_notify(changed, &next);
+}
+
+void app_state_set_preset(uint8_t preset, bool party, float bass, float mid)
+{
+    app_state_t next;
+
+    portENTER_CRITICAL(&s_write_lock);
+    next = s_state;
+    next.preset = preset;
+    next.party_mode = party;
+    next.volume_bass = app_state_clamp_gain(bass);
+    next.volume_mid = app_state_clamp_gain(mid);
+    uint32_t changed = app_state_publish(&next);
+    next = s_state;
+    portEXIT_CRITICAL(&s_write_lock);
+    app_state_notify(changed, &next);
+}
+
+void app_state_set_playing(bool playing)
+{
+    app_state_t next;
+
+    portENTER_CRITICAL(&s_write_lock);
+    next = s_state;
+    next.is_playing = playing;
+    uint32_t changed = app_state_publish(&next);
+    next = s_state;
+    portEXIT_CRITICAL(&s_write_lock);
+    app_state_notify(changed, &next);
+}
+
+void app_state_set_volume(int volume)
+{
+    app_state_t next;
+
+    if (volume < 0) {
+        volume = 0;
+    } else if (volume > 127) {
+        volume = 127;
+    }
+    portENTER_CRITICAL(&s_write_lock);
+    next = s_state;
+    next.volume = (uint8_t)volume;
+    uint32_t changed = app_state_publish(&next);
+    next = s_state;
+    portEXIT_CRITICAL(&s_write_lock);
+    app_state_notify(changed, &next);
+}
+
+void app_state_set_band_gains(float bass, float mid)
+{
+    app_state_t next;
+
+    portENTER_CRITICAL(&s_write_lock);
+    next = s_state;
+    next.volume_bass = app_state_clamp_gain(bass);
+    next.volume_mid = app_state_clamp_gain(mid);
+    uint32_t changed = app_state_publish(&next);
+    next = s_state;
+    portEXIT_CRITICAL(&s_write_lock);
+    app_state_notify(changed, &next);
+}
+
+bool app_state_register_cb(app_state_cb_t cb)
+{
+    for (int i = 0; i < APP_STATE_MAX_CBS; i++) {
+        if (s_cbs[i] == NULL || s_cbs[i] == cb) {
+            s_cbs[i] = cb;
+            return true;
+        }
+    }
+    return false;
+}
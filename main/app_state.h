@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __APP_STATE_H__
+#define __APP_STATE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* log tag */
+#define APP_STATE_TAG    "APP_STATE"
+
+/* per band output gains of the party and home presets */
+#define APP_STATE_PARTY_BAND_GAIN    (1.0f)
+#define APP_STATE_HOME_BAND_GAIN     (0.3f)
+
+/* initial AVRCP volume */
+#define APP_STATE_DEFAULT_VOLUME     (100)
+
+/* preset until one is selected, AUDIO_PRESET_HOME */
+#define APP_STATE_DEFAULT_PRESET     (1)
+
+/* change mask bits passed to the notification callbacks */
+#define APP_STATE_F_POWER        (1 << 0)
+#define APP_STATE_F_MODE         (1 << 1)
+#define APP_STATE_F_PLAY         (1 << 2)
+#define APP_STATE_F_VOLUME       (1 << 3)
+#define APP_STATE_F_BAND_GAIN    (1 << 4)
+
+/* state shared between the audio path, control task, AVRCP handlers and web server */
+typedef struct {
+    uint32_t version;        /*!< bumped on every published change */
+    bool     system_on;
+    bool     party_mode;     /*!< the party LED is lit */
+    uint8_t  preset;         /*!< selected sound preset, audio_preset_id_t */
+    bool     is_playing;
+    uint8_t  volume;         /*!< AVRCP absolute volume 0 ~ 127 */
+    float    volume_bass;    /*!< bass band gain 0 ~ 1 */
+    float    volume_mid;     /*!< mid band gain 0 ~ 1 */
+} app_state_t;
+
+/**
+ * @brief  change notification, called in the context of the setter after publication
+ *
+ * @param [in] changed  mask of APP_STATE_F_* bits that changed
+ * @param [in] state    state as published by this change
+ */
+typedef void (* app_state_cb_t) (uint32_t changed, const app_state_t *state);
+
+/**
+ * @brief  take a consistent copy of the state
+ *
+ *         Lock free: retries while a writer is publishing, so it is safe in the
+ *         audio path and never blocks a writer.
+ *
+ * @param [out] state  snapshot
+ */
+void app_state_read(app_state_t *state);
+
+/**
+ * @brief  publication counter, changes whenever the state does
+ *
+ *         Cheaper than app_state_read for a reader that only needs to know
+ *         whether anything changed since it last looked.
+ */
+uint32_t app_state_seq(void);
+
+/**
+ * @brief  set the power state
+ */
+void app_state_set_power(bool on);
+
+/**
+ * @brief  publish a preset selection together with its band gains, clamped to 0 ~ 1
+ *
+ * @param [in] preset  selected preset
+ * @param [in] party   the preset counts as party mode
+ * @param [in] bass    bass band gain
+ * @param [in] mid     mid band gain
+ */
+void app_state_set_preset(uint8_t preset, bool party, float bass, float mid);
+
+/**
+ * @brief  set the play state as reported by the source or toggled locally
+ */
+void app_state_set_playing(bool playing);
+
+/**
+ * @brief  set the AVRCP volume, clamped to 0 ~ 127
+ */
+void app_state_set_volume(int volume);
+
+/**
+ * @brief  set the per band output gains, clamped to 0 ~ 1
+ */
+void app_state_set_band_gains(float bass, float mid);
+
+/**
+ * @brief  register a change notification callback
+ *
+ * @param [in] cb  callback
+ *
+ * @return  true if registered, false if all callback slots are used
+ */
+bool app_state_register_cb(app_state_cb_t cb);
+
+#endif /* __APP_STATE_H__ */
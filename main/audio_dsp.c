@@ -0,0 +1,938 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_cpu.h"
+#include "sdkconfig.h"
+#include "app_state.h"
+#include "dsp_gain.h"
+#include "dsp_limiter.h"
+#include "dsp_eq.h"
+#include "dsp_delay.h"
+#include "dsp_resample.h"
+#include "audio_dsp.h"
+#include "pcm_tap.h"
+#include "mem_telemetry.h"
+#include "json_writer.h"
+
+#define AUDIO_DSP_CHUNK            (128)     /* samples per pass through the band stages */
+#define AUDIO_DSP_SWAP_WAIT_MS     (50)      /* how long a writer waits for the audio path to take a set */
+#define AUDIO_DSP_DEFAULT_XOVER    (285.0f)  /* the former fixed one-pole coefficient 0.04 at 44.1 kHz */
+#define AUDIO_DSP_DEFAULT_XOVER_HIGH (3000.0f)
+#define AUDIO_DSP_NUM_XOVERS       (AUDIO_DSP_NUM_BANDS - 1)
+#define AUDIO_DSP_FALLBACK_RATE    (2)       /* rate index used for streams at an uncached rate, 44.1 kHz */
+#define AUDIO_DSP_DELAY_MAX_FRAMES ((uint32_t)(AUDIO_DSP_DELAY_MAX_MS * 48000 / 1000 + 1))  /* at the highest cached rate */
+#define AUDIO_DSP_BASS_DECIM       (CONFIG_EXAMPLE_BASS_DECIMATION)
+#define AUDIO_DSP_BASS_LOW_LEN     (AUDIO_DSP_CHUNK / 2 + 1)    /* low rate samples a chunk can produce */
+#define AUDIO_DSP_CYCLES_SHIFT     (4)       /* cycles per frame are kept in Q4, averaged over 16 blocks */
+#if CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_INTERNAL_DAC
+#define AUDIO_DSP_LAYOUT_DEFAULT   (AUDIO_DSP_LAYOUT_MONO_2WAY)   /* the DAC plays the left slot of each port */
+#else
+#define AUDIO_DSP_LAYOUT_DEFAULT   (AUDIO_DSP_LAYOUT_2WAY)
+#endif
+
+#if (AUDIO_DSP_BASS_DECIM & (AUDIO_DSP_BASS_DECIM - 1)) != 0 || AUDIO_DSP_BASS_DECIM > DSP_RESAMPLE_MAX_FACTOR
+#error "CONFIG_EXAMPLE_BASS_DECIMATION must be 1, 2, 4 or 8"
+#endif
+
+/* how the bands reach the ports, chosen when a set is built */
+typedef enum {
+    AUDIO_DSP_PATH_DIRECT = 0,    /* 2-way layout, the bands are written straight into the ports */
+    AUDIO_DSP_PATH_3WAY,          /* 3-way layout, one pass over the three bands */
+    AUDIO_DSP_PATH_MATRIX,        /* anything else, slot by slot */
+} audio_dsp_path_t;
+
+/* splits a chunk into band chunks with the band gains applied, returns the input peak */
+typedef int32_t (*audio_dsp_split_fn_t)(const int16_t *in, size_t n);
+
+/* one specialisation of the split */
+typedef struct {
+    audio_dsp_split_fn_t fn;
+    const char           *name;
+} audio_dsp_kernel_t;
+
+/* a parameter set with everything the audio path needs precomputed for every rate */
+typedef struct {
+    uint32_t           gen;                                            /*!< bumped on every publication */
+    audio_dsp_params_t params;
+    uint8_t            path;                                           /*!< audio_dsp_path_t */
+    bool               bass_decim;                                     /*!< bass runs mono at the low rate */
+    float              xover_alpha[AUDIO_DSP_NUM_XOVERS][DSP_EQ_NUM_RATES];
+    float              trim[AUDIO_DSP_NUM_BANDS];                      /*!< linear band trim */
+    int32_t            limiter_threshold;
+    uint32_t           delay_q8[AUDIO_DSP_NUM_BANDS][DSP_EQ_NUM_RATES];     /*!< frames, DSP_DELAY_FRAC_BITS */
+    dsp_eq_cache_t     eq[AUDIO_DSP_NUM_BANDS];
+    dsp_eq_cache_t     eq_bass_low;                                    /*!< bass EQ at the low rate, with bass_decim */
+} audio_dsp_set_t;
+
+/* processing state of one output band, owned by the audio path */
+typedef struct {
+    dsp_gain_t    gain;
+    dsp_eq_t      eq;
+    dsp_limiter_t limiter;
+    dsp_delay_t   delay;
+    int32_t       chunk[AUDIO_DSP_CHUNK];
+    int16_t       out[AUDIO_DSP_CHUNK];     /*!< band output waiting to be routed, mono frames for a decimated bass */
+} audio_dsp_band_t;
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* clamp a value, NaN goes to the lower bound */
+static float audio_dsp_clampf(float v, float lo, float hi);
+/* bring parameters into range */
+static void audio_dsp_sanitize(audio_dsp_params_t *params);
+/* the routing only ever takes the bass summed to mono */
+static bool audio_dsp_bass_summed(const audio_dsp_params_t *params);
+/* precompute a parameter set for every rate */
+static void audio_dsp_build(audio_dsp_set_t *set, const audio_dsp_params_t *params, uint32_t gen);
+/* wait until the audio path no longer uses anything but the published set */
+static void audio_dsp_wait_taken(uint32_t gen);
+/* switch the audio path to a set, runs in the audio path */
+static void audio_dsp_apply(const audio_dsp_set_t *set);
+/* take over a new stream format, runs in the audio path */
+static void audio_dsp_apply_format(void);
+/* clear the bass band for the path it runs on next, runs in the audio path */
+static void audio_dsp_bass_reset(bool decim);
+/* bass of a chunk through the low rate chain into its band output, runs in the audio path */
+static void audio_dsp_bass_decimated(size_t n);
+/* copy the band outputs of a chunk into the port slots, runs in the audio path */
+static void audio_dsp_route(const audio_dsp_set_t *set, size_t n, int16_t *bass, int16_t *mid);
+/* the split, for channels, ways and bass path known at compile time */
+static inline int32_t audio_dsp_split_tmpl(const int16_t *in, size_t n, const int ch, const int ways, const bool decim);
+/* pick the split for the stream format and set in use, runs in the audio path */
+static void audio_dsp_select_kernel(void);
+/* name lookup in a string table */
+static int audio_dsp_str_index(const char *const *table, int n, const char *str);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const char *s_eq_type_str[] = {"off", "peak", "low_shelf", "high_shelf", "high_pass", "low_pass"};
+static const char *s_band_str[AUDIO_DSP_NUM_BANDS] = {"bass", "mid", "high"};
+static const char *s_slot_str[AUDIO_DSP_NUM_SLOTS] = {"mid_l", "mid_r", "bass_l", "bass_r"};
+static const char *s_src_str[] = {"left", "right", "sum"};
+static const char *s_layout_str[] = {"2way", "3way", "stereo_sub", "mono_2way", "custom"};
+
+/* band and source of every slot in the common layouts */
+static const audio_dsp_route_t s_layout_route[AUDIO_DSP_LAYOUT_CUSTOM][AUDIO_DSP_NUM_SLOTS] = {
+    [AUDIO_DSP_LAYOUT_2WAY] = {
+        {AUDIO_DSP_BAND_MID, AUDIO_DSP_SRC_LEFT}, {AUDIO_DSP_BAND_MID, AUDIO_DSP_SRC_RIGHT},
+        {AUDIO_DSP_BAND_BASS, AUDIO_DSP_SRC_LEFT}, {AUDIO_DSP_BAND_BASS, AUDIO_DSP_SRC_RIGHT},
+    },
+    [AUDIO_DSP_LAYOUT_3WAY] = {
+        {AUDIO_DSP_BAND_MID, AUDIO_DSP_SRC_SUM}, {AUDIO_DSP_BAND_HIGH, AUDIO_DSP_SRC_SUM},
+        {AUDIO_DSP_BAND_BASS, AUDIO_DSP_SRC_SUM}, {AUDIO_DSP_BAND_BASS, AUDIO_DSP_SRC_SUM},
+    },
+    [AUDIO_DSP_LAYOUT_STEREO_SUB] = {
+        {AUDIO_DSP_BAND_MID, AUDIO_DSP_SRC_LEFT}, {AUDIO_DSP_BAND_MID, AUDIO_DSP_SRC_RIGHT},
+        {AUDIO_DSP_BAND_BASS, AUDIO_DSP_SRC_SUM}, {AUDIO_DSP_BAND_BASS, AUDIO_DSP_SRC_SUM},
+    },
+    [AUDIO_DSP_LAYOUT_MONO_2WAY] = {
+        {AUDIO_DSP_BAND_MID, AUDIO_DSP_SRC_SUM}, {AUDIO_DSP_BAND_MID, AUDIO_DSP_SRC_SUM},
+        {AUDIO_DSP_BAND_BASS, AUDIO_DSP_SRC_SUM}, {AUDIO_DSP_BAND_BASS, AUDIO_DSP_SRC_SUM},
+    },
+};
+static const uint8_t s_layout_ways[AUDIO_DSP_LAYOUT_CUSTOM] = {2, 3, 2, 2};
+
+/* published side, written under s_params_lock */
+static SemaphoreHandle_t s_params_lock = NULL;
+static audio_dsp_set_t s_sets[2];
+static audio_dsp_set_t *s_active = NULL;          /* set the audio path picks up at its next block */
+static uint32_t s_taken_gen = 0;                  /* generation the audio path runs with */
+static uint32_t s_busy = 0;                       /* audio path is inside audio_dsp_process */
+static bool s_bass_decim_enable = (AUDIO_DSP_BASS_DECIM > 1);
+
+/* stream format, written by audio_dsp_configure */
+static portMUX_TYPE s_format_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_format_rate = 44100;
+static uint8_t s_format_ch = 2;
+static uint32_t s_format_seq = 0;
+
+/* audio path side */
+static audio_dsp_band_t s_band[AUDIO_DSP_NUM_BANDS];
+static const audio_dsp_set_t *s_cur = NULL;
+static uint32_t s_cur_gen = 0;
+static uint32_t s_format_seen = 0;
+static uint32_t s_rate = 44100;
+static uint8_t s_ch = 2;
+static int s_rate_idx = AUDIO_DSP_FALLBACK_RATE;
+static uint8_t s_ways = 2;
+static float s_lp_alpha[AUDIO_DSP_NUM_XOVERS] = {0.04f, 0.35f};
+static float s_lp_y[AUDIO_DSP_NUM_XOVERS][2];       /* per crossover and channel */
+static bool s_bass_decim = false;
+static dsp_decim_t s_decim;
+static dsp_interp_t s_interp;
+static int32_t s_bass_low[AUDIO_DSP_BASS_LOW_LEN];
+static int16_t s_bass_low_out[AUDIO_DSP_BASS_LOW_LEN];
+static uint32_t s_cycles_q4[2];                     /* per frame of audio_dsp_process, bass at full and low rate */
+static const audio_dsp_kernel_t *s_kernel = NULL;   /* split for the current format and set */
+static uint32_t s_state_version = 0;                /* app state the gain targets were computed from */
+static uint32_t s_target_gen = 0;                   /* set the gain targets were computed with */
+static int32_t s_target[AUDIO_DSP_NUM_BANDS];
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static float audio_dsp_clampf(float v, float lo, float hi)
+{
+    if (!(v >= lo)) {
+        return lo;
+    }
+    return (v > hi) ? hi : v;
+}
+
+static void audio_dsp_sanitize(audio_dsp_params_t *params)
+{
+    params->ways = (params->ways == 3) ? 3 : 2;
+    params->crossover_hz = audio_dsp_clampf(params->crossover_hz, AUDIO_DSP_XOVER_MIN_HZ, AUDIO_DSP_XOVER_MAX_HZ);
+    params->crossover_high_hz = audio_dsp_clampf(params->crossover_high_hz, params->crossover_hz,
+                                                 AUDIO_DSP_XOVER_HIGH_MAX_HZ);
+    for (int s = 0; s < AUDIO_DSP_NUM_SLOTS; s++) {
+        audio_dsp_route_t *route = &params->route[s];
+        if (route->band >= params->ways) {
+            route->band = AUDIO_DSP_BAND_NONE;
+        }
+        if (route->src > AUDIO_DSP_SRC_SUM) {
+            route->src = AUDIO_DSP_SRC_SUM;
+        }
+    }
+    params->limiter_db = audio_dsp_clampf(params->limiter_db, AUDIO_DSP_LIMITER_MIN_DB, 0.0f);
+    for (int b = 0; b < AUDIO_DSP_NUM_BANDS; b++) {
+        params->trim_db[b] = audio_dsp_clampf(params->trim_db[b], AUDIO_DSP_TRIM_MIN_DB, 0.0f);
+        params->delay_ms[b] = audio_dsp_clampf(params->delay_ms[b], 0.0f, AUDIO_DSP_DELAY_MAX_MS);
+        if (params->eq_n[b] > DSP_EQ_MAX_BANDS) {
+            params->eq_n[b] = DSP_EQ_MAX_BANDS;
+        }
+        for (int i = 0; i < DSP_EQ_MAX_BANDS; i++) {
+            dsp_eq_band_t *band = &params->eq[b][i];
+            if (i >= params->eq_n[b] || band->type > DSP_EQ_LOW_PASS) {
+                band->type = DSP_EQ_OFF;
+            }
+            band->freq_hz = audio_dsp_clampf(band->freq_hz, AUDIO_DSP_EQ_MIN_HZ, AUDIO_DSP_EQ_MAX_HZ);
+            band->gain_db = audio_dsp_clampf(band->gain_db, AUDIO_DSP_EQ_MIN_DB, AUDIO_DSP_EQ_MAX_DB);
+            band->q = audio_dsp_clampf(band->q, AUDIO_DSP_EQ_MIN_Q, AUDIO_DSP_EQ_MAX_Q);
+        }
+    }
+}
+
+static bool audio_dsp_bass_summed(const audio_dsp_params_t *params)
+{
+    for (int slot = 0; slot < AUDIO_DSP_NUM_SLOTS; slot++) {
+        if (params->route[slot].band == AUDIO_DSP_BAND_BASS && params->route[slot].src != AUDIO_DSP_SRC_SUM) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void audio_dsp_build(audio_dsp_set_t *set, const audio_dsp_params_t *params, uint32_t gen)
+{
+    set->params = *params;
+    set->limiter_threshold = dsp_limiter_threshold_from_db(params->limiter_db);
+    set->bass_decim = s_bass_decim_enable && audio_dsp_bass_summed(params);
+    for (int b = 0; b < AUDIO_DSP_NUM_BANDS; b++) {
+        set->trim[b] = powf(10.0f, params->trim_db[b] / 20.0f);
+        dsp_eq_cache_build(&set->eq[b], params->eq[b], params->eq_n[b]);
+        for (int r = 0; r < DSP_EQ_NUM_RATES; r++) {
+            set->delay_q8[b][r] = (uint32_t)(params->delay_ms[b] * dsp_eq_rate(r) / 1000.0f * (1 << DSP_DELAY_FRAC_BITS) + 0.5f);
+        }
+    }
+    if (set->bass_decim) {
+        /* the resampler delays the bass, take it out of the bass delay first and
+         * delay the other bands by what is left; the bass line runs at the low rate */
+        uint32_t latency = dsp_resample_latency_q8(AUDIO_DSP_BASS_DECIM);
+        dsp_eq_cache_build_decimated(&set->eq_bass_low, params->eq[AUDIO_DSP_BAND_BASS],
+                                     params->eq_n[AUDIO_DSP_BAND_BASS], AUDIO_DSP_BASS_DECIM);
+        for (int r = 0; r < DSP_EQ_NUM_RATES; r++) {
+            uint32_t *bass = &set->delay_q8[AUDIO_DSP_BAND_BASS][r];
+            uint32_t extra = (*bass < latency) ? latency - *bass : 0;
+            *bass = (*bass > latency) ? (*bass - latency) / AUDIO_DSP_BASS_DECIM : 0;
+            for (int b = AUDIO_DSP_BAND_MID; b < AUDIO_DSP_NUM_BANDS; b++) {
+                set->delay_q8[b][r] += extra;
+            }
+        }
+    }
+    for (int r = 0; r < DSP_EQ_NUM_RATES; r++) {
+        set->xover_alpha[0][r] = 1.0f - expf(-2.0f * 3.14159265f * params->crossover_hz / dsp_eq_rate(r));
+        set->xover_alpha[1][r] = 1.0f - expf(-2.0f * 3.14159265f * params->crossover_high_hz / dsp_eq_rate(r));
+    }
+    switch (audio_dsp_get_layout(params)) {
+    case AUDIO_DSP_LAYOUT_2WAY:
+        set->path = AUDIO_DSP_PATH_DIRECT;
+        break;
+    case AUDIO_DSP_LAYOUT_3WAY:
+        set->path = AUDIO_DSP_PATH_3WAY;
+        break;
+    default:
+        set->path = AUDIO_DSP_PATH_MATRIX;
+        break;
+    }
+    set->gen = gen;
+}
+
+static void audio_dsp_wait_taken(uint32_t gen)
+{
+    TickType_t start = xTaskGetTickCount();
+
+    /* a running stream takes a new set within one block */
+    while (__atomic_load_n(&s_taken_gen, __ATOMIC_ACQUIRE) != gen) {
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(AUDIO_DSP_SWAP_WAIT_MS)) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+    /* no stream: the audio path only has to be outside a block, the next one loads the published set */
+    while (__atomic_load_n(&s_busy, __ATOMIC_SEQ_CST) &&
+           __atomic_load_n(&s_taken_gen, __ATOMIC_ACQUIRE) != gen) {
+        vTaskDelay(1);
+    }
+}
+
+static inline __attribute__((always_inline))
+int32_t audio_dsp_split_tmpl(const int16_t *in, size_t n, const int ch, const int ways, const bool decim)
+{
+    int32_t *chunk_bass = s_band[AUDIO_DSP_BAND_BASS].chunk;
+    int32_t *chunk_mid = s_band[AUDIO_DSP_BAND_MID].chunk;
+    int32_t *chunk_high = s_band[AUDIO_DSP_BAND_HIGH].chunk;
+    /* local copies: the band chunks cannot alias them, so they stay in registers */
+    dsp_gain_t gain_bass = s_band[AUDIO_DSP_BAND_BASS].gain;
+    dsp_gain_t gain_mid = s_band[AUDIO_DSP_BAND_MID].gain;
+    dsp_gain_t gain_high = s_band[AUDIO_DSP_BAND_HIGH].gain;
+    float alpha = s_lp_alpha[0];
+    float alpha_high = s_lp_alpha[1];
+    float lp[2] = {s_lp_y[0][0], s_lp_y[0][1]};
+    float lp_high[2] = {s_lp_y[1][0], s_lp_y[1][1]};
+    int32_t peak = 0;
+
+    /* split on the raw signal, gain is applied afterwards; chunks start on a frame */
+    for (size_t i = 0; i < n; i += ch) {
+        for (int c = 0; c < ch; c++) {
+            int32_t x = in[i + c];
+            int32_t a = (x < 0) ? -x : x;
+            int32_t low = x;
+            if (a > peak) {
+                peak = a;
+            }
+            lp[c] = alpha * x + (1.0f - alpha) * lp[c];
+            if (ways == 3) {
+                lp_high[c] = alpha_high * x + (1.0f - alpha_high) * lp_high[c];
+                low = (int32_t)lp[c];
+                chunk_mid[i + c] = dsp_gain_scale((int32_t)lp_high[c] - (int32_t)lp[c], dsp_gain_next(&gain_mid));
+                chunk_high[i + c] = dsp_gain_scale(x - (int32_t)lp_high[c], dsp_gain_next(&gain_high));
+            } else {
+                /* 2-way keeps the bass full range, as the speaker always had, only the mid is high passed */
+                chunk_mid[i + c] = dsp_gain_scale(x - (int32_t)lp[c], dsp_gain_next(&gain_mid));
+            }
+            /* a decimated bass has its gain applied at the low rate */
+            chunk_bass[i + c] = decim ? low : dsp_gain_scale(low, dsp_gain_next(&gain_bass));
+        }
+    }
+    for (int c = 0; c < ch; c++) {
+        s_lp_y[0][c] = lp[c];
+        s_lp_y[1][c] = lp_high[c];
+    }
+    s_band[AUDIO_DSP_BAND_BASS].gain = gain_bass;
+    s_band[AUDIO_DSP_BAND_MID].gain = gain_mid;
+    s_band[AUDIO_DSP_BAND_HIGH].gain = gain_high;
+    return peak;
+}
+
+/* every argument of the template a constant: no mode checks left in the sample loop */
+#define AUDIO_DSP_SPLIT_KERNEL(ch, ways, decim)                                             \
+    static int32_t audio_dsp_split_##ch##ch_##ways##way_##decim(const int16_t *in, size_t n) \
+    {                                                                                       \
+        return audio_dsp_split_tmpl(in, n, ch, ways, decim);                                \
+    }
+
+AUDIO_DSP_SPLIT_KERNEL(1, 2, 0)
+AUDIO_DSP_SPLIT_KERNEL(1, 2, 1)
+AUDIO_DSP_SPLIT_KERNEL(1, 3, 0)
+AUDIO_DSP_SPLIT_KERNEL(1, 3, 1)
+AUDIO_DSP_SPLIT_KERNEL(2, 2, 0)
+AUDIO_DSP_SPLIT_KERNEL(2, 2, 1)
+AUDIO_DSP_SPLIT_KERNEL(2, 3, 0)
+AUDIO_DSP_SPLIT_KERNEL(2, 3, 1)
+
+/* by channels, ways and bass path */
+static const audio_dsp_kernel_t s_kernels[2][2][2] = {
+    {
+        {{audio_dsp_split_1ch_2way_0, "mono_2way"}, {audio_dsp_split_1ch_2way_1, "mono_2way_decim"}},
+        {{audio_dsp_split_1ch_3way_0, "mono_3way"}, {audio_dsp_split_1ch_3way_1, "mono_3way_decim"}},
+    },
+    {
+        {{audio_dsp_split_2ch_2way_0, "stereo_2way"}, {audio_dsp_split_2ch_2way_1, "stereo_2way_decim"}},
+        {{audio_dsp_split_2ch_3way_0, "stereo_3way"}, {audio_dsp_split_2ch_3way_1, "stereo_3way_decim"}},
+    },
+};
+
+#if CONFIG_EXAMPLE_DSP_GENERIC_KERNEL
+/* the same loop deciding everything per sample, for comparison */
+static int32_t audio_dsp_split_generic(const int16_t *in, size_t n)
+{
+    return audio_dsp_split_tmpl(in, n, s_ch, s_ways, s_bass_decim);
+}
+
+static const audio_dsp_kernel_t s_kernel_generic = {audio_dsp_split_generic, "generic"};
+#endif
+
+static void audio_dsp_select_kernel(void)
+{
+    const audio_dsp_kernel_t *kernel = &s_kernels[s_ch - 1][s_ways - 2][s_bass_decim];
+
+#if CONFIG_EXAMPLE_DSP_GENERIC_KERNEL
+    kernel = &s_kernel_generic;
+#endif
+    if (kernel != s_kernel) {
+        ESP_LOGD(AUDIO_DSP_TAG, "split kernel %s", kernel->name);
+    }
+    __atomic_store_n(&s_kernel, kernel, __ATOMIC_RELAXED);
+}
+
+static void audio_dsp_apply(const audio_dsp_set_t *set)
+{
+    int r = (s_rate_idx >= 0) ? s_rate_idx : AUDIO_DSP_FALLBACK_RATE;
+
+    if (set->bass_decim != s_bass_decim) {
+        audio_dsp_bass_reset(set->bass_decim);
+    }
+    for (int b = 0; b < AUDIO_DSP_NUM_BANDS; b++) {
+        audio_dsp_band_t *band = &s_band[b];
+        if (b >= s_ways && b < set->params.ways) {
+            /* a band that was idle starts from silence */
+            dsp_gain_init(&band->gain, 0);
+            dsp_limiter_reset(&band->limiter);
+            dsp_delay_reset(&band->delay, s_ch);
+        }
+        if (b == AUDIO_DSP_BAND_BASS && s_bass_decim) {
+            dsp_eq_select(&band->eq, &set->eq_bass_low, s_rate, 1);
+        } else {
+            dsp_eq_select(&band->eq, &set->eq[b], s_rate, s_ch);
+        }
+        dsp_limiter_set_threshold(&band->limiter, set->limiter_threshold);
+        dsp_delay_set(&band->delay, set->delay_q8[b][r]);
+    }
+    if (set->params.ways != s_ways) {
+        memset(s_lp_y, 0, sizeof(s_lp_y));
+        s_ways = set->params.ways;
+    }
+    for (int x = 0; x < AUDIO_DSP_NUM_XOVERS; x++) {
+        s_lp_alpha[x] = set->xover_alpha[x][r];
+    }
+    s_cur = set;
+    s_cur_gen = set->gen;
+    audio_dsp_select_kernel();
+}
+
+static void audio_dsp_apply_format(void)
+{
+    portENTER_CRITICAL(&s_format_lock);
+    s_rate = s_format_rate;
+    s_ch = s_format_ch;
+    s_format_seen = s_format_seq;
+    portEXIT_CRITICAL(&s_format_lock);
+
+    s_rate_idx = dsp_eq_rate_index(s_rate);
+    memset(s_lp_y, 0, sizeof(s_lp_y));
+    for (int b = 0; b < AUDIO_DSP_NUM_BANDS; b++) {
+        /* a new stream fades in over its first block */
+        dsp_gain_init(&s_band[b].gain, 0);
+        dsp_limiter_reset(&s_band[b].limiter);
+        dsp_delay_reset(&s_band[b].delay, s_ch);
+    }
+    audio_dsp_bass_reset(s_bass_decim);
+    /* the published set, s_cur may be the spare audio_dsp_set_params is rebuilding */
+    const audio_dsp_set_t *set = __atomic_load_n(&s_active, __ATOMIC_ACQUIRE);
+    if (set != NULL) {
+        audio_dsp_apply(set);
+    }
+}
+
+static void audio_dsp_bass_reset(bool decim)
+{
+    audio_dsp_band_t *band = &s_band[AUDIO_DSP_BAND_BASS];
+
+    if (decim) {
+        dsp_decim_reset(&s_decim);
+        dsp_interp_reset(&s_interp);
+    }
+    dsp_gain_init(&band->gain, 0);
+    /* one mono sample per factor frames: a lookahead of the same length in time
+     * keeps the bass in step with the other bands' limiters */
+    dsp_limiter_set_rate_shift(&band->limiter, decim ? __builtin_ctz(s_ch * AUDIO_DSP_BASS_DECIM) : 0);
+    dsp_delay_reset(&band->delay, decim ? 1 : s_ch);
+    s_bass_decim = decim;
+}
+
+static void audio_dsp_bass_decimated(size_t n)
+{
+    audio_dsp_band_t *band = &s_band[AUDIO_DSP_BAND_BASS];
+    size_t frames = n / s_ch;
+    size_t q = dsp_decim_process(&s_decim, band->chunk, frames, s_ch, s_bass_low);
+
+    for (size_t j = 0; j < q; j++) {
+        s_bass_low[j] = dsp_gain_scale(s_bass_low[j], dsp_gain_next(&band->gain));
+    }
+    dsp_eq_process(&band->eq, s_bass_low, q);
+    dsp_limiter_process(&band->limiter, s_bass_low, s_bass_low_out, q);
+    dsp_delay_process(&band->delay, s_bass_low_out, q);
+    dsp_interp_process(&s_interp, s_bass_low_out, q, band->out, frames);
+}
+
+static void audio_dsp_route(const audio_dsp_set_t *set, size_t n, int16_t *bass, int16_t *mid)
+{
+    const int16_t *out_bass = s_band[AUDIO_DSP_BAND_BASS].out;
+    const int16_t *out_mid = s_band[AUDIO_DSP_BAND_MID].out;
+    const int16_t *out_high = s_band[AUDIO_DSP_BAND_HIGH].out;
+    size_t ch = s_ch;
+    size_t frames = n / ch;
+
+    if (set->path == AUDIO_DSP_PATH_3WAY && ch == 2) {
+        for (size_t f = 0; f < n; f += 2) {
+            int16_t b = s_bass_decim ? out_bass[f >> 1] : (int16_t)((out_bass[f] + out_bass[f + 1]) >> 1);
+            mid[f] = (int16_t)((out_mid[f] + out_mid[f + 1]) >> 1);
+            mid[f + 1] = (int16_t)((out_high[f] + out_high[f + 1]) >> 1);
+            bass[f] = b;
+            bass[f + 1] = b;
+        }
+        return;
+    }
+
+    if (ch == 1) {
+        /* a mono port plays its one sample on both slots: the bands of its two slots are mixed,
+         * so e.g. the 3-way high band still reaches the port of the tweeter */
+        for (int slot = AUDIO_DSP_SLOT_MID_L; slot < AUDIO_DSP_NUM_SLOTS; slot += 2) {
+            uint8_t band_l = set->params.route[slot].band;
+            uint8_t band_r = set->params.route[slot + 1].band;
+            const int16_t *l = (band_l < s_ways) ? s_band[band_l].out : NULL;
+            const int16_t *r = (band_r < s_ways && band_r != band_l) ? s_band[band_r].out : NULL;
+            int16_t *port = (slot < AUDIO_DSP_SLOT_BASS_L) ? mid : bass;
+            for (size_t f = 0; f < frames; f++) {
+                int32_t x = (l ? l[f] : 0) + (r ? r[f] : 0);
+                port[f] = (int16_t)((x > INT16_MAX) ? INT16_MAX : (x < INT16_MIN) ? INT16_MIN : x);
+            }
+        }
+        return;
+    }
+
+    for (int slot = 0; slot < AUDIO_DSP_NUM_SLOTS; slot++) {
+        const audio_dsp_route_t *route = &set->params.route[slot];
+        int16_t *port = (slot < AUDIO_DSP_SLOT_BASS_L) ? mid : bass;
+        size_t c = slot & 1;
+
+        if (route->band >= s_ways) {
+            for (size_t f = 0; f < frames; f++) {
+                port[2 * f + c] = 0;
+            }
+            continue;
+        }
+        const int16_t *src = s_band[route->band].out;
+        if (route->band == AUDIO_DSP_BAND_BASS && s_bass_decim) {
+            /* a decimated bass comes back as mono and is only ever routed summed */
+            for (size_t f = 0; f < frames; f++) {
+                port[2 * f + c] = src[f];
+            }
+        } else if (route->src == AUDIO_DSP_SRC_SUM) {
+            for (size_t f = 0; f < frames; f++) {
+                port[2 * f + c] = (int16_t)((src[2 * f] + src[2 * f + 1]) >> 1);
+            }
+        } else {
+            size_t sc = (route->src == AUDIO_DSP_SRC_RIGHT) ? 1 : 0;
+            for (size_t f = 0; f < frames; f++) {
+                port[2 * f + c] = src[2 * f + sc];
+            }
+        }
+    }
+}
+
+static int audio_dsp_str_index(const char *const *table, int n, const char *str)
+{
+    for (int i = 0; i < n; i++) {
+        if (strcmp(str, table[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void audio_dsp_default_params(audio_dsp_params_t *params)
+{
+    memset(params, 0, sizeof(*params));
+    params->crossover_hz = AUDIO_DSP_DEFAULT_XOVER;
+    params->crossover_high_hz = AUDIO_DSP_DEFAULT_XOVER_HIGH;
+    params->limiter_db = CONFIG_EXAMPLE_LIMITER_THRESHOLD_DB;
+    for (int b = 0; b < AUDIO_DSP_NUM_BANDS; b++) {
+        for (int i = 0; i < DSP_EQ_MAX_BANDS; i++) {
+            params->eq[b][i].freq_hz = 1000.0f;
+            params->eq[b][i].q = 0.707f;
+        }
+    }
+    audio_dsp_set_layout(params, AUDIO_DSP_LAYOUT_DEFAULT);
+}
+
+void audio_dsp_set_layout(audio_dsp_params_t *params, int layout)
+{
+    if (layout < 0 || layout >= AUDIO_DSP_LAYOUT_CUSTOM) {
+        return;
+    }
+    params->ways = s_layout_ways[layout];
+    memcpy(params->route, s_layout_route[layout], sizeof(params->route));
+}
+
+int audio_dsp_get_layout(const audio_dsp_params_t *params)
+{
+    for (int layout = 0; layout < AUDIO_DSP_LAYOUT_CUSTOM; layout++) {
+        if (params->ways == s_layout_ways[layout] &&
+            memcmp(params->route, s_layout_route[layout], sizeof(params->route)) == 0) {
+            return layout;
+        }
+    }
+    return AUDIO_DSP_LAYOUT_CUSTOM;
+}
+
+void audio_dsp_init(void)
+{
+    audio_dsp_params_t params;
+
+    if (s_params_lock != NULL) {
+        return;
+    }
+    s_params_lock = xSemaphoreCreateMutex();
+    audio_dsp_default_params(&params);
+    audio_dsp_sanitize(&params);
+    for (int b = 0; b < AUDIO_DSP_NUM_BANDS; b++) {
+        dsp_limiter_init(&s_band[b].limiter, dsp_limiter_threshold_from_db(params.limiter_db));
+        dsp_eq_init(&s_band[b].eq);
+        bool ok = dsp_delay_init(&s_band[b].delay, AUDIO_DSP_DELAY_MAX_FRAMES, 2);
+        mem_telemetry_alloc(MEM_TELEMETRY_DSP, dsp_delay_mem_size(&s_band[b].delay), ok);
+        if (!ok) {
+            ESP_LOGE(AUDIO_DSP_TAG, "%s, no internal RAM for the %s delay line, time alignment off", __func__, s_band_str[b]);
+        }
+        dsp_gain_init(&s_band[b].gain, 0);
+    }
+    if (AUDIO_DSP_BASS_DECIM > 1) {
+        dsp_decim_init(&s_decim, AUDIO_DSP_BASS_DECIM);
+        dsp_interp_init(&s_interp, AUDIO_DSP_BASS_DECIM);
+    }
+    audio_dsp_build(&s_sets[0], &params, 1);
+    __atomic_store_n(&s_active, &s_sets[0], __ATOMIC_RELEASE);
+    ESP_LOGI(AUDIO_DSP_TAG, "delay lines %u bytes, %u bytes internal RAM left",
+             (unsigned)audio_dsp_delay_mem_size(), (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+}
+
+uint32_t audio_dsp_routing_pack(const audio_dsp_params_t *params)
+{
+    /* ways in the low byte, then 4 bits per slot: band (3 for none) and source */
+    uint32_t packed = params->ways;
+
+    for (int slot = 0; slot < AUDIO_DSP_NUM_SLOTS; slot++) {
+        const audio_dsp_route_t *route = &params->route[slot];
+        uint32_t band = (route->band < AUDIO_DSP_NUM_BANDS) ? route->band : 3;
+        packed |= ((band << 2) | (route->src & 3)) << (8 + 4 * slot);
+    }
+    return packed;
+}
+
+bool audio_dsp_routing_unpack(audio_dsp_params_t *params, uint32_t packed)
+{
+    uint8_t ways = packed & 0xff;
+
+    if (ways < 2 || ways > AUDIO_DSP_NUM_BANDS || (packed >> (8 + 4 * AUDIO_DSP_NUM_SLOTS)) != 0) {
+        return false;
+    }
+    params->ways = ways;
+    for (int slot = 0; slot < AUDIO_DSP_NUM_SLOTS; slot++) {
+        uint32_t bits = (packed >> (8 + 4 * slot)) & 0xf;
+        params->route[slot].band = ((bits >> 2) < AUDIO_DSP_NUM_BANDS) ? (bits >> 2) : AUDIO_DSP_BAND_NONE;
+        params->route[slot].src = bits & 3;
+    }
+    return true;
+}
+
+void audio_dsp_configure(uint32_t sample_rate, uint8_t ch_count)
+{
+    portENTER_CRITICAL(&s_format_lock);
+    s_format_rate = sample_rate;
+    s_format_ch = (ch_count == 1) ? 1 : 2;
+    s_format_seq++;
+    portEXIT_CRITICAL(&s_format_lock);
+}
+
+int32_t audio_dsp_process(const int16_t *in, size_t samples, int16_t *bass, int16_t *mid)
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+    int32_t peak = 0;
+    app_state_t state;
+
+    __atomic_store_n(&s_busy, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&s_format_seq, __ATOMIC_RELAXED) != s_format_seen) {
+        audio_dsp_apply_format();
+    }
+    /* parameter changes only land here, at a block boundary */
+    const audio_dsp_set_t *set = __atomic_load_n(&s_active, __ATOMIC_ACQUIRE);
+    if (set->gen != s_cur_gen) {
+        audio_dsp_apply(set);
+    }
+
+    /* one consistent view of volume and band gains for the whole block,
+     * volume, mode gain and trim folded into one Q15 target per band;
+     * the mid mode gain also drives the high band. Recomputed only when
+     * the state or the set changed, most blocks just reuse the targets */
+    uint32_t version = app_state_seq();
+    if (version != s_state_version || s_cur_gen != s_target_gen) {
+        app_state_read(&state);
+        s_target[AUDIO_DSP_BAND_BASS] = dsp_gain_from_volume(state.volume, state.volume_bass * s_cur->trim[AUDIO_DSP_BAND_BASS]);
+        s_target[AUDIO_DSP_BAND_MID] = dsp_gain_from_volume(state.volume, state.volume_mid * s_cur->trim[AUDIO_DSP_BAND_MID]);
+        s_target[AUDIO_DSP_BAND_HIGH] = dsp_gain_from_volume(state.volume, state.volume_mid * s_cur->trim[AUDIO_DSP_BAND_HIGH]);
+        s_state_version = version;
+        s_target_gen = s_cur_gen;
+    }
+    for (int b = 0; b < s_ways; b++) {
+        size_t ramp = samples;
+        if (b == AUDIO_DSP_BAND_BASS && s_bass_decim) {
+            ramp = dsp_decim_out_count(&s_decim, samples / s_ch);
+        }
+        dsp_gain_begin(&s_band[b].gain, s_target[b], ramp);
+    }
+
+    audio_dsp_split_fn_t split = s_kernel->fn;
+    bool direct = (s_cur->path == AUDIO_DSP_PATH_DIRECT);
+
+    for (size_t base = 0; base < samples; base += AUDIO_DSP_CHUNK) {
+        size_t n = samples - base;
+        if (n > AUDIO_DSP_CHUNK) {
+            n = AUDIO_DSP_CHUNK;
+        }
+
+        int32_t chunk_peak = split(&in[base], n);
+        if (chunk_peak > peak) {
+            peak = chunk_peak;
+        }
+        /* the bands as the crossover left them, a decimated bass before its gain */
+        pcm_tap_write32(PCM_TAP_XOVER_MID, s_band[AUDIO_DSP_BAND_MID].chunk, n);
+        pcm_tap_write32(PCM_TAP_XOVER_BASS, s_band[AUDIO_DSP_BAND_BASS].chunk, n);
+
+        for (int b = 0; b < s_ways; b++) {
+            audio_dsp_band_t *band = &s_band[b];
+            if (b == AUDIO_DSP_BAND_BASS && s_bass_decim) {
+                audio_dsp_bass_decimated(n);
+                continue;
+            }
+            /* the 2-way layout needs no routing, its bands go straight to the ports */
+            int16_t *out = !direct ? band->out : (b == AUDIO_DSP_BAND_BASS) ? &bass[base] : &mid[base];
+            dsp_eq_process(&band->eq, band->chunk, n);
+            /* peaks are pulled down ahead of time, what is left is soft clipped, never clamped */
+            dsp_limiter_process(&band->limiter, band->chunk, out, n);
+            dsp_delay_process(&band->delay, out, n);
+        }
+        if (!direct) {
+            audio_dsp_route(s_cur, n, &bass[base], &mid[base]);
+        }
+    }
+    for (int b = 0; b < s_ways; b++) {
+        dsp_gain_end(&s_band[b].gain, s_target[b]);
+    }
+
+    /* any set other than s_cur may be reused from here on */
+    __atomic_store_n(&s_taken_gen, s_cur_gen, __ATOMIC_RELEASE);
+    __atomic_store_n(&s_busy, 0, __ATOMIC_SEQ_CST);
+
+    size_t frames = samples / s_ch;
+    if (frames > 0) {
+        uint32_t *avg = &s_cycles_q4[s_bass_decim];
+        int32_t cycles = (int32_t)(((esp_cpu_get_cycle_count() - start) << AUDIO_DSP_CYCLES_SHIFT) / frames);
+        int32_t cur = (int32_t)__atomic_load_n(avg, __ATOMIC_RELAXED);
+        cur = (cur == 0) ? cycles : cur + ((cycles - cur) >> 4);
+        __atomic_store_n(avg, (uint32_t)cur, __ATOMIC_RELAXED);
+    }
+    return peak;
+}
+
+esp_err_t audio_dsp_set_params(const audio_dsp_params_t *params)
+{
+    audio_dsp_params_t p = *params;
+
+    if (s_params_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    audio_dsp_sanitize(&p);
+
+    xSemaphoreTake(s_params_lock, portMAX_DELAY);
+    audio_dsp_set_t *active = s_active;
+    audio_dsp_set_t *spare = (active == &s_sets[0]) ? &s_sets[1] : &s_sets[0];
+    /* the spare may still be mid-block until the active set was taken, EQ fades run on copies */
+    audio_dsp_wait_taken(active->gen);
+    audio_dsp_build(spare, &p, active->gen + 1);
+    __atomic_store_n(&s_active, spare, __ATOMIC_RELEASE);
+    xSemaphoreGive(s_params_lock);
+
+    ESP_LOGI(AUDIO_DSP_TAG, "parameters set %" PRIu32 " published", spare->gen);
+    return ESP_OK;
+}
+
+void audio_dsp_get_params(audio_dsp_params_t *params)
+{
+    if (s_params_lock == NULL) {
+        audio_dsp_default_params(params);
+        return;
+    }
+    xSemaphoreTake(s_params_lock, portMAX_DELAY);
+    *params = s_active->params;
+    xSemaphoreGive(s_params_lock);
+}
+
+esp_err_t audio_dsp_set_bass_decimation(bool enable)
+{
+    audio_dsp_params_t params;
+
+    if (AUDIO_DSP_BASS_DECIM < 2) {
+        return enable ? ESP_ERR_NOT_SUPPORTED : ESP_OK;
+    }
+    audio_dsp_get_params(&params);
+    xSemaphoreTake(s_params_lock, portMAX_DELAY);
+    s_bass_decim_enable = enable;
+    xSemaphoreGive(s_params_lock);
+    /* republish, the set decides which path the bass takes */
+    return audio_dsp_set_params(&params);
+}
+
+void audio_dsp_get_bass_stats(audio_dsp_bass_stats_t *stats)
+{
+    stats->decimation = AUDIO_DSP_BASS_DECIM;
+    stats->enabled = __atomic_load_n(&s_bass_decim_enable, __ATOMIC_RELAXED);
+    stats->active = (s_params_lock != NULL) && __atomic_load_n(&s_active, __ATOMIC_ACQUIRE)->bass_decim;
+    stats->cycles_full = (float)__atomic_load_n(&s_cycles_q4[0], __ATOMIC_RELAXED) / (1 << AUDIO_DSP_CYCLES_SHIFT);
+    stats->cycles_decimated = (float)__atomic_load_n(&s_cycles_q4[1], __ATOMIC_RELAXED) / (1 << AUDIO_DSP_CYCLES_SHIFT);
+}
+
+const char *audio_dsp_kernel_name(void)
+{
+    const audio_dsp_kernel_t *kernel = __atomic_load_n(&s_kernel, __ATOMIC_RELAXED);
+
+    return (kernel != NULL) ? kernel->name : "none";
+}
+
+size_t audio_dsp_delay_mem_size(void)
+{
+    size_t bytes = 0;
+
+    for (int b = 0; b < AUDIO_DSP_NUM_BANDS; b++) {
+        bytes += dsp_delay_mem_size(&s_band[b].delay);
+    }
+    return bytes;
+}
+
+void audio_dsp_limiter_meter(uint16_t *bass_db10, uint16_t *mid_db10)
+{
+    uint16_t high_db10 = dsp_limiter_meter_db10(&s_band[AUDIO_DSP_BAND_HIGH].limiter);
+
+    *bass_db10 = dsp_limiter_meter_db10(&s_band[AUDIO_DSP_BAND_BASS].limiter);
+    *mid_db10 = dsp_limiter_meter_db10(&s_band[AUDIO_DSP_BAND_MID].limiter);
+    if (high_db10 > *mid_db10) {
+        *mid_db10 = high_db10;
+    }
+}
+
+const char *audio_dsp_eq_type_str(uint8_t type)
+{
+    return (type <= DSP_EQ_LOW_PASS) ? s_eq_type_str[type] : "off";
+}
+
+int audio_dsp_eq_type_from_str(const char *str)
+{
+    return audio_dsp_str_index(s_eq_type_str, DSP_EQ_LOW_PASS + 1, str);
+}
+
+const char *audio_dsp_band_str(uint8_t band)
+{
+    return (band < AUDIO_DSP_NUM_BANDS) ? s_band_str[band] : "none";
+}
+
+const char *audio_dsp_slot_str(uint8_t slot)
+{
+    return (slot < AUDIO_DSP_NUM_SLOTS) ? s_slot_str[slot] : "none";
+}
+
+const char *audio_dsp_src_str(uint8_t src)
+{
+    return (src <= AUDIO_DSP_SRC_SUM) ? s_src_str[src] : "sum";
+}
+
+const char *audio_dsp_layout_str(int layout)
+{
+    return (layout >= 0 && layout < AUDIO_DSP_LAYOUT_CUSTOM) ? s_layout_str[layout] : "custom";
+}
+
+int audio_dsp_band_from_str(const char *str)
+{
+    if (strcmp(str, "none") == 0) {
+        return AUDIO_DSP_BAND_NONE;
+    }
+    return audio_dsp_str_index(s_band_str, AUDIO_DSP_NUM_BANDS, str);
+}
+
+int audio_dsp_slot_from_str(const char *str)
+{
+    return audio_dsp_str_index(s_slot_str, AUDIO_DSP_NUM_SLOTS, str);
+}
+
+int audio_dsp_src_from_str(const char *str)
+{
+    return audio_dsp_str_index(s_src_str, AUDIO_DSP_SRC_SUM + 1, str);
+}
+
+int audio_dsp_layout_from_str(const char *str)
+{
+    return audio_dsp_str_index(s_layout_str, AUDIO_DSP_LAYOUT_CUSTOM + 1, str);
+}
+
+int audio_dsp_params_to_json(const audio_dsp_params_t *params, char *buf, size_t len)
+{
+    json_writer_t w;
+
+    json_writer_init(&w, buf, len);
+    json_writer_printf(&w, "{\"ways\":%u,\"layout\":\"%s\",\"crossover\":%.1f,\"crossover_high\":%.1f,\"limiter\":%.1f",
+                       params->ways, s_layout_str[audio_dsp_get_layout(params)],
+                       params->crossover_hz, params->crossover_high_hz, params->limiter_db);
+    for (int b = 0; b < AUDIO_DSP_NUM_BANDS; b++) {
+        json_writer_printf(&w, ",\"%s\":{\"trim\":%.1f,\"delay\":%.3f,\"eq\":[",
+                           s_band_str[b], params->trim_db[b], params->delay_ms[b]);
+        for (int i = 0; i < params->eq_n[b]; i++) {
+            const dsp_eq_band_t *band = &params->eq[b][i];
+            json_writer_printf(&w, "%s{\"type\":\"%s\",\"freq\":%.0f,\"gain\":%.1f,\"q\":%.2f}",
+                               (i > 0) ? "," : "", audio_dsp_eq_type_str(band->type),
+                               band->freq_hz, band->gain_db, band->q);
+        }
+        json_writer_printf(&w, "]}");
+    }
+    json_writer_printf(&w, ",\"route\":{");
+    for (int slot = 0; slot < AUDIO_DSP_NUM_SLOTS; slot++) {
+        const audio_dsp_route_t *route = &params->route[slot];
+        json_writer_printf(&w, "%s\"%s\":{\"band\":\"%s\",\"src\":\"%s\"}", (slot > 0) ? "," : "",
+                           s_slot_str[slot], audio_dsp_band_str(route->band), audio_dsp_src_str(route->src));
+    }
+    json_writer_printf(&w, "}}");
+
+    return json_writer_result(&w);
+}
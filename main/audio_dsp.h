@@ -0,0 +1,246 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __AUDIO_DSP_H__
+#define __AUDIO_DSP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "dsp_eq.h"
+
+/* log tag */
+#define AUDIO_DSP_TAG    "AUDIO_DSP"
+
+/* crossover bands, lowest first; the high band only runs in a 3-way split */
+#define AUDIO_DSP_BAND_BASS    (0)
+#define AUDIO_DSP_BAND_MID     (1)
+#define AUDIO_DSP_BAND_HIGH    (2)
+#define AUDIO_DSP_NUM_BANDS    (3)
+#define AUDIO_DSP_BAND_NONE    (0xff)     /*!< route source of a silent slot */
+
+/* physical output slots, left and right of each output port */
+#define AUDIO_DSP_SLOT_MID_L     (0)     /*!< I2S0, the one port of a single-port or DAC sink */
+#define AUDIO_DSP_SLOT_MID_R     (1)
+#define AUDIO_DSP_SLOT_BASS_L    (2)     /*!< I2S1, second DAC channel */
+#define AUDIO_DSP_SLOT_BASS_R    (3)
+#define AUDIO_DSP_NUM_SLOTS      (4)
+
+/* parameter ranges, values outside are clamped */
+#define AUDIO_DSP_XOVER_MIN_HZ      (40.0f)
+#define AUDIO_DSP_XOVER_MAX_HZ      (1000.0f)
+#define AUDIO_DSP_XOVER_HIGH_MAX_HZ (8000.0f)
+#define AUDIO_DSP_TRIM_MIN_DB       (-30.0f)
+#define AUDIO_DSP_LIMITER_MIN_DB    (-12.0f)
+#define AUDIO_DSP_DELAY_MAX_MS      (10.0f)
+#define AUDIO_DSP_EQ_MIN_HZ         (20.0f)
+#define AUDIO_DSP_EQ_MAX_HZ         (20000.0f)
+#define AUDIO_DSP_EQ_MIN_DB         (-24.0f)
+#define AUDIO_DSP_EQ_MAX_DB         (12.0f)
+#define AUDIO_DSP_EQ_MIN_Q          (0.1f)
+#define AUDIO_DSP_EQ_MAX_Q          (10.0f)
+
+/* which channel of a band feeds a slot */
+typedef enum {
+    AUDIO_DSP_SRC_LEFT = 0,
+    AUDIO_DSP_SRC_RIGHT,
+    AUDIO_DSP_SRC_SUM,            /*!< (left + right) / 2 */
+} audio_dsp_src_t;
+
+/* common routings, anything else is custom */
+typedef enum {
+    AUDIO_DSP_LAYOUT_2WAY = 0,    /*!< stereo mid on the mid port, stereo bass on the bass port */
+    AUDIO_DSP_LAYOUT_3WAY,        /*!< mono: mid and high on the mid port, bass on both bass slots */
+    AUDIO_DSP_LAYOUT_STEREO_SUB,  /*!< stereo mid, mono bass on both bass slots */
+    AUDIO_DSP_LAYOUT_MONO_2WAY,   /*!< mono mid on both mid slots, mono bass on both bass slots */
+    AUDIO_DSP_LAYOUT_CUSTOM,
+} audio_dsp_layout_t;
+
+/* source of one output slot */
+typedef struct {
+    uint8_t band;                 /*!< AUDIO_DSP_BAND_*, AUDIO_DSP_BAND_NONE for silence */
+    uint8_t src;                  /*!< audio_dsp_src_t */
+} audio_dsp_route_t;
+
+/* everything that shapes the sound of the speaker and can be changed at run time */
+typedef struct {
+    uint8_t       ways;                                      /*!< 2 or 3 crossover bands */
+    float         crossover_hz;                              /*!< bass to mid corner */
+    float         crossover_high_hz;                         /*!< mid to high corner, 3-way only */
+    float         limiter_db;                                /*!< limiter threshold in dBFS */
+    float         trim_db[AUDIO_DSP_NUM_BANDS];              /*!< band level on top of volume and mode, <= 0 */
+    float         delay_ms[AUDIO_DSP_NUM_BANDS];             /*!< driver time alignment, fractions of a sample apply */
+    uint8_t       eq_n[AUDIO_DSP_NUM_BANDS];                 /*!< EQ bands in use per output band */
+    dsp_eq_band_t eq[AUDIO_DSP_NUM_BANDS][DSP_EQ_MAX_BANDS];
+    audio_dsp_route_t route[AUDIO_DSP_NUM_SLOTS];
+} audio_dsp_params_t;
+
+/**
+ * @brief  set up the processing chain with the default parameters, call once before audio starts
+ */
+void audio_dsp_init(void);
+
+/**
+ * @brief  default parameters
+ */
+void audio_dsp_default_params(audio_dsp_params_t *params);
+
+/**
+ * @brief  set the band count and routing of a common layout
+ *
+ * @param [inout] params  parameters to change
+ * @param [in]    layout  audio_dsp_layout_t other than AUDIO_DSP_LAYOUT_CUSTOM
+ */
+void audio_dsp_set_layout(audio_dsp_params_t *params, int layout);
+
+/**
+ * @brief  layout the band count and routing of parameters match
+ *
+ * @return  audio_dsp_layout_t
+ */
+int audio_dsp_get_layout(const audio_dsp_params_t *params);
+
+/**
+ * @brief  band count and routing packed into one word, for persisting the wiring
+ */
+uint32_t audio_dsp_routing_pack(const audio_dsp_params_t *params);
+
+/**
+ * @brief  restore band count and routing from audio_dsp_routing_pack
+ *
+ * @return  false if the word is not a valid routing, params are then left alone
+ */
+bool audio_dsp_routing_unpack(audio_dsp_params_t *params, uint32_t packed);
+
+/**
+ * @brief  announce a new stream format
+ *
+ *         Safe to call from any task; the audio path switches to the cached
+ *         coefficients of the rate and resets its state at the next block.
+ *
+ * @param [in] sample_rate  sample rate in Hz
+ * @param [in] ch_count     interleaved channels, 1 or 2
+ */
+void audio_dsp_configure(uint32_t sample_rate, uint8_t ch_count);
+
+/**
+ * @brief  split a block into the bands, run gain, EQ, limiter and delay on each and route them to the ports
+ *
+ *         Both outputs keep the channel layout of the input. A mono stream has one
+ *         sample per port and frame that plays on both slots of the port, so the
+ *         bands routed to its two slots are mixed into it.
+ *
+ * @param [in]  in       interleaved 16-bit PCM
+ * @param [in]  samples  number of samples
+ * @param [out] bass     bass port output, samples long
+ * @param [out] mid      mid port output, samples long
+ *
+ * @return  absolute peak of the input
+ */
+int32_t audio_dsp_process(const int16_t *in, size_t samples, int16_t *bass, int16_t *mid);
+
+/**
+ * @brief  change the parameters
+ *
+ *         Coefficients for all rates are computed in the calling task and the new set
+ *         is published at a block boundary. Filters crossfade from the old set over
+ *         DSP_EQ_FADE_FRAMES frames and delay taps over the block, where they would
+ *         otherwise click. Blocks for up to a few ms while the audio path lets go of
+ *         the previous set.
+ *
+ * @param [in] params  new parameters, out of range values are clamped
+ *
+ * @return  ESP_OK, or ESP_ERR_INVALID_STATE before audio_dsp_init
+ */
+esp_err_t audio_dsp_set_params(const audio_dsp_params_t *params);
+
+/**
+ * @brief  current parameters as clamped by audio_dsp_set_params
+ */
+void audio_dsp_get_params(audio_dsp_params_t *params);
+
+/**
+ * @brief  allow the bass to run mono at the low rate, e.g. to compare the cost of both paths
+ *
+ *         Only takes effect while the routing uses the bass summed to mono.
+ *
+ * @return  ESP_OK, ESP_ERR_NOT_SUPPORTED when built with CONFIG_EXAMPLE_BASS_DECIMATION 1
+ */
+esp_err_t audio_dsp_set_bass_decimation(bool enable);
+
+/* bass path state and what audio_dsp_process costs on either path */
+typedef struct {
+    uint8_t decimation;          /*!< CONFIG_EXAMPLE_BASS_DECIMATION */
+    bool    enabled;             /*!< allowed by audio_dsp_set_bass_decimation */
+    bool    active;              /*!< running, the routing sums the bass */
+    float   cycles_full;         /*!< CPU cycles per frame with the bass at the stream rate, 0 if never run */
+    float   cycles_decimated;    /*!< the same with the bass at the low rate */
+} audio_dsp_bass_stats_t;
+
+/**
+ * @brief  bass path state and cycle counts, safe to call from any task
+ */
+void audio_dsp_get_bass_stats(audio_dsp_bass_stats_t *stats);
+
+/**
+ * @brief  band split kernel in use, e.g. "stereo_2way" or "mono_3way_decim"
+ *
+ * @return  kernel name, "none" before the first block
+ */
+const char *audio_dsp_kernel_name(void);
+
+/**
+ * @brief  bytes of internal RAM held by the delay lines of all bands
+ */
+size_t audio_dsp_delay_mem_size(void);
+
+/**
+ * @brief  metered gain reduction of the output limiters
+ *
+ * @param [out] bass_db10  bass band gain reduction in 0.1 dB
+ * @param [out] mid_db10   mid or high band gain reduction, whichever is larger, in 0.1 dB
+ */
+void audio_dsp_limiter_meter(uint16_t *bass_db10, uint16_t *mid_db10);
+
+/**
+ * @brief  name of an EQ band type as used in the JSON API
+ */
+const char *audio_dsp_eq_type_str(uint8_t type);
+
+/**
+ * @brief  EQ band type from its name
+ *
+ * @return  dsp_eq_type_t, or -1 if the name is unknown
+ */
+int audio_dsp_eq_type_from_str(const char *str);
+
+/**
+ * @brief  name of a band, slot, source or layout as used in the JSON API
+ */
+const char *audio_dsp_band_str(uint8_t band);
+const char *audio_dsp_slot_str(uint8_t slot);
+const char *audio_dsp_src_str(uint8_t src);
+const char *audio_dsp_layout_str(int layout);
+
+/**
+ * @brief  band, slot, source or layout from its name
+ *
+ * @return  the value, or -1 if the name is unknown
+ */
+int audio_dsp_band_from_str(const char *str);
+int audio_dsp_slot_from_str(const char *str);
+int audio_dsp_src_from_str(const char *str);
+int audio_dsp_layout_from_str(const char *str);
+
+/**
+ * @brief  serialise parameters as JSON
+ *
+ * @return  length written, -1 if buf is too small
+ */
+int audio_dsp_params_to_json(const audio_dsp_params_t *params, char *buf, size_t len);
+
+#endif /* __AUDIO_DSP_H__ */
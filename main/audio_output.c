@@ -0,0 +1,297 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "audio_output.h"
+
+/* ramp from the last frame to silence before the clocks stop or change */
+#define AUDIO_OUTPUT_FADE_MS        (2)
+#define AUDIO_OUTPUT_FADE_FRAMES    (48000 * AUDIO_OUTPUT_FADE_MS / 1000)   /* at the highest A2DP rate */
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* start or stop the clocks if they are not already, caller holds s_lock */
+static void audio_output_clocks(bool on);
+/* ramp from the last frame written to silence and flush, caller holds s_lock */
+static void audio_output_fade_out(void);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const audio_output_ops_t *s_ops = NULL;
+static SemaphoreHandle_t s_lock = NULL;       /* one caller at a time into the sink */
+static bool s_enabled = false;
+static uint32_t s_rate = 44100;
+static uint8_t s_ch = 2;
+static int16_t s_last_mid[2];                 /* last frame written, faded out from */
+static int16_t s_last_bass[2];
+static int16_t s_fade_mid[AUDIO_OUTPUT_FADE_FRAMES * 2];
+static int16_t s_fade_bass[AUDIO_OUTPUT_FADE_FRAMES * 2];
+static bool s_fade_in = false;                /* ramp the next block up from silence */
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_output_stats_t s_stats;
+static int64_t s_mark_us = 0;                 /* time to first audio armed, 0 when not */
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static void audio_output_clocks(bool on)
+{
+    if (on == s_enabled) {
+        return;
+    }
+    s_ops->enable(on);
+    s_enabled = on;
+}
+
+static void audio_output_fade_out(void)
+{
+    uint32_t frames = s_rate / (1000 / AUDIO_OUTPUT_FADE_MS);
+    uint8_t ch = s_ch;
+    int32_t from = 0;
+
+    if (!s_enabled) {
+        return;
+    }
+    for (uint8_t c = 0; c < ch; c++) {
+        from = MAX(from, abs(s_last_mid[c]));
+        from = MAX(from, abs(s_last_bass[c]));
+    }
+    if (from > 0) {
+        for (uint32_t i = 0; i < frames; i++) {
+            int32_t g = (int32_t)(((frames - i) << 15) / frames);
+            for (uint8_t c = 0; c < ch; c++) {
+                s_fade_mid[i * ch + c] = (int16_t)((s_last_mid[c] * g) >> 15);
+                s_fade_bass[i * ch + c] = (int16_t)((s_last_bass[c] * g) >> 15);
+            }
+        }
+        s_ops->write(s_fade_mid, s_fade_bass, frames * ch);
+    }
+    memset(s_last_mid, 0, sizeof(s_last_mid));
+    memset(s_last_bass, 0, sizeof(s_last_bass));
+    /* nothing but zeros left queued, a stop / start cannot replay stale buffers */
+    s_ops->mute();
+    s_fade_in = true;
+
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.fades++;
+    s_stats.fade_from_max = MAX(s_stats.fade_from_max, from);
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+const audio_output_ops_t *audio_output_default(void)
+{
+#if CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_EXTERNAL_I2S
+    return &audio_output_i2s_dual;
+#elif CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_EXTERNAL_I2S_SINGLE
+    return &audio_output_i2s_single;
+#elif CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_INTERNAL_DAC
+    return &audio_output_dac;
+#elif CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_WAV
+    return &audio_output_wav;
+#else
+    return &audio_output_null;
+#endif
+}
+
+esp_err_t audio_output_init(const audio_output_ops_t *ops)
+{
+    esp_err_t ret;
+
+    if (s_ops != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if ((s_lock = xSemaphoreCreateMutex()) == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if ((ret = ops->open()) != ESP_OK) {
+        ESP_LOGE(AUDIO_OUTPUT_TAG, "%s, %s sink: %s", __func__, ops->name, esp_err_to_name(ret));
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+        return ret;
+    }
+    s_rate = 44100;
+    s_ch = 2;
+    s_ops = ops;
+    ESP_LOGI(AUDIO_OUTPUT_TAG, "%s sink, %" PRIu32 " us latency", ops->name, ops->latency_us());
+    return ESP_OK;
+}
+
+void audio_output_enable(bool on)
+{
+    if (s_ops == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (on) {
+        audio_output_clocks(true);
+        s_fade_in = true;
+    } else {
+        audio_output_fade_out();
+        audio_output_clocks(false);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void audio_output_silence(void)
+{
+    if (s_ops == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    audio_output_fade_out();
+    xSemaphoreGive(s_lock);
+}
+
+void audio_output_set_format(uint32_t sample_rate, uint8_t ch_count)
+{
+    int64_t start_us = esp_timer_get_time();
+
+    if (s_ops == NULL) {
+        return;
+    }
+    /* drain: a block being written goes out first */
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (sample_rate == s_rate && ch_count == s_ch) {
+        xSemaphoreGive(s_lock);
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.reclocks_skipped++;
+        portEXIT_CRITICAL(&s_stats_lock);
+        ESP_LOGI(AUDIO_OUTPUT_TAG, "%s already at %" PRIu32 " Hz, %u ch", s_ops->name, sample_rate, ch_count);
+        return;
+    }
+
+    bool enabled = s_enabled;
+    audio_output_fade_out();
+    audio_output_clocks(false);
+    esp_err_t ret = s_ops->set_format(sample_rate, ch_count);
+    if (ret == ESP_OK) {
+        s_rate = sample_rate;
+        s_ch = ch_count;
+    }
+    audio_output_clocks(enabled);
+    xSemaphoreGive(s_lock);
+
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start_us);
+    if (ret != ESP_OK) {
+        ESP_LOGE(AUDIO_OUTPUT_TAG, "%s, %s sink: %s", __func__, s_ops->name, esp_err_to_name(ret));
+        return;
+    }
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.reclocks++;
+    s_stats.reclock_last_us = us;
+    portEXIT_CRITICAL(&s_stats_lock);
+    ESP_LOGI(AUDIO_OUTPUT_TAG, "%s reclocked to %" PRIu32 " Hz, %u ch in %" PRIu32 " us",
+             s_ops->name, sample_rate, ch_count, us);
+}
+
+void audio_output_write(int16_t *mid, int16_t *bass, size_t samples)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint8_t ch = s_ch;
+    if (s_fade_in && samples > 0) {
+        /* first block after silence: ramp it up rather than step to its first sample */
+        int32_t step = 0;
+        for (size_t c = 0; c < ch && c < samples; c++) {
+            step = MAX(step, abs(mid[c]));
+            step = MAX(step, abs(bass[c]));
+        }
+        for (size_t i = 0; i < samples; i++) {
+            int32_t g = (int32_t)((i << 15) / samples);
+            mid[i] = (int16_t)((mid[i] * g) >> 15);
+            bass[i] = (int16_t)((bass[i] * g) >> 15);
+        }
+        s_fade_in = false;
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.start_step_max = MAX(s_stats.start_step_max, step);
+        portEXIT_CRITICAL(&s_stats_lock);
+    }
+    s_ops->write(mid, bass, samples);
+    if (samples >= ch) {
+        memcpy(s_last_mid, &mid[samples - ch], ch * sizeof(int16_t));
+        memcpy(s_last_bass, &bass[samples - ch], ch * sizeof(int16_t));
+    }
+    xSemaphoreGive(s_lock);
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_stats_lock);
+    if (s_mark_us != 0) {
+        uint32_t ms = (uint32_t)((now - s_mark_us) / 1000);
+        s_mark_us = 0;
+        s_stats.starts++;
+        s_stats.start_last_ms = ms;
+        s_stats.start_max_ms = MAX(s_stats.start_max_ms, ms);
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+void audio_output_mark(bool arm)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_stats_lock);
+    if (!arm) {
+        s_mark_us = 0;
+    } else if (s_mark_us == 0) {
+        s_mark_us = now;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+uint32_t audio_output_latency_us(void)
+{
+    return (s_ops != NULL) ? s_ops->latency_us() : 0;
+}
+
+void audio_output_get_stats(audio_output_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+    /* written under s_lock only, a torn read is harmless here */
+    stats->sink = (s_ops != NULL) ? s_ops->name : "none";
+    stats->latency_us = audio_output_latency_us();
+    stats->convert_cycles = (s_ops != NULL && s_ops->convert_cycles != NULL) ? s_ops->convert_cycles() : 0.0f;
+    stats->rate = s_rate;
+    stats->ch = s_ch;
+    stats->enabled = s_enabled;
+}
+
+int audio_output_to_json(char *buf, size_t len)
+{
+    audio_output_stats_t stats;
+
+    audio_output_get_stats(&stats);
+    int n = snprintf(buf, len,
+                     "{\"sink\":\"%s\",\"latency_us\":%" PRIu32 ",\"convert_cycles\":%.1f,\"rate\":%" PRIu32 ",\"ch\":%u,\"enabled\":%s,"
+                     "\"reclocks\":{\"count\":%" PRIu32 ",\"skipped\":%" PRIu32 ",\"last_us\":%" PRIu32 "},"
+                     "\"fades\":{\"count\":%" PRIu32 ",\"from_max\":%" PRId32 ",\"start_step_max\":%" PRId32 "},"
+                     "\"connect\":{\"count\":%" PRIu32 ",\"last_ms\":%" PRIu32 ",\"max_ms\":%" PRIu32 "}}",
+                     stats.sink, stats.latency_us, stats.convert_cycles, stats.rate, stats.ch, stats.enabled ? "true" : "false",
+                     stats.reclocks, stats.reclocks_skipped, stats.reclock_last_us,
+                     stats.fades, stats.fade_from_max, stats.start_step_max,
+                     stats.starts, stats.start_last_ms, stats.start_max_ms);
+    return (n < 0 || (size_t)n >= len) ? -1 : n;
+}
@@ -0,0 +1,154 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __AUDIO_OUTPUT_H__
+#define __AUDIO_OUTPUT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* log tag */
+#define AUDIO_OUTPUT_TAG    "AUDIO_OUTPUT"
+
+/**
+ * A sink for the two processed ports. The mid port carries slots
+ * AUDIO_DSP_SLOT_MID_L / _R, the bass port AUDIO_DSP_SLOT_BASS_L / _R;
+ * what a sink does with them is its own business. Sinks are singletons
+ * driven only through audio_output_*, which serialises the calls.
+ */
+typedef struct {
+    const char *name;
+    /* allocate and set up at 44.1 kHz stereo, clocks stopped */
+    esp_err_t (*open)(void);
+    /* new stream format, only called with the clocks stopped */
+    esp_err_t (*set_format)(uint32_t sample_rate, uint8_t ch_count);
+    /* start or stop the clocks */
+    void (*enable)(bool on);
+    /* queue one block of both ports, interleaved by ch_count, waits for room */
+    void (*write)(const int16_t *mid, const int16_t *bass, size_t samples);
+    /* replace everything still queued with silence */
+    void (*mute)(void);
+    /* give everything back */
+    void (*close)(void);
+    /* audio the sink holds between a write and the speaker in us */
+    uint32_t (*latency_us)(void);
+    /* CPU cycles per frame spent converting for the hardware, NULL if the sink copies */
+    float (*convert_cycles)(void);
+} audio_output_ops_t;
+
+/* Sinks. Only the hardware one selected in menuconfig is built, the null
+ * and WAV sinks need nothing but libc and are always there. */
+extern const audio_output_ops_t audio_output_i2s_dual;     /*!< mid port on I2S0, bass port on I2S1 */
+extern const audio_output_ops_t audio_output_i2s_single;   /*!< mid port on I2S0, the bass port is dropped */
+extern const audio_output_ops_t audio_output_dac;          /*!< left slot of each port on one internal DAC channel */
+extern const audio_output_ops_t audio_output_null;         /*!< discards, does not wait */
+extern const audio_output_ops_t audio_output_wav;          /*!< 16-bit WAV file, one channel per slot */
+
+/* output transitions since boot */
+typedef struct {
+    const char *sink;            /*!< name of the sink in use */
+    uint32_t latency_us;         /*!< audio held by the sink */
+    float    convert_cycles;     /*!< CPU cycles per frame the sink converts for, 0 if it copies */
+    uint32_t rate;               /*!< format the sink runs at */
+    uint8_t  ch;                 /*!< slots fed per port and frame, 1 or 2 */
+    bool     enabled;            /*!< clocks running */
+    uint32_t reclocks;           /*!< stream formats that needed a new clock */
+    uint32_t reclocks_skipped;   /*!< stream formats that matched the running clock */
+    uint32_t reclock_last_us;    /*!< drain, fade and reclock of the last format change */
+    uint32_t fades;              /*!< fades to silence: reclock, disconnect, mute, stop */
+    int32_t  fade_from_max;      /*!< largest level faded out, the step a hard stop would have left */
+    int32_t  start_step_max;     /*!< largest first sample ramped in after a transition */
+    uint32_t starts;             /*!< armed measurements that reached audio */
+    uint32_t start_last_ms;      /*!< arming to the first block written, last time */
+    uint32_t start_max_ms;
+} audio_output_stats_t;
+
+/**
+ * @brief  sink selected by EXAMPLE_A2DP_SINK_OUTPUT
+ */
+const audio_output_ops_t *audio_output_default(void);
+
+/**
+ * @brief  open a sink, once; it stays open for the life of the application
+ *
+ * @param [in] ops  sink
+ *
+ * @return  ESP_OK, ESP_ERR_INVALID_STATE if a sink is open already, or what the sink's open returned
+ */
+esp_err_t audio_output_init(const audio_output_ops_t *ops);
+
+/**
+ * @brief  start or stop the clocks
+ *
+ *         Stopping fades the last frame to silence and flushes the sink first,
+ *         the first block after a start is ramped in.
+ */
+void audio_output_enable(bool on);
+
+/**
+ * @brief  fade to silence and flush, the clocks keep running
+ */
+void audio_output_silence(void);
+
+/**
+ * @brief  move the sink to a new stream format: drain, fade, reclock
+ *
+ *         Nothing happens if the sink already runs at the format.
+ *
+ * @param [in] sample_rate  sample rate in Hz
+ * @param [in] ch_count     interleaved channels, 1 or 2
+ */
+void audio_output_set_format(uint32_t sample_rate, uint8_t ch_count);
+
+/**
+ * @brief  write one block of both ports
+ *
+ *         The first block after a transition is ramped in place.
+ *
+ * @param [inout] mid      mid port, samples long
+ * @param [inout] bass     bass port, samples long
+ * @param [in]    samples  samples per port
+ */
+void audio_output_write(int16_t *mid, int16_t *bass, size_t samples);
+
+/**
+ * @brief  arm or disarm the time to first audio measurement
+ *
+ *         Arming while armed keeps the earlier start, the next block written
+ *         stops the clock.
+ */
+void audio_output_mark(bool arm);
+
+/**
+ * @brief  audio the sink holds between a write and the speaker in us
+ */
+uint32_t audio_output_latency_us(void);
+
+/**
+ * @brief  get the output transition counters
+ */
+void audio_output_get_stats(audio_output_stats_t *stats);
+
+/**
+ * @brief  serialise the output transition counters as JSON
+ *
+ * @param [out] buf  output buffer
+ * @param [in]  len  output buffer size in byte
+ *
+ * @return  length of the JSON text, -1 if it does not fit
+ */
+int audio_output_to_json(char *buf, size_t len);
+
+/**
+ * @brief  file the WAV sink writes, before it is opened
+ *
+ *         Defaults to CONFIG_EXAMPLE_AUDIO_OUTPUT_WAV_PATH, or "output.wav".
+ */
+void audio_output_wav_set_path(const char *path);
+
+#endif /* __AUDIO_OUTPUT_H__ */
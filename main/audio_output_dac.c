@@ -0,0 +1,172 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+
+#if CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_INTERNAL_DAC
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "driver/dac_continuous.h"
+#include "dsp_dac8.h"
+#include "audio_output.h"
+
+#define AUDIO_OUTPUT_DAC_DESC_NUM    (8)
+#define AUDIO_OUTPUT_DAC_BUF_SIZE    (2048)     /* DMA bytes per descriptor, 16 bits per conversion */
+#define AUDIO_OUTPUT_DAC_FRAMES      (512)      /* frames converted per dac_continuous_write */
+#define AUDIO_OUTPUT_DAC_CYCLES_SHIFT (4)       /* cycles per frame are kept in Q4, averaged over 16 blocks */
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+static esp_err_t audio_output_dac_open(void);
+static esp_err_t audio_output_dac_set_format(uint32_t sample_rate, uint8_t ch_count);
+static void audio_output_dac_enable(bool on);
+static void audio_output_dac_write(const int16_t *mid, const int16_t *bass, size_t samples);
+static void audio_output_dac_mute(void);
+static void audio_output_dac_close(void);
+static uint32_t audio_output_dac_latency_us(void);
+static float audio_output_dac_convert_cycles(void);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static dac_continuous_handle_t s_dac = NULL;
+static uint32_t s_rate = 44100;
+static uint8_t s_ch = 2;
+static uint8_t s_buf[AUDIO_OUTPUT_DAC_FRAMES * 2];     /* channel 0, channel 1, ... */
+static dsp_dac8_t s_dac8;
+static uint32_t s_cycles_q4 = 0;                       /* per frame of the conversion */
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static esp_err_t audio_output_dac_open(void)
+{
+    /* each conversion feeds one of the two channels in turn */
+    dac_continuous_config_t cont_cfg = {
+        .chan_mask = DAC_CHANNEL_MASK_ALL,
+        .desc_num = AUDIO_OUTPUT_DAC_DESC_NUM,
+        .buf_size = AUDIO_OUTPUT_DAC_BUF_SIZE,
+        .freq_hz = s_rate * 2,
+        .offset = 0,
+        .clk_src = DAC_DIGI_CLK_SRC_DEFAULT,
+        .chan_mode = DAC_CHANNEL_MODE_ALTER,
+    };
+
+    /* the fed back error belongs to the stream before */
+    dsp_dac8_init(&s_dac8, CONFIG_EXAMPLE_DAC_NOISE_SHAPING);
+    return dac_continuous_new_channels(&cont_cfg, &s_dac);
+}
+
+static esp_err_t audio_output_dac_set_format(uint32_t sample_rate, uint8_t ch_count)
+{
+    uint32_t rate = s_rate;
+    esp_err_t ret;
+
+    /* the conversion clock is fixed at creation, make the channels again */
+    audio_output_dac_close();
+    s_rate = sample_rate;
+    if ((ret = audio_output_dac_open()) != ESP_OK) {
+        s_rate = rate;
+        audio_output_dac_open();
+        return ret;
+    }
+    s_ch = ch_count;
+    return ESP_OK;
+}
+
+static void audio_output_dac_enable(bool on)
+{
+    if (on) {
+        dac_continuous_enable(s_dac);
+    } else {
+        dac_continuous_disable(s_dac);
+    }
+}
+
+static void audio_output_dac_write(const int16_t *mid, const int16_t *bass, size_t samples)
+{
+    size_t frames = samples / s_ch;
+    size_t bytes_written;
+    uint32_t cycles = 0;
+
+    /* left slot of the mid port on channel 0 (GPIO25), of the bass port on channel 1 (GPIO26) */
+    while (frames > 0) {
+        size_t n = (frames < AUDIO_OUTPUT_DAC_FRAMES) ? frames : AUDIO_OUTPUT_DAC_FRAMES;
+        uint32_t start = esp_cpu_get_cycle_count();
+        dsp_dac8_convert(&s_dac8, mid, bass, s_ch, n, s_buf);
+        cycles += esp_cpu_get_cycle_count() - start;
+        dac_continuous_write(s_dac, s_buf, n * 2, &bytes_written, -1);
+        mid += n * s_ch;
+        bass += n * s_ch;
+        frames -= n;
+    }
+    if (samples >= s_ch) {
+        /* the conversion alone, the wait for DMA room is not its cost */
+        int32_t q4 = (int32_t)((cycles << AUDIO_OUTPUT_DAC_CYCLES_SHIFT) / (samples / s_ch));
+        int32_t cur = (int32_t)__atomic_load_n(&s_cycles_q4, __ATOMIC_RELAXED);
+        cur = (cur == 0) ? q4 : cur + ((q4 - cur) >> 4);
+        __atomic_store_n(&s_cycles_q4, (uint32_t)cur, __ATOMIC_RELAXED);
+    }
+}
+
+static void audio_output_dac_mute(void)
+{
+    size_t bytes_written;
+
+    /* mid scale is silence in offset binary; written bytes are widened, this is twice the DMA */
+    memset(s_buf, 128, sizeof(s_buf));
+    for (size_t left = AUDIO_OUTPUT_DAC_DESC_NUM * AUDIO_OUTPUT_DAC_BUF_SIZE; left > 0; left -= MIN(left, sizeof(s_buf))) {
+        dac_continuous_write(s_dac, s_buf, MIN(left, sizeof(s_buf)), &bytes_written, -1);
+    }
+    dsp_dac8_reset(&s_dac8);
+}
+
+static void audio_output_dac_close(void)
+{
+    if (s_dac != NULL) {
+        dac_continuous_del_channels(s_dac);
+        s_dac = NULL;
+    }
+}
+
+static uint32_t audio_output_dac_latency_us(void)
+{
+    /* two DMA bytes per conversion, two conversions per frame */
+    return (uint32_t)((uint64_t)AUDIO_OUTPUT_DAC_DESC_NUM * AUDIO_OUTPUT_DAC_BUF_SIZE / 4 * 1000000 / s_rate);
+}
+
+static float audio_output_dac_convert_cycles(void)
+{
+    return (float)__atomic_load_n(&s_cycles_q4, __ATOMIC_RELAXED) / (1 << AUDIO_OUTPUT_DAC_CYCLES_SHIFT);
+}
+
+/********************************
+ * EXTERNAL VARIABLE DEFINITIONS
+ *******************************/
+
+const audio_output_ops_t audio_output_dac = {
+    .name = "dac",
+    .open = audio_output_dac_open,
+    .set_format = audio_output_dac_set_format,
+    .enable = audio_output_dac_enable,
+    .write = audio_output_dac_write,
+    .mute = audio_output_dac_mute,
+    .close = audio_output_dac_close,
+    .latency_us = audio_output_dac_latency_us,
+    .convert_cycles = audio_output_dac_convert_cycles,
+};
+
+#endif /* CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_INTERNAL_DAC */
@@ -0,0 +1,248 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sdkconfig.h"
+
+#if CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_EXTERNAL_I2S || CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_EXTERNAL_I2S_SINGLE
+
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "driver/i2s_std.h"
+#include "audio_stall.h"
+#include "audio_output.h"
+
+/* I2S DMA deep enough to play CONFIG_EXAMPLE_AUDIO_DMA_MS at 48 kHz on its own while
+ * a flash write keeps every task off the CPU, plus the buffer being refilled */
+#define AUDIO_OUTPUT_I2S_FRAME_NUM    (240)
+#define AUDIO_OUTPUT_I2S_DESC_NUM     ((CONFIG_EXAMPLE_AUDIO_DMA_MS * 48 + AUDIO_OUTPUT_I2S_FRAME_NUM - 1) / AUDIO_OUTPUT_I2S_FRAME_NUM + 1)
+#define AUDIO_OUTPUT_I2S_DMA_FRAMES   (AUDIO_OUTPUT_I2S_DESC_NUM * AUDIO_OUTPUT_I2S_FRAME_NUM)
+
+/* one of the ports */
+typedef struct {
+    i2s_port_t        port;
+    int               bclk;
+    int               ws;
+    int               dout;
+    i2s_chan_handle_t chan;
+} audio_output_i2s_port_t;
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* create and configure one port, clock stopped */
+static esp_err_t audio_output_i2s_port_open(audio_output_i2s_port_t *p, bool report_underrun);
+/* the I2S DMA found no fresh buffer, runs in the I2S ISR */
+static bool audio_output_i2s_send_q_ovf(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx);
+#if CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_EXTERNAL_I2S
+static esp_err_t audio_output_i2s_open_dual(void);
+#endif
+static esp_err_t audio_output_i2s_open_single(void);
+static esp_err_t audio_output_i2s_set_format(uint32_t sample_rate, uint8_t ch_count);
+static void audio_output_i2s_enable(bool on);
+static void audio_output_i2s_write(const int16_t *mid, const int16_t *bass, size_t samples);
+static void audio_output_i2s_mute(void);
+static void audio_output_i2s_close(void);
+static uint32_t audio_output_i2s_latency_us(void);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static audio_output_i2s_port_t s_ports[2] = {
+    {
+        .port = I2S_NUM_0,
+        .bclk = CONFIG_MIDRANGE_I2S_BCK_PIN,
+        .ws = CONFIG_MIDRANGE_I2S_LRCK_PIN,
+        .dout = CONFIG_MIDRANGE_I2S_DATA_PIN,
+    },
+#if CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_EXTERNAL_I2S
+    {
+        .port = I2S_NUM_1,
+        .bclk = CONFIG_BASS_I2S_BCK_PIN,
+        .ws = CONFIG_BASS_I2S_LRCK_PIN,
+        .dout = CONFIG_BASS_I2S_DATA_PIN,
+    },
+#endif
+};
+static int s_port_num = 0;          /* ports opened, the mid port first */
+static uint32_t s_rate = 44100;
+static const int16_t s_zeros[AUDIO_OUTPUT_I2S_FRAME_NUM * 2];
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static esp_err_t audio_output_i2s_port_open(audio_output_i2s_port_t *p, bool report_underrun)
+{
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(p->port, I2S_ROLE_MASTER);
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(44100),
+        .slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO),
+        .gpio_cfg = {
+            .mclk = I2S_GPIO_UNUSED,
+            .bclk = p->bclk,
+            .ws = p->ws,
+            .dout = p->dout,
+            .din = I2S_GPIO_UNUSED,
+            .invert_flags = {
+                .mclk_inv = false,
+                .bclk_inv = false,
+                .ws_inv = false,
+            },
+        },
+    };
+    i2s_event_callbacks_t cbs = {
+        .on_send_q_ovf = audio_output_i2s_send_q_ovf,
+    };
+    esp_err_t ret;
+
+    /* a stall longer than the DMA plays silence rather than the last buffers again */
+    chan_cfg.dma_desc_num = AUDIO_OUTPUT_I2S_DESC_NUM;
+    chan_cfg.dma_frame_num = AUDIO_OUTPUT_I2S_FRAME_NUM;
+    chan_cfg.auto_clear = true;
+    if ((ret = i2s_new_channel(&chan_cfg, &p->chan, NULL)) != ESP_OK) {
+        return ret;
+    }
+    if ((ret = i2s_channel_init_std_mode(p->chan, &std_cfg)) != ESP_OK) {
+        i2s_del_channel(p->chan);
+        p->chan = NULL;
+        return ret;
+    }
+    if (report_underrun) {
+        i2s_channel_register_event_callback(p->chan, &cbs, NULL);
+    }
+    return ESP_OK;
+}
+
+static bool IRAM_ATTR audio_output_i2s_send_q_ovf(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    audio_stall_dma_underrun();
+    return false;
+}
+
+#if CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_EXTERNAL_I2S
+static esp_err_t audio_output_i2s_open_dual(void)
+{
+    esp_err_t ret;
+
+    /* both ports are fed together, the mid port tells when the DMA ran dry */
+    for (s_port_num = 0; s_port_num < 2; s_port_num++) {
+        if ((ret = audio_output_i2s_port_open(&s_ports[s_port_num], s_port_num == 0)) != ESP_OK) {
+            audio_output_i2s_close();
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+#endif
+
+static esp_err_t audio_output_i2s_open_single(void)
+{
+    esp_err_t ret;
+
+    if ((ret = audio_output_i2s_port_open(&s_ports[0], true)) != ESP_OK) {
+        return ret;
+    }
+    s_port_num = 1;
+    return ESP_OK;
+}
+
+static esp_err_t audio_output_i2s_set_format(uint32_t sample_rate, uint8_t ch_count)
+{
+    i2s_std_clk_config_t clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(sample_rate);
+    i2s_std_slot_config_t slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, ch_count);
+    esp_err_t ret = ESP_OK;
+
+    for (int i = 0; i < s_port_num && ret == ESP_OK; i++) {
+        if ((ret = i2s_channel_reconfig_std_clock(s_ports[i].chan, &clk_cfg)) == ESP_OK) {
+            ret = i2s_channel_reconfig_std_slot(s_ports[i].chan, &slot_cfg);
+        }
+    }
+    if (ret == ESP_OK) {
+        s_rate = sample_rate;
+    }
+    return ret;
+}
+
+static void audio_output_i2s_enable(bool on)
+{
+    /* back to back so the word clocks of both ports start together */
+    for (int i = 0; i < s_port_num; i++) {
+        if (on) {
+            i2s_channel_enable(s_ports[i].chan);
+        } else {
+            i2s_channel_disable(s_ports[i].chan);
+        }
+    }
+}
+
+static void audio_output_i2s_write(const int16_t *mid, const int16_t *bass, size_t samples)
+{
+    size_t bytes_written;
+
+    i2s_channel_write(s_ports[0].chan, mid, samples * sizeof(int16_t), &bytes_written, portMAX_DELAY);
+    if (s_port_num > 1) {
+        i2s_channel_write(s_ports[1].chan, bass, samples * sizeof(int16_t), &bytes_written, portMAX_DELAY);
+    }
+}
+
+static void audio_output_i2s_mute(void)
+{
+    /* stereo frames, in mono slot mode that is twice the DMA, still all of it */
+    for (size_t left = AUDIO_OUTPUT_I2S_DMA_FRAMES; left > 0; left -= AUDIO_OUTPUT_I2S_FRAME_NUM) {
+        audio_output_i2s_write(s_zeros, s_zeros, AUDIO_OUTPUT_I2S_FRAME_NUM * 2);
+    }
+}
+
+static void audio_output_i2s_close(void)
+{
+    for (int i = 0; i < s_port_num; i++) {
+        i2s_del_channel(s_ports[i].chan);
+        s_ports[i].chan = NULL;
+    }
+    s_port_num = 0;
+}
+
+static uint32_t audio_output_i2s_latency_us(void)
+{
+    /* the DMA runs full while audio is written */
+    return (uint32_t)((uint64_t)AUDIO_OUTPUT_I2S_DMA_FRAMES * 1000000 / s_rate);
+}
+
+/********************************
+ * EXTERNAL VARIABLE DEFINITIONS
+ *******************************/
+
+#if CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_EXTERNAL_I2S
+const audio_output_ops_t audio_output_i2s_dual = {
+    .name = "i2s_dual",
+    .open = audio_output_i2s_open_dual,
+    .set_format = audio_output_i2s_set_format,
+    .enable = audio_output_i2s_enable,
+    .write = audio_output_i2s_write,
+    .mute = audio_output_i2s_mute,
+    .close = audio_output_i2s_close,
+    .latency_us = audio_output_i2s_latency_us,
+};
+#endif
+
+const audio_output_ops_t audio_output_i2s_single = {
+    .name = "i2s_single",
+    .open = audio_output_i2s_open_single,
+    .set_format = audio_output_i2s_set_format,
+    .enable = audio_output_i2s_enable,
+    .write = audio_output_i2s_write,
+    .mute = audio_output_i2s_mute,
+    .close = audio_output_i2s_close,
+    .latency_us = audio_output_i2s_latency_us,
+};
+
+#endif /* CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_EXTERNAL_I2S || CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_EXTERNAL_I2S_SINGLE */
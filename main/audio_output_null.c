@@ -0,0 +1,75 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "audio_output.h"
+
+/* Takes blocks as fast as they come, so whatever runs in front of it is
+ * measured on its own, on the chip without output hardware or on the host. */
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+static esp_err_t audio_output_null_open(void);
+static esp_err_t audio_output_null_set_format(uint32_t sample_rate, uint8_t ch_count);
+static void audio_output_null_enable(bool on);
+static void audio_output_null_write(const int16_t *mid, const int16_t *bass, size_t samples);
+static void audio_output_null_mute(void);
+static void audio_output_null_close(void);
+static uint32_t audio_output_null_latency_us(void);
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static esp_err_t audio_output_null_open(void)
+{
+    return ESP_OK;
+}
+
+static esp_err_t audio_output_null_set_format(uint32_t sample_rate, uint8_t ch_count)
+{
+    return ESP_OK;
+}
+
+static void audio_output_null_enable(bool on)
+{
+}
+
+static void audio_output_null_write(const int16_t *mid, const int16_t *bass, size_t samples)
+{
+}
+
+static void audio_output_null_mute(void)
+{
+}
+
+static void audio_output_null_close(void)
+{
+}
+
+static uint32_t audio_output_null_latency_us(void)
+{
+    return 0;
+}
+
+/********************************
+ * EXTERNAL VARIABLE DEFINITIONS
+ *******************************/
+
+const audio_output_ops_t audio_output_null = {
+    .name = "null",
+    .open = audio_output_null_open,
+    .set_format = audio_output_null_set_format,
+    .enable = audio_output_null_enable,
+    .write = audio_output_null_write,
+    .mute = audio_output_null_mute,
+    .close = audio_output_null_close,
+    .latency_us = audio_output_null_latency_us,
+};
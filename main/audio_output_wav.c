@@ -0,0 +1,210 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "audio_output.h"
+
+/* Writes what the ports would play to a 16-bit PCM WAV file with one channel
+ * per slot: mid left, mid right, bass left, bass right for a stereo stream,
+ * mid and bass for a mono one. Meant for host builds, where the file can be
+ * compared against a reference or listened to. A new stream format after
+ * audio was written finishes the file and starts the next, "<path>.1" and
+ * so on. Does not wait, the whole pipeline runs as fast as it can. */
+
+#ifdef CONFIG_EXAMPLE_AUDIO_OUTPUT_WAV_PATH
+#define AUDIO_OUTPUT_WAV_PATH    CONFIG_EXAMPLE_AUDIO_OUTPUT_WAV_PATH
+#else
+#define AUDIO_OUTPUT_WAV_PATH    "output.wav"
+#endif
+#define AUDIO_OUTPUT_WAV_HDR_LEN     (44)
+#define AUDIO_OUTPUT_WAV_FRAMES      (256)      /* frames interleaved per fwrite */
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* write the header for the current format and data written so far */
+static void audio_output_wav_header(void);
+/* start a file, the first one at s_path */
+static esp_err_t audio_output_wav_start(void);
+/* patch the sizes into the header and close the file */
+static void audio_output_wav_finish(void);
+static esp_err_t audio_output_wav_open(void);
+static esp_err_t audio_output_wav_set_format(uint32_t sample_rate, uint8_t ch_count);
+static void audio_output_wav_enable(bool on);
+static void audio_output_wav_write(const int16_t *mid, const int16_t *bass, size_t samples);
+static void audio_output_wav_mute(void);
+static void audio_output_wav_close(void);
+static uint32_t audio_output_wav_latency_us(void);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const char *s_path = AUDIO_OUTPUT_WAV_PATH;
+static FILE *s_file = NULL;
+static unsigned s_file_num = 0;          /* files started */
+static uint32_t s_rate = 44100;
+static uint8_t s_ch = 2;
+static uint32_t s_data_len = 0;          /* PCM bytes in the current file */
+static int16_t s_frames[AUDIO_OUTPUT_WAV_FRAMES * 4];
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static void audio_output_wav_put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void audio_output_wav_put32(uint8_t *p, uint32_t v)
+{
+    audio_output_wav_put16(p, (uint16_t)v);
+    audio_output_wav_put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void audio_output_wav_header(void)
+{
+    uint8_t hdr[AUDIO_OUTPUT_WAV_HDR_LEN];
+    uint16_t channels = s_ch * 2;
+
+    memcpy(hdr, "RIFF", 4);
+    audio_output_wav_put32(hdr + 4, 36 + s_data_len);
+    memcpy(hdr + 8, "WAVEfmt ", 8);
+    audio_output_wav_put32(hdr + 16, 16);
+    audio_output_wav_put16(hdr + 20, 1);                                  /* PCM */
+    audio_output_wav_put16(hdr + 22, channels);
+    audio_output_wav_put32(hdr + 24, s_rate);
+    audio_output_wav_put32(hdr + 28, s_rate * channels * sizeof(int16_t));
+    audio_output_wav_put16(hdr + 32, channels * sizeof(int16_t));
+    audio_output_wav_put16(hdr + 34, 16);
+    memcpy(hdr + 36, "data", 4);
+    audio_output_wav_put32(hdr + 40, s_data_len);
+    fseek(s_file, 0, SEEK_SET);
+    fwrite(hdr, 1, sizeof(hdr), s_file);
+    fseek(s_file, 0, SEEK_END);
+}
+
+static esp_err_t audio_output_wav_start(void)
+{
+    char path[128];
+
+    if (s_file_num == 0) {
+        snprintf(path, sizeof(path), "%s", s_path);
+    } else {
+        snprintf(path, sizeof(path), "%s.%u", s_path, s_file_num);
+    }
+    if ((s_file = fopen(path, "wb")) == NULL) {
+        ESP_LOGE(AUDIO_OUTPUT_TAG, "%s, cannot create %s", __func__, path);
+        return ESP_FAIL;
+    }
+    s_file_num++;
+    s_data_len = 0;
+    audio_output_wav_header();
+    return ESP_OK;
+}
+
+static void audio_output_wav_finish(void)
+{
+    if (s_file != NULL) {
+        audio_output_wav_header();
+        fclose(s_file);
+        s_file = NULL;
+    }
+}
+
+static esp_err_t audio_output_wav_open(void)
+{
+    return audio_output_wav_start();
+}
+
+static esp_err_t audio_output_wav_set_format(uint32_t sample_rate, uint8_t ch_count)
+{
+    if (s_file != NULL && s_data_len == 0) {
+        /* nothing played in the old format, rewrite the header in place */
+        s_rate = sample_rate;
+        s_ch = ch_count;
+        audio_output_wav_header();
+        return ESP_OK;
+    }
+    audio_output_wav_finish();
+    s_rate = sample_rate;
+    s_ch = ch_count;
+    return audio_output_wav_start();
+}
+
+static void audio_output_wav_enable(bool on)
+{
+}
+
+static void audio_output_wav_write(const int16_t *mid, const int16_t *bass, size_t samples)
+{
+    size_t frames = samples / s_ch;
+    size_t width = s_ch * 2;
+
+    if (s_file == NULL) {
+        return;
+    }
+    while (frames > 0) {
+        size_t n = (frames < AUDIO_OUTPUT_WAV_FRAMES) ? frames : AUDIO_OUTPUT_WAV_FRAMES;
+        for (size_t i = 0; i < n; i++) {
+            memcpy(&s_frames[i * width], &mid[i * s_ch], s_ch * sizeof(int16_t));
+            memcpy(&s_frames[i * width + s_ch], &bass[i * s_ch], s_ch * sizeof(int16_t));
+        }
+        /* WAV is little endian like both targets */
+        fwrite(s_frames, sizeof(int16_t), n * width, s_file);
+        s_data_len += n * width * sizeof(int16_t);
+        mid += n * s_ch;
+        bass += n * s_ch;
+        frames -= n;
+    }
+}
+
+static void audio_output_wav_mute(void)
+{
+}
+
+static void audio_output_wav_close(void)
+{
+    audio_output_wav_finish();
+}
+
+static uint32_t audio_output_wav_latency_us(void)
+{
+    return 0;
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void audio_output_wav_set_path(const char *path)
+{
+    s_path = path;
+    s_file_num = 0;
+}
+
+/********************************
+ * EXTERNAL VARIABLE DEFINITIONS
+ *******************************/
+
+const audio_output_ops_t audio_output_wav = {
+    .name = "wav",
+    .open = audio_output_wav_open,
+    .set_format = audio_output_wav_set_format,
+    .enable = audio_output_wav_enable,
+    .write = audio_output_wav_write,
+    .mute = audio_output_wav_mute,
+    .close = audio_output_wav_close,
+    .latency_us = audio_output_wav_latency_us,
+};
@@ -0,0 +1,362 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "app_state.h"
+#include "audio_dsp.h"
+#include "audio_stall.h"
+#include "audio_preset.h"
+
+#define AUDIO_PRESET_NVS_NAMESPACE    "presets"
+#define AUDIO_PRESET_BLOB_VERSION     (2)
+
+/* one EQ band as stored, 5 bytes */
+typedef struct __attribute__((packed)) {
+    uint8_t  type;
+    uint16_t freq_hz;
+    int8_t   gain_db2;                                 /* 0.5 dB steps */
+    uint8_t  q20;                                      /* 0.05 steps */
+} audio_preset_blob_eq_t;
+
+/* a preset as stored in NVS, 140 bytes */
+typedef struct __attribute__((packed)) {
+    uint8_t  version;
+    uint8_t  gain_pct[AUDIO_PRESET_NUM_GAINS];
+    uint16_t crossover_hz;
+    uint16_t crossover_high_hz;
+    int8_t   limiter_db2;                              /* 0.5 dB steps */
+    int8_t   trim_db2[AUDIO_DSP_NUM_BANDS];            /* 0.5 dB steps */
+    uint16_t delay_us[AUDIO_DSP_NUM_BANDS];
+    uint8_t  eq_n[AUDIO_DSP_NUM_BANDS];
+    audio_preset_blob_eq_t eq[AUDIO_DSP_NUM_BANDS][DSP_EQ_MAX_BANDS];
+} audio_preset_blob_t;
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* built-in sound of a slot */
+static void audio_preset_default(int id, audio_preset_t *preset);
+/* round to an integer and clamp */
+static int32_t audio_preset_quantize(float v, float scale, int32_t lo, int32_t hi);
+/* preset to its stored form */
+static void audio_preset_pack(const audio_preset_t *preset, audio_preset_blob_t *blob);
+/* stored form to a preset */
+static void audio_preset_unpack(const audio_preset_blob_t *blob, audio_preset_t *preset);
+/* NVS key of a slot */
+static void audio_preset_key(int id, char *key);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const char *s_preset_str[AUDIO_PRESET_NUM] = {"party", "home", "night", "outdoor",
+                                                     "custom1", "custom2", "custom3"};
+
+static SemaphoreHandle_t s_preset_lock = NULL;     /* guards the table below */
+static audio_preset_t s_presets[AUDIO_PRESET_NUM];
+static bool s_stored[AUDIO_PRESET_NUM];
+static int s_current = AUDIO_PRESET_BOOT;
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static void audio_preset_default(int id, audio_preset_t *preset)
+{
+    audio_dsp_params_t *dsp = &preset->dsp;
+
+    audio_dsp_default_params(dsp);
+    preset->band_gain[AUDIO_DSP_BAND_BASS] = APP_STATE_HOME_BAND_GAIN;
+    preset->band_gain[AUDIO_DSP_BAND_MID] = APP_STATE_HOME_BAND_GAIN;
+
+    switch (id) {
+    case AUDIO_PRESET_PARTY:
+        preset->band_gain[AUDIO_DSP_BAND_BASS] = APP_STATE_PARTY_BAND_GAIN;
+        preset->band_gain[AUDIO_DSP_BAND_MID] = APP_STATE_PARTY_BAND_GAIN;
+        break;
+    case AUDIO_PRESET_NIGHT:
+        /* less bass through the walls, tighter ceiling, a little presence for speech */
+        dsp->limiter_db = -9.0f;
+        dsp->trim_db[AUDIO_DSP_BAND_BASS] = -8.0f;
+        dsp->eq_n[AUDIO_DSP_BAND_MID] = 1;
+        dsp->eq[AUDIO_DSP_BAND_MID][0] = (dsp_eq_band_t) {
+            .type = DSP_EQ_PEAK, .freq_hz = 2500.0f, .gain_db = 2.0f, .q = 1.0f,
+        };
+        break;
+    case AUDIO_PRESET_OUTDOOR:
+        /* no room gain at the low end and air absorbs the top */
+        preset->band_gain[AUDIO_DSP_BAND_BASS] = APP_STATE_PARTY_BAND_GAIN;
+        preset->band_gain[AUDIO_DSP_BAND_MID] = APP_STATE_PARTY_BAND_GAIN;
+        dsp->limiter_db = -1.0f;
+        dsp->eq_n[AUDIO_DSP_BAND_BASS] = 1;
+        dsp->eq[AUDIO_DSP_BAND_BASS][0] = (dsp_eq_band_t) {
+            .type = DSP_EQ_LOW_SHELF, .freq_hz = 80.0f, .gain_db = 4.0f, .q = 0.707f,
+        };
+        dsp->eq_n[AUDIO_DSP_BAND_MID] = 1;
+        dsp->eq[AUDIO_DSP_BAND_MID][0] = (dsp_eq_band_t) {
+            .type = DSP_EQ_HIGH_SHELF, .freq_hz = 6000.0f, .gain_db = 3.0f, .q = 0.707f,
+        };
+        break;
+    default:
+        /* home, and custom slots start out as home */
+        break;
+    }
+}
+
+static int32_t audio_preset_quantize(float v, float scale, int32_t lo, int32_t hi)
+{
+    int32_t q = (int32_t)lroundf(v * scale);
+
+    if (q < lo) {
+        return lo;
+    }
+    return (q > hi) ? hi : q;
+}
+
+static void audio_preset_pack(const audio_preset_t *preset, audio_preset_blob_t *blob)
+{
+    const audio_dsp_params_t *dsp = &preset->dsp;
+
+    memset(blob, 0, sizeof(*blob));
+    blob->version = AUDIO_PRESET_BLOB_VERSION;
+    blob->crossover_hz = (uint16_t)audio_preset_quantize(dsp->crossover_hz, 1.0f, 0, UINT16_MAX);
+    blob->crossover_high_hz = (uint16_t)audio_preset_quantize(dsp->crossover_high_hz, 1.0f, 0, UINT16_MAX);
+    blob->limiter_db2 = (int8_t)audio_preset_quantize(dsp->limiter_db, 2.0f, INT8_MIN, 0);
+    for (int b = 0; b < AUDIO_PRESET_NUM_GAINS; b++) {
+        blob->gain_pct[b] = (uint8_t)audio_preset_quantize(preset->band_gain[b], 100.0f, 0, 100);
+    }
+    for (int b = 0; b < AUDIO_DSP_NUM_BANDS; b++) {
+        blob->trim_db2[b] = (int8_t)audio_preset_quantize(dsp->trim_db[b], 2.0f, INT8_MIN, 0);
+        blob->delay_us[b] = (uint16_t)audio_preset_quantize(dsp->delay_ms[b], 1000.0f, 0, UINT16_MAX);
+        blob->eq_n[b] = (dsp->eq_n[b] > DSP_EQ_MAX_BANDS) ? DSP_EQ_MAX_BANDS : dsp->eq_n[b];
+        for (int i = 0; i < blob->eq_n[b]; i++) {
+            const dsp_eq_band_t *band = &dsp->eq[b][i];
+            audio_preset_blob_eq_t *eq = &blob->eq[b][i];
+            eq->type = band->type;
+            eq->freq_hz = (uint16_t)audio_preset_quantize(band->freq_hz, 1.0f, 0, UINT16_MAX);
+            eq->gain_db2 = (int8_t)audio_preset_quantize(band->gain_db, 2.0f, INT8_MIN, INT8_MAX);
+            eq->q20 = (uint8_t)audio_preset_quantize(band->q, 20.0f, 1, UINT8_MAX);
+        }
+    }
+}
+
+static void audio_preset_unpack(const audio_preset_blob_t *blob, audio_preset_t *preset)
+{
+    audio_dsp_params_t *dsp = &preset->dsp;
+
+    audio_dsp_default_params(dsp);
+    dsp->crossover_hz = blob->crossover_hz;
+    dsp->crossover_high_hz = blob->crossover_high_hz;
+    dsp->limiter_db = blob->limiter_db2 / 2.0f;
+    for (int b = 0; b < AUDIO_PRESET_NUM_GAINS; b++) {
+        preset->band_gain[b] = blob->gain_pct[b] / 100.0f;
+    }
+    for (int b = 0; b < AUDIO_DSP_NUM_BANDS; b++) {
+        dsp->trim_db[b] = blob->trim_db2[b] / 2.0f;
+        dsp->delay_ms[b] = blob->delay_us[b] / 1000.0f;
+        dsp->eq_n[b] = (blob->eq_n[b] > DSP_EQ_MAX_BANDS) ? DSP_EQ_MAX_BANDS : blob->eq_n[b];
+        for (int i = 0; i < dsp->eq_n[b]; i++) {
+            const audio_preset_blob_eq_t *eq = &blob->eq[b][i];
+            dsp->eq[b][i] = (dsp_eq_band_t) {
+                .type = eq->type,
+                .freq_hz = eq->freq_hz,
+                .gain_db = eq->gain_db2 / 2.0f,
+                .q = eq->q20 / 20.0f,
+            };
+        }
+    }
+}
+
+static void audio_preset_key(int id, char *key)
+{
+    /* NVS keys are limited to 15 characters, the slot number is enough */
+    key[0] = 'p';
+    key[1] = (char)('0' + id);
+    key[2] = '\0';
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void audio_preset_init(int id)
+{
+    nvs_handle_t handle;
+    audio_preset_blob_t blob;
+    char key[4];
+
+    if (s_preset_lock != NULL) {
+        return;
+    }
+    s_preset_lock = xSemaphoreCreateMutex();
+    for (int i = 0; i < AUDIO_PRESET_NUM; i++) {
+        audio_preset_default(i, &s_presets[i]);
+    }
+
+    esp_err_t err = nvs_open(AUDIO_PRESET_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_OK) {
+        for (int i = 0; i < AUDIO_PRESET_NUM; i++) {
+            size_t len = sizeof(blob);
+            audio_preset_key(i, key);
+            if (nvs_get_blob(handle, key, &blob, &len) != ESP_OK) {
+                continue;
+            }
+            if (len != sizeof(blob) || blob.version != AUDIO_PRESET_BLOB_VERSION) {
+                ESP_LOGW(AUDIO_PRESET_TAG, "%s, %s has an unknown layout, using defaults", __func__, s_preset_str[i]);
+                continue;
+            }
+            audio_preset_unpack(&blob, &s_presets[i]);
+            s_stored[i] = true;
+        }
+        nvs_close(handle);
+    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW(AUDIO_PRESET_TAG, "%s, nvs_open failed: %s", __func__, esp_err_to_name(err));
+    }
+
+    if (id < 0 || id >= AUDIO_PRESET_NUM) {
+        id = AUDIO_PRESET_BOOT;
+    }
+    audio_preset_select(id);
+}
+
+esp_err_t audio_preset_select(int id)
+{
+    audio_preset_t preset;
+    audio_dsp_params_t live;
+
+    if (id < 0 || id >= AUDIO_PRESET_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    audio_preset_get(id, &preset);
+
+    /* the routing describes the wiring, not the sound */
+    audio_dsp_get_params(&live);
+    preset.dsp.ways = live.ways;
+    memcpy(preset.dsp.route, live.route, sizeof(preset.dsp.route));
+
+    /* filters first, the band gains then ramp in on top of the crossfade */
+    esp_err_t err = audio_dsp_set_params(&preset.dsp);
+    if (err != ESP_OK) {
+        return err;
+    }
+    app_state_set_preset((uint8_t)id, id == AUDIO_PRESET_PARTY,
+                         preset.band_gain[AUDIO_DSP_BAND_BASS], preset.band_gain[AUDIO_DSP_BAND_MID]);
+    __atomic_store_n(&s_current, id, __ATOMIC_RELAXED);
+
+    ESP_LOGI(AUDIO_PRESET_TAG, "preset %s selected", s_preset_str[id]);
+    return ESP_OK;
+}
+
+int audio_preset_next(void)
+{
+    int id = audio_preset_current();
+
+    for (int i = 0; i < AUDIO_PRESET_NUM; i++) {
+        id = (id + 1) % AUDIO_PRESET_NUM;
+        if (id < AUDIO_PRESET_CUSTOM_1 || audio_preset_is_stored(id)) {
+            break;
+        }
+    }
+    return id;
+}
+
+int audio_preset_current(void)
+{
+    return __atomic_load_n(&s_current, __ATOMIC_RELAXED);
+}
+
+esp_err_t audio_preset_store(int id)
+{
+    audio_preset_t preset;
+    audio_preset_blob_t blob;
+    app_state_t state;
+    nvs_handle_t handle;
+    char key[4];
+
+    if (id < 0 || id >= AUDIO_PRESET_NUM || s_preset_lock == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    app_state_read(&state);
+    audio_dsp_get_params(&preset.dsp);
+    preset.band_gain[AUDIO_DSP_BAND_BASS] = state.volume_bass;
+    preset.band_gain[AUDIO_DSP_BAND_MID] = state.volume_mid;
+    audio_preset_pack(&preset, &blob);
+
+    audio_preset_key(id, key);
+    audio_stall_flash_begin();
+    esp_err_t err = nvs_open(AUDIO_PRESET_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, key, &blob, sizeof(blob));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    audio_stall_flash_end();
+    if (err != ESP_OK) {
+        ESP_LOGE(AUDIO_PRESET_TAG, "%s, %s not written: %s", __func__, s_preset_str[id], esp_err_to_name(err));
+        return err;
+    }
+
+    audio_preset_unpack(&blob, &preset);
+    xSemaphoreTake(s_preset_lock, portMAX_DELAY);
+    s_presets[id] = preset;
+    s_stored[id] = true;
+    xSemaphoreGive(s_preset_lock);
+
+    ESP_LOGI(AUDIO_PRESET_TAG, "preset %s stored, %u bytes", s_preset_str[id], (unsigned)sizeof(blob));
+    return ESP_OK;
+}
+
+void audio_preset_get(int id, audio_preset_t *preset)
+{
+    if (id < 0 || id >= AUDIO_PRESET_NUM) {
+        id = AUDIO_PRESET_BOOT;
+    }
+    if (s_preset_lock == NULL) {
+        audio_preset_default(id, preset);
+        return;
+    }
+    xSemaphoreTake(s_preset_lock, portMAX_DELAY);
+    *preset = s_presets[id];
+    xSemaphoreGive(s_preset_lock);
+}
+
+bool audio_preset_is_stored(int id)
+{
+    bool stored = false;
+
+    if (id < 0 || id >= AUDIO_PRESET_NUM || s_preset_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(s_preset_lock, portMAX_DELAY);
+    stored = s_stored[id];
+    xSemaphoreGive(s_preset_lock);
+    return stored;
+}
+
+const char *audio_preset_name(int id)
+{
+    return (id >= 0 && id < AUDIO_PRESET_NUM) ? s_preset_str[id] : "unknown";
+}
+
+int audio_preset_from_name(const char *name)
+{
+    for (int i = 0; i < AUDIO_PRESET_NUM; i++) {
+        if (strcmp(name, s_preset_str[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
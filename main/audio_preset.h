@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __AUDIO_PRESET_H__
+#define __AUDIO_PRESET_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "audio_dsp.h"
+
+/* log tag */
+#define AUDIO_PRESET_TAG    "AUDIO_PRESET"
+
+/* preset slots, the built-in ones can be overwritten too */
+typedef enum {
+    AUDIO_PRESET_PARTY = 0,
+    AUDIO_PRESET_HOME,
+    AUDIO_PRESET_NIGHT,
+    AUDIO_PRESET_OUTDOOR,
+    AUDIO_PRESET_CUSTOM_1,
+    AUDIO_PRESET_CUSTOM_2,
+    AUDIO_PRESET_CUSTOM_3,
+    AUDIO_PRESET_NUM,
+} audio_preset_id_t;
+
+/* preset selected at first boot, matches the initial app_state */
+#define AUDIO_PRESET_BOOT    AUDIO_PRESET_HOME
+
+/* mode gains kept per preset: bass, and mid which also drives the high band */
+#define AUDIO_PRESET_NUM_GAINS    (AUDIO_DSP_BAND_MID + 1)
+
+/* a complete sound configuration, the band count and routing follow the wiring instead */
+typedef struct {
+    float              band_gain[AUDIO_PRESET_NUM_GAINS];   /*!< mode gain per band 0 ~ 1 */
+    audio_dsp_params_t dsp;
+} audio_preset_t;
+
+/**
+ * @brief  load every slot from NVS into RAM and select the first preset
+ *
+ *         Call once after nvs_flash_init and audio_dsp_init. Slots that were
+ *         never stored, or hold a blob of another layout, get their built-in
+ *         defaults.
+ *
+ * @param [in] id  preset to start with, AUDIO_PRESET_BOOT if it is out of range
+ */
+void audio_preset_init(int id);
+
+/**
+ * @brief  switch to a preset
+ *
+ *         Works from the RAM copy only. Coefficients are computed in the calling
+ *         task; the audio path crossfades the filters over DSP_EQ_FADE_FRAMES
+ *         frames and ramps the band gains over one block. The live band count
+ *         and routing are kept.
+ *
+ * @param [in] id  preset slot
+ *
+ * @return  ESP_OK, ESP_ERR_INVALID_ARG for an unknown slot
+ */
+esp_err_t audio_preset_select(int id);
+
+/**
+ * @brief  next preset in gesture order, skipping custom slots that were never stored
+ */
+int audio_preset_next(void);
+
+/**
+ * @brief  currently selected preset
+ */
+int audio_preset_current(void);
+
+/**
+ * @brief  capture the live sound parameters and band gains into a slot and write it to NVS
+ *
+ *         The RAM copy holds the values as stored, so reselecting the slot
+ *         sounds exactly like it will after a reboot.
+ *
+ * @param [in] id  preset slot
+ *
+ * @return  ESP_OK, ESP_ERR_INVALID_ARG for an unknown slot, or the NVS error
+ */
+esp_err_t audio_preset_store(int id);
+
+/**
+ * @brief  copy of a slot
+ */
+void audio_preset_get(int id, audio_preset_t *preset);
+
+/**
+ * @brief  the slot was stored by the user rather than holding its built-in defaults
+ */
+bool audio_preset_is_stored(int id);
+
+/**
+ * @brief  name of a preset as used in the JSON API
+ */
+const char *audio_preset_name(int id);
+
+/**
+ * @brief  preset slot from its name
+ *
+ * @return  audio_preset_id_t, or -1 if the name is unknown
+ */
+int audio_preset_from_name(const char *name);
+
+#endif /* __AUDIO_PRESET_H__ */
@@ -0,0 +1,116 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "audio_stall.h"
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_stall_stats_t s_stats;
+static uint32_t s_flash_busy = 0;          /* flash writes in progress */
+static int64_t s_flash_start_us = 0;       /* first of the writes in progress began */
+static int64_t s_flash_end_us = -1;        /* last write finished */
+static uint64_t s_stall_total_us = 0;
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void audio_stall_flash_begin(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_flash_busy++ == 0) {
+        s_flash_start_us = now;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void audio_stall_flash_end(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_flash_busy > 0 && --s_flash_busy == 0) {
+        uint32_t us = (uint32_t)(now - s_flash_start_us);
+        if (us > s_stats.flash_max_us) {
+            s_stats.flash_max_us = us;
+        }
+    }
+    s_flash_end_us = now;
+    s_stats.flash_writes++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void audio_stall_block_done(int64_t start_us)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t us = (uint32_t)(now - start_us);
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.blocks++;
+    /* a write that was running or ended during the block had the cache off for part of it */
+    if (s_flash_busy > 0 || s_flash_end_us >= start_us) {
+        s_stats.stalled_blocks++;
+        s_stall_total_us += us;
+        s_stats.stall_total_ms = (uint32_t)(s_stall_total_us / 1000);
+        if (us > s_stats.stall_max_us) {
+            s_stats.stall_max_us = us;
+        }
+    } else if (us > s_stats.block_max_us) {
+        s_stats.block_max_us = us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void IRAM_ATTR audio_stall_dma_underrun(void)
+{
+    portENTER_CRITICAL_ISR(&s_lock);
+    s_stats.dma_underruns++;
+    portEXIT_CRITICAL_ISR(&s_lock);
+}
+
+void audio_stall_get_stats(audio_stall_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+int audio_stall_to_json(char *buf, size_t len)
+{
+    audio_stall_stats_t stats;
+
+    audio_stall_get_stats(&stats);
+    int n = snprintf(buf, len,
+                     "{\"iram\":%s,\"dma_ms\":%d,"
+                     "\"flash\":{\"writes\":%" PRIu32 ",\"max_us\":%" PRIu32 "},"
+                     "\"blocks\":{\"count\":%" PRIu32 ",\"max_us\":%" PRIu32 "},"
+                     "\"stalls\":{\"count\":%" PRIu32 ",\"max_us\":%" PRIu32 ",\"total_ms\":%" PRIu32 "},"
+                     "\"dma_underruns\":%" PRIu32 "}",
+#if CONFIG_EXAMPLE_AUDIO_IRAM
+                     "true",
+#else
+                     "false",
+#endif
+                     CONFIG_EXAMPLE_AUDIO_DMA_MS,
+                     stats.flash_writes, stats.flash_max_us,
+                     stats.blocks, stats.block_max_us,
+                     stats.stalled_blocks, stats.stall_max_us, stats.stall_total_ms,
+                     stats.dma_underruns);
+    return (n < 0 || (size_t)n >= len) ? -1 : n;
+}
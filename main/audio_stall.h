@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __AUDIO_STALL_H__
+#define __AUDIO_STALL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* log tag */
+#define AUDIO_STALL_TAG    "AUDIO_STALL"
+
+/* what flash writes cost the audio path since boot */
+typedef struct {
+    uint32_t flash_writes;      /*!< NVS writes bracketed by audio_stall_flash_begin / end */
+    uint32_t flash_max_us;      /*!< longest of them */
+    uint32_t blocks;            /*!< audio blocks processed */
+    uint32_t block_max_us;      /*!< longest block clear of any flash write */
+    uint32_t stalled_blocks;    /*!< blocks that overlapped a flash write, the cache was off for part of them */
+    uint32_t stall_max_us;      /*!< longest such block */
+    uint32_t stall_total_ms;    /*!< time spent in such blocks */
+    uint32_t dma_underruns;     /*!< the I2S DMA ran out of fresh audio and played silence */
+} audio_stall_stats_t;
+
+/**
+ * @brief  a flash write is about to start, call from the task that writes
+ *
+ *         While flash is written the cache is off and no task runs, the I2S
+ *         DMA plays what it holds. Writes of the application (settings,
+ *         presets) are bracketed; NVS writes of the WiFi and BT stacks are not.
+ */
+void audio_stall_flash_begin(void);
+
+/**
+ * @brief  the flash write started by audio_stall_flash_begin is done
+ */
+void audio_stall_flash_end(void);
+
+/**
+ * @brief  account one audio block, runs in the audio path
+ *
+ * @param [in] start_us  esp_timer_get_time() when processing of the block began
+ */
+void audio_stall_block_done(int64_t start_us);
+
+/**
+ * @brief  the I2S DMA replayed a buffer the audio task did not refill, callable from an ISR
+ */
+void audio_stall_dma_underrun(void);
+
+/**
+ * @brief  counters since boot, safe to call from any task
+ */
+void audio_stall_get_stats(audio_stall_stats_t *stats);
+
+/**
+ * @brief  serialise the counters and the DMA depth as JSON
+ *
+ * @param [out] buf  output buffer
+ * @param [in]  len  output buffer size in byte
+ *
+ * @return  length of the JSON text, -1 if it does not fit
+ */
+int audio_stall_to_json(char *buf, size_t len);
+
+#endif /* __AUDIO_STALL_H__ */
@@ -6,6 +6,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
@@ -21,28 +22,31 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#ifdef CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_INTERNAL_DAC
-#include "driver/dac_continuous.h"
-#else
-#include "driver/i2s_std.h"
-#endif
+#include "freertos/semphr.h"
 #include "driver/gpio.h"
 #include "esp_timer.h"
 #include "sys/lock.h"
+#include "sys/param.h"
+#include "silence_gate.h"
+#include "speaker_state.h"
+#include "wifi_coex.h"
+#include "trace.h"
+#include "app_state.h"
+#include "audio_dsp.h"
+#include "audio_stall.h"
+#include "audio_output.h"
+#include "pcm_tap.h"
+#include "mem_telemetry.h"
 #define MAX_AUDIO_BUF 8192 // حداکثر اندازه بافر صوتی (بسته به پروژه قابل تغییر است)
-#define IIR_ALPHA 0.04f    // ضریب فیلتر پایین‌گذر (120Hz برای 44100Hz)
 
 // بافر استاتیک برای جلوگیری از malloc/free
 static int16_t audio_mid[MAX_AUDIO_BUF / 2];
 static int16_t audio_bass[MAX_AUDIO_BUF / 2];
 
-// متغیر فیلتر پایین‌گذر
-static float lp_y = 0;
 
-// ولوم جداگانه برای هر خروجی (۰ تا ۱)
-static float volume_bass = 0.2f;
-static float volume_mid = 0.2f;
-extern bool party_mode;
+// تشخیص سکوت برای خاموش کردن آمپ و کلاک I2S
+static silence_gate_t s_silence_gate;
+static bool s_silence_gate_ready = false;
 
 /*******************************
  * STATIC FUNCTION DECLARATIONS
@@ -58,12 +62,20 @@ static void bt_av_playback_changed(void);
 static void bt_av_play_pos_changed(void);
 /* notification event handler */
 static void bt_av_notify_evt_handler(uint8_t event_id, esp_avrc_rn_param_t *event_parameter);
-/* installation for i2s */
-static void bt_i2s_driver_install(void);
-/* uninstallation for i2s */
-static void bt_i2s_driver_uninstall(void);
+/* switch the output to a new stream format once the block in flight is out, and reset the gate for it */
+static void bt_audio_output_reclock(uint32_t sample_rate, uint8_t ch_count);
+/* stop the I2S task and leave the output playing silence */
+static void bt_audio_output_idle(void);
+/* run the DSP chain on a block and write it, caller holds s_output_lock */
+static bool bt_app_audio_output_locked(const uint8_t *data, size_t len);
 /* mute i2s*/
 void mute_audio_output();
+/* reset the silence gate and power the outputs, caller holds s_output_lock */
+static void bt_audio_gate_reset(uint32_t samples_per_sec);
+/* gate amplifiers and output clocks after a ramp to mute */
+static void bt_audio_outputs_sleep(void);
+/* power amplifiers and output clocks up again */
+static void bt_audio_outputs_wake(void);
 /* set volume by remote controller */
 static void volume_set_by_controller(uint8_t volume);
 /* set volume by local host */
@@ -75,7 +87,6 @@ static void bt_av_hdl_avrc_ct_evt(uint16_t event, void *p_param);
 /* avrc target event handler */
 static void bt_av_hdl_avrc_tg_evt(uint16_t event, void *p_param);
 
-static void encoder_poll_task(void *arg);
 static void encoder_button_task(void *arg);
 
 /*******************************
@@ -91,17 +102,8 @@ static const char *s_a2d_audio_state_str[] = {"Suspended", "Started"};
 /* audio stream datapath state in string */
 static esp_avrc_rn_evt_cap_mask_t s_avrc_peer_rn_cap;
 /* AVRC target notification capability bit mask */
-static _lock_t s_volume_lock;
-static TaskHandle_t s_encoder_task_hdl = NULL;
-static uint8_t s_volume = 100; /* local volume value */
 static bool s_volume_notify;    /* notify volume change or not */
-#ifndef CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_INTERNAL_DAC
-// i2s_chan_handle_t tx_chan = NULL;
-i2s_chan_handle_t tx_chan_mid = NULL;
-i2s_chan_handle_t tx_chan_bass = NULL;
-#else
-dac_continuous_handle_t tx_chan;
-#endif
+static SemaphoreHandle_t s_output_lock = NULL;    /* the I2S task is between blocks while held */
 
 #if CONFIG_EXAMPLE_AVRCP_CT_COVER_ART_ENABLE
 static bool cover_art_connected = false;
@@ -119,6 +121,13 @@ static void bt_app_alloc_meta_buffer(esp_avrc_ct_cb_param_t *param)
     esp_avrc_ct_cb_param_t *rc = (esp_avrc_ct_cb_param_t *)(param);
     uint8_t *attr_text = (uint8_t *)malloc(rc->meta_rsp.attr_length + 1);
 
+    mem_telemetry_alloc(MEM_TELEMETRY_AVRC_META, rc->meta_rsp.attr_length + 1, attr_text != NULL);
+    if (attr_text == NULL) {
+        /* the handler drops a response without text */
+        rc->meta_rsp.attr_length = 0;
+        rc->meta_rsp.attr_text = NULL;
+        return;
+    }
     memcpy(attr_text, rc->meta_rsp.attr_text, rc->meta_rsp.attr_length);
     attr_text[rc->meta_rsp.attr_length] = 0;
     rc->meta_rsp.attr_text = attr_text;
@@ -192,7 +201,7 @@ static void bt_av_notify_evt_handler(uint8_t event_id, esp_avrc_rn_param_t *even
         break;
     case ESP_AVRC_RN_PLAY_STATUS_CHANGE:
         ESP_LOGI(BT_AV_TAG, "Playback status changed: 0x%x", event_parameter->playback);
-        is_playing = (event_parameter->playback == ESP_AVRC_PLAYBACK_PLAYING);
+        app_state_set_playing(event_parameter->playback == ESP_AVRC_PLAYBACK_PLAYING);
         bt_av_playback_changed();
         break;
     case ESP_AVRC_RN_PLAY_POS_CHANGED:
@@ -204,107 +213,85 @@ static void bt_av_notify_evt_handler(uint8_t event_id, esp_avrc_rn_param_t *even
     }
 }
 
-void bt_i2s_driver_install(void)
+static void bt_audio_output_reclock(uint32_t sample_rate, uint8_t ch_count)
 {
-    i2s_chan_config_t chan_cfg_mid = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
-    i2s_chan_config_t chan_cfg_bass = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_1, I2S_ROLE_MASTER);
-
-    i2s_std_config_t std_cfg_mid = {
-        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(44100),
-        .slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO),
-        .gpio_cfg = {
-            .mclk = I2S_GPIO_UNUSED,
-            .bclk = CONFIG_MIDRANGE_I2S_BCK_PIN,
-            .ws = CONFIG_MIDRANGE_I2S_LRCK_PIN,
-            .dout = CONFIG_MIDRANGE_I2S_DATA_PIN,
-            .din = I2S_GPIO_UNUSED,
-            .invert_flags = {
-                .mclk_inv = false,
-                .bclk_inv = false,
-                .ws_inv = false,
-            },
-        },
-    };
-
-    i2s_std_config_t std_cfg_bass = {
-        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(44100),
-        .slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO),
-        .gpio_cfg = {
-            .mclk = I2S_GPIO_UNUSED,
-            .bclk = CONFIG_BASS_I2S_BCK_PIN,
-            .ws = CONFIG_BASS_I2S_LRCK_PIN,
-            .dout = CONFIG_BASS_I2S_DATA_PIN,
-            .din = I2S_GPIO_UNUSED,
-            .invert_flags = {
-                .mclk_inv = false,
-                .bclk_inv = false,
-                .ws_inv = false,
-            },
-        },
-    };
-
-    // Initialize I2S channels
-    esp_err_t ret_mid = i2s_new_channel(&chan_cfg_mid, &tx_chan_mid, NULL);
-    esp_err_t ret_bass = i2s_new_channel(&chan_cfg_bass, &tx_chan_bass, NULL);
-
-    if (ret_mid != ESP_OK || ret_bass != ESP_OK)
-    {
-        ESP_LOGE("I2S", "Failed to create I2S channels");
-        return;
-    }
-    // Configure and enable channels
-    i2s_channel_init_std_mode(tx_chan_mid, &std_cfg_mid);
-    i2s_channel_init_std_mode(tx_chan_bass, &std_cfg_bass);
+    /* drain: the block the I2S task is writing goes out first */
+    xSemaphoreTake(s_output_lock, portMAX_DELAY);
+    if (s_silence_gate.state == SILENCE_GATE_CLOSED)
+    {
+        /* the gate left the output disabled, bring it back for the new stream */
+        bt_audio_outputs_wake();
+    }
+    pcm_tap_set_format(sample_rate, ch_count);
+    audio_output_set_format(sample_rate, ch_count);
+    /* the I2S task updates the gate with every block, the lock keeps it out */
+    bt_audio_gate_reset(sample_rate * ch_count);
+    xSemaphoreGive(s_output_lock);
+}
 
-    i2s_channel_enable(tx_chan_mid);
-    i2s_channel_enable(tx_chan_bass);
+static void bt_audio_output_idle(void)
+{
+    xSemaphoreTake(s_output_lock, portMAX_DELAY);
+    /* the I2S task is between blocks while the lock is held, it can go */
+    bt_i2s_task_shut_down();
+    audio_output_silence();
+    xSemaphoreGive(s_output_lock);
+    audio_output_mark(false);
 }
+
 void mute_audio_output()
 {
-    memset(audio_mid, 0, sizeof(audio_mid));
-    memset(audio_bass, 0, sizeof(audio_bass));
-    size_t bytes_written_mid, bytes_written_bass;
-    i2s_channel_write(tx_chan_mid, audio_mid, sizeof(audio_mid), &bytes_written_mid, portMAX_DELAY);
-    i2s_channel_write(tx_chan_bass, audio_bass, sizeof(audio_bass), &bytes_written_bass, portMAX_DELAY);
+    audio_output_silence();
 }
-void bt_i2s_driver_uninstall(void)
+
+static void bt_audio_gate_reset(uint32_t samples_per_sec)
 {
-    if (tx_chan_mid)
+    if (!s_silence_gate_ready)
     {
-        i2s_channel_disable(tx_chan_mid);
-        i2s_del_channel(tx_chan_mid);
-        tx_chan_mid = NULL;
-    }
-    if (tx_chan_bass)
-    {
-        i2s_channel_disable(tx_chan_bass);
-        i2s_del_channel(tx_chan_bass);
-        tx_chan_bass = NULL;
+#if CONFIG_EXAMPLE_SILENCE_GATE_ENABLE
+        silence_gate_init(&s_silence_gate, CONFIG_EXAMPLE_SILENCE_GATE_THRESHOLD,
+                          CONFIG_EXAMPLE_SILENCE_GATE_TIMEOUT_S * 1000);
+#else
+        silence_gate_init(&s_silence_gate, 0, 0);
+#endif
+        s_silence_gate_ready = true;
     }
+    silence_gate_set_rate(&s_silence_gate, samples_per_sec);
+    silence_gate_reset(&s_silence_gate);
+    gpio_set_level(RELAY_GPIO, 1);
+}
+
+
+static void bt_audio_outputs_sleep(void)
+{
+    /* the last block was ramped down, the output flushes zeros before its clocks stop */
+    audio_output_enable(false);
+    gpio_set_level(RELAY_GPIO, 0);
+    ESP_LOGI(SILENCE_GATE_TAG, "silence for %" PRIu32 " ms, outputs gated", s_silence_gate.timeout_ms);
+}
+
+static void bt_audio_outputs_wake(void)
+{
+    audio_output_enable(true);
+    gpio_set_level(RELAY_GPIO, 1);
+    ESP_LOGI(SILENCE_GATE_TAG, "signal returned, outputs re-armed");
 }
 
 static void volume_set_by_controller(uint8_t volume)
 {
-    ESP_LOGI(BT_RC_TG_TAG, "Volume is set by remote controller to: %" PRIu32 "%%", (uint32_t)volume * 100 / 500);
-    /* set the volume in protection of lock */
-    _lock_acquire(&s_volume_lock);
-    s_volume = volume;
-    _lock_release(&s_volume_lock);
+    ESP_LOGI(BT_RC_TG_TAG, "Volume is set by remote controller to: %" PRIu32 "%%", (uint32_t)volume * 100 / 127);
+    app_state_set_volume(volume);
 }
 
 static void volume_set_by_local_host(uint8_t volume)
 {
-    ESP_LOGI(BT_RC_TG_TAG, "Volume is set locally to: %" PRIu32 "%%", (uint32_t)volume * 100 / 500);
-    /* set the volume in protection of lock */
-    _lock_acquire(&s_volume_lock);
-    s_volume = volume;
-    _lock_release(&s_volume_lock);
+    app_state_set_volume(volume);
 
     /* send notification response to remote AVRCP controller */
     if (s_volume_notify)
     {
         esp_avrc_rn_param_t rn_param;
-        rn_param.volume = s_volume;
+        rn_param.volume = volume;
         esp_avrc_tg_send_rn_rsp(ESP_AVRC_RN_VOLUME_CHANGE, ESP_AVRC_RN_RSP_CHANGED, &rn_param);
         s_volume_notify = false;
     }
@@ -328,19 +315,23 @@ static void bt_av_hdl_a2d_evt(uint16_t event, void *p_param)
         if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED)
         {
             esp_bt_gap_set_scan_mode(ESP_BT_CONNECTABLE, ESP_BT_GENERAL_DISCOVERABLE);
-            mute_audio_output();
-            vTaskDelay(pdMS_TO_TICKS(50));
-            bt_i2s_driver_uninstall();
-            bt_i2s_task_shut_down();
+            speaker_state_clear_track();
+            wifi_coex_set_streaming(false);
+            /* the ports keep their clocks and play silence until the next connection */
+            bt_audio_output_idle();
         }
         else if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_CONNECTED)
         {
             esp_bt_gap_set_scan_mode(ESP_BT_NON_CONNECTABLE, ESP_BT_NON_DISCOVERABLE);
+            /* incoming connections may skip the connecting state */
+            audio_output_mark(true);
             bt_i2s_task_start_up();
         }
         else if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_CONNECTING)
         {
-            bt_i2s_driver_install();
+            /* a new attempt restarts the time to first audio */
+            audio_output_mark(false);
+            audio_output_mark(true);
         }
         break;
     }
@@ -354,6 +345,7 @@ static void bt_av_hdl_a2d_evt(uint16_t event, void *p_param)
         {
             s_pkt_cnt = 0;
         }
+        wifi_coex_set_streaming(ESP_A2D_AUDIO_STATE_STARTED == a2d->audio_stat.state);
         break;
     }
     /* when audio codec is configured, this event comes */
@@ -384,45 +376,8 @@ static void bt_av_hdl_a2d_evt(uint16_t event, void *p_param)
             {
                 ch_count = 1;
             }
-#ifdef CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_INTERNAL_DAC
-            dac_continuous_disable(tx_chan);
-            dac_continuous_del_channels(tx_chan);
-            dac_continuous_config_t cont_cfg = {
-                .chan_mask = DAC_CHANNEL_MASK_ALL,
-                .desc_num = 8,
-                .buf_size = 2048,
-                .freq_hz = sample_rate,
-                .offset = 127,
-                .clk_src = DAC_DIGI_CLK_SRC_DEFAULT, // Using APLL as clock source to get a wider frequency range
-                .chan_mode = (ch_count == 1) ? DAC_CHANNEL_MODE_SIMUL : DAC_CHANNEL_MODE_ALTER,
-            };
-            /* Allocate continuous channels */
-            dac_continuous_new_channels(&cont_cfg, &tx_chan);
-            /* Enable the continuous channels */
-            dac_continuous_enable(tx_chan);
-#else
-            // i2s_channel_disable(tx_chan);
-            // i2s_std_clk_config_t clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(sample_rate);
-            // i2s_std_slot_config_t slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, ch_count);
-            // i2s_channel_reconfig_std_clock(tx_chan, &clk_cfg);
-            // i2s_channel_reconfig_std_slot(tx_chan, &slot_cfg);
-            // i2s_channel_enable(tx_chan);
-
-            i2s_channel_disable(tx_chan_mid);
-            i2s_std_clk_config_t clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(sample_rate);
-            i2s_std_slot_config_t slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, ch_count);
-            i2s_channel_reconfig_std_clock(tx_chan_mid, &clk_cfg);
-            i2s_channel_reconfig_std_slot(tx_chan_mid, &slot_cfg);
-            i2s_channel_enable(tx_chan_mid);
-
-            i2s_channel_disable(tx_chan_bass);
-            // i2s_std_clk_config_t clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(sample_rate);
-            // i2s_std_slot_config_t slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, ch_count);
-            i2s_channel_reconfig_std_clock(tx_chan_bass, &clk_cfg);
-            i2s_channel_reconfig_std_slot(tx_chan_bass, &slot_cfg);
-            i2s_channel_enable(tx_chan_bass);
-
-#endif
+            bt_audio_output_reclock(sample_rate, ch_count);
+            audio_dsp_configure(sample_rate, ch_count);
             ESP_LOGI(BT_AV_TAG, "Configure audio player: %x-%x-%x-%x",
                      a2d->audio_cfg.mcc.cie.sbc[0],
                      a2d->audio_cfg.mcc.cie.sbc[1],
@@ -481,7 +436,9 @@ static void bt_av_hdl_a2d_evt(uint16_t event, void *p_param)
         a2d = (esp_a2d_cb_param_t *)(p_param);
         ESP_LOGI(BT_AV_TAG, "Get delay report value: delay_value: %u * 1/10 ms", a2d->a2d_get_delay_value_stat.delay_value);
         /* Default delay value plus delay caused by application layer */
-        esp_a2d_sink_set_delay_value(a2d->a2d_get_delay_value_stat.delay_value + APP_DELAY_VALUE);
+        /* what the output holds on top of the decoder, in 1/10 ms */
+        esp_a2d_sink_set_delay_value(a2d->a2d_get_delay_value_stat.delay_value + APP_DELAY_VALUE +
+                                     audio_output_latency_us() / 100);
         break;
     }
     /* others */
@@ -528,7 +485,12 @@ static void bt_av_hdl_avrc_ct_evt(uint16_t event, void *p_param)
     /* when metadata response, this event comes */
     case ESP_AVRC_CT_METADATA_RSP_EVT:
     {
+        if (rc->meta_rsp.attr_text == NULL)
+        {
+            break;
+        }
         ESP_LOGI(BT_RC_CT_TAG, "AVRC metadata rsp: attribute id 0x%x, %s", rc->meta_rsp.attr_id, rc->meta_rsp.attr_text);
+        speaker_state_set_track(rc->meta_rsp.attr_id, rc->meta_rsp.attr_text, rc->meta_rsp.attr_length);
 #if CONFIG_EXAMPLE_AVRCP_CT_COVER_ART_ENABLE
         if (rc->meta_rsp.attr_id == 0x80 && cover_art_connected && cover_art_getting == false)
         {
@@ -541,6 +503,7 @@ static void bt_av_hdl_avrc_ct_evt(uint16_t event, void *p_param)
         }
 #endif
         free(rc->meta_rsp.attr_text);
+        mem_telemetry_free(MEM_TELEMETRY_AVRC_META);
         break;
     }
     /* when notified, this event comes */
@@ -633,19 +596,10 @@ static void bt_av_hdl_avrc_tg_evt(uint16_t event, void *p_param)
         uint8_t *bda = rc->conn_stat.remote_bda;
         ESP_LOGI(BT_RC_TG_TAG, "AVRC conn_state evt: state %d, [%02x:%02x:%02x:%02x:%02x:%02x]",
                  rc->conn_stat.connected, bda[0], bda[1], bda[2], bda[3], bda[4], bda[5]);
-        if (rc->conn_stat.connected)
+        if (!rc->conn_stat.connected)
         {
-            /* create task to simulate volume change */
-            xTaskCreate(encoder_poll_task, "encoder_task", 6144, NULL, 5, &s_encoder_task_hdl);
-            // xTaskCreate(encoder_button_task, "encoder_button_task", 2048, NULL, 5, &s_encoderSW_task_hdl);
-            ESP_LOGI(BT_RC_TG_TAG, " ------ avrc task created --------");
-        }
-        else
-        {
-            vTaskDelete(s_encoder_task_hdl);
-            // vTaskDelete(s_encoderSW_task_hdl);
-
-            ESP_LOGI(BT_RC_TG_TAG, " ------ avrc task deleted --------");
+            /* the volume encoder keeps running, just stop notifying a peer that is gone */
+            s_volume_notify = false;
         }
         break;
     }
@@ -658,7 +612,7 @@ static void bt_av_hdl_avrc_tg_evt(uint16_t event, void *p_param)
     /* when absolute volume command from remote device set, this event comes */
     case ESP_AVRC_TG_SET_ABSOLUTE_VOLUME_CMD_EVT:
     {
-        ESP_LOGI(BT_RC_TG_TAG, "AVRC set absolute volume: %d%%", (int)rc->set_abs_vol.volume * 100 / 500);
+        ESP_LOGI(BT_RC_TG_TAG, "AVRC set absolute volume: %d%%", (int)rc->set_abs_vol.volume * 100 / 127);
         volume_set_by_controller(rc->set_abs_vol.volume);
         break;
     }
@@ -668,9 +622,11 @@ static void bt_av_hdl_avrc_tg_evt(uint16_t event, void *p_param)
         ESP_LOGI(BT_RC_TG_TAG, "AVRC register event notification: %d, param: 0x%" PRIx32, rc->reg_ntf.event_id, rc->reg_ntf.event_parameter);
         if (rc->reg_ntf.event_id == ESP_AVRC_RN_VOLUME_CHANGE)
         {
+            app_state_t state;
+            app_state_read(&state);
             s_volume_notify = true;
             esp_avrc_rn_param_t rn_param;
-            rn_param.volume = s_volume;
+            rn_param.volume = state.volume;
             esp_avrc_tg_send_rn_rsp(ESP_AVRC_RN_VOLUME_CHANGE, ESP_AVRC_RN_RSP_INTERIM, &rn_param);
         }
         break;
@@ -688,69 +644,43 @@ static void bt_av_hdl_avrc_tg_evt(uint16_t event, void *p_param)
     }
 }
 
-static void encoder_poll_task(void *arg)
-{
-    gpio_set_direction(ENCODER_PIN_A, GPIO_MODE_INPUT);
-    gpio_set_direction(ENCODER_PIN_B, GPIO_MODE_INPUT);
-    gpio_pullup_en(ENCODER_PIN_A);
-    gpio_pullup_en(ENCODER_PIN_B);
-
-    int lastA = gpio_get_level(ENCODER_PIN_A);
-    int64_t last_tick = esp_timer_get_time() / 1000; // میلی‌ثانیه
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
 
-    while (1)
+void bt_app_output_init(void)
+{
+    if (s_output_lock != NULL)
     {
-        // همیشه مقدار ولوم را از s_volume بگیر
-        uint8_t volume;
-        _lock_acquire(&s_volume_lock);
-        volume = s_volume;
-        _lock_release(&s_volume_lock);
-
-        int A = gpio_get_level(ENCODER_PIN_A);
-        int B = gpio_get_level(ENCODER_PIN_B);
-        if (A != lastA)
-        {
-            int64_t now = esp_timer_get_time() / 1000;
-            int64_t delta = now - last_tick;
-            last_tick = now;
-
-            int step = 1;
-            if (delta < 50)
-                step = 5;
-            else if (delta < 120)
-                step = 3;
-            else if (delta < 300)
-                step = 2;
-            else
-                step = 1;
-
-            // فقط اگر ولوم به سقف/کف نرسیده باشد تغییر بده
-            if (B != A && volume < 127)
-            {
-                if (volume <= 127 - step)
-                    volume += step;
-                else
-                    volume = 127;
-            }
-            else if (B == A && volume > 0)
-            {
-                if (volume >= step)
-                    volume -= step;
-                else
-                    volume = 0;
-            }
-
-            ESP_LOGI("ENCODER", "-------------------------------Volume: %d (step: %d) partymode:%d", volume, step, party_mode);
-            volume_set_by_local_host(volume);
-            lastA = A;
-        }
-        vTaskDelay(pdMS_TO_TICKS(10));
+        return;
+    }
+    if ((s_output_lock = xSemaphoreCreateMutex()) == NULL)
+    {
+        ESP_LOGE(BT_AV_TAG, "%s, mutex create failed", __func__);
+        return;
+    }
+    /* the output is created stopped at 44.1 kHz stereo, enabled with the system power */
+    if (audio_output_init(audio_output_default()) != ESP_OK)
+    {
+        ESP_LOGE(BT_AV_TAG, "%s, no audio output", __func__);
     }
+    audio_dsp_configure(44100, 2);
 }
 
-/********************************
- * EXTERNAL FUNCTION DEFINITIONS
- *******************************/
+void bt_app_output_power(bool on)
+{
+    if (s_output_lock == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(s_output_lock, portMAX_DELAY);
+    if (on)
+    {
+        silence_gate_reset(&s_silence_gate);
+    }
+    audio_output_enable(on);
+    xSemaphoreGive(s_output_lock);
+}
 
 void bt_app_a2d_cb(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param)
 {
@@ -773,58 +703,87 @@ void bt_app_a2d_cb(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param)
     }
 }
 
+void bt_app_volume_step(int delta)
+{
+    int current, volume;
+    app_state_t state;
+
+    app_state_read(&state);
+    current = state.volume;
+
+    // فقط اگر ولوم به سقف/کف نرسیده باشد تغییر بده
+    volume = current + delta;
+    if (volume > 127)
+        volume = 127;
+    else if (volume < 0)
+        volume = 0;
+    if (volume == current)
+        return;
+
+    TRACE(TRACE_EV_VOLUME_STEP, volume, delta);
+    volume_set_by_local_host((uint8_t)volume);
+}
+
 void bt_app_a2d_data_cb(const uint8_t *data, uint32_t len)
+{
+    write_ringbuf(data, len);
+}
+
+bool bt_app_audio_output(const uint8_t *data, size_t len)
 {
     if (len > MAX_AUDIO_BUF)
-        return;
+        return true;
+
+    xSemaphoreTake(s_output_lock, portMAX_DELAY);
+    bool played = bt_app_audio_output_locked(data, len);
+    xSemaphoreGive(s_output_lock);
+    return played;
+}
 
+static bool bt_app_audio_output_locked(const uint8_t *data, size_t len)
+{
     int16_t *audio_in = (int16_t *)data;
     size_t samples = len / 2;
+    int32_t peak = 0;
 
-    float vol_factor = (float)s_volume / 500;
-    if (vol_factor > 1.0f)
-        vol_factor = 1.0f;
-
-    // float max_gain = party_mode ? 0.8f : 0.1f;
-    // float gain_bass = volume_bass > max_gain ? max_gain : volume_bass;
-    // float gain_mid = volume_mid > max_gain ? max_gain : volume_mid;
-
-    if (party_mode)
+    if (s_silence_gate.state == SILENCE_GATE_CLOSED)
     {
-        volume_bass = 1.0f;
-        volume_mid = 1.0f;
+        /* outputs are gated: only look for the signal to come back */
+        peak = silence_gate_peak(audio_in, samples);
+        if (silence_gate_update(&s_silence_gate, peak, samples) == SILENCE_GATE_ACT_OPEN)
+        {
+            bt_audio_outputs_wake();
+            /* let the caller prefetch while the amplifiers settle, then replay this block */
+            return false;
+        }
+        return true;
     }
-    else
+
+    pcm_tap_write(PCM_TAP_INPUT, audio_in, samples);
+    // تقسیم به باندها، gain، EQ، limiter و delay
+    int64_t start_us = esp_timer_get_time();
+    peak = audio_dsp_process(audio_in, samples, audio_bass, audio_mid);
+    audio_stall_block_done(start_us);
+    pcm_tap_write_ports(audio_mid, audio_bass, samples);
+
+    bool gate_close = (silence_gate_update(&s_silence_gate, peak, samples) == SILENCE_GATE_ACT_CLOSE);
+    if (gate_close)
     {
-        volume_bass = 0.3f;
-        volume_mid = 0.3f;
+        /* ramp the last block down to zero before the amplifiers are cut */
+        for (size_t i = 0; i < samples; i++)
+        {
+            int32_t g = (int32_t)(((samples - i) << 15) / samples);
+            audio_mid[i] = (int16_t)((audio_mid[i] * g) >> 15);
+            audio_bass[i] = (int16_t)((audio_bass[i] * g) >> 15);
+        }
     }
+    audio_output_write(audio_mid, audio_bass, samples);
 
-    for (size_t i = 0; i < samples; i++)
+    if (gate_close)
     {
-        float x = (float)(audio_in[i] * vol_factor);
-
-        lp_y = IIR_ALPHA * x + (1.0f - IIR_ALPHA) * lp_y;
-        // float bass = lp_y * volume_bass;
-        float bass = x * volume_bass;
-        
-        if (bass > 32767)
-            bass = 32767;
-        if (bass < -32768)
-            bass = -32768;
-        audio_bass[i] = (int16_t)bass;
-
-        float mid = (x - lp_y) * volume_mid;
-        if (mid > 32767)
-            mid = 32767;
-        if (mid < -32768)
-            mid = -32768;
-        audio_mid[i] = (int16_t)mid;
+        bt_audio_outputs_sleep();
     }
-
-    size_t bytes_written_mid, bytes_written_bass;
-    i2s_channel_write(tx_chan_mid, audio_mid, len, &bytes_written_mid, portMAX_DELAY);
-    i2s_channel_write(tx_chan_bass, audio_bass, len, &bytes_written_bass, portMAX_DELAY);
+    return true;
 }
 
 void bt_app_rc_ct_cb(esp_avrc_ct_cb_event_t event, esp_avrc_ct_cb_param_t *param)
@@ -8,6 +8,8 @@
 #define __BT_APP_AV_H__
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "esp_a2dp_api.h"
 #include "esp_avrc_api.h"
 
@@ -32,6 +34,42 @@ void bt_app_a2d_cb(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param);
  */
 void bt_app_a2d_data_cb(const uint8_t *data, uint32_t len);
 
+/**
+ * @brief  run the DSP chain on one block taken from the ringbuffer and write it to the outputs
+ *
+ * @param [in] data  interleaved 16-bit PCM block
+ * @param [in] len   length of the block in byte
+ *
+ * @return  false if the block woke the outputs up from the silence gate and has to be
+ *          replayed after the ringbuffer was prefetched, true otherwise
+ */
+bool bt_app_audio_output(const uint8_t *data, size_t len);
+
+/**
+ * @brief  create the audio output picked in menuconfig, once at boot
+ *
+ *         It is kept for the life of the application: connections only
+ *         feed it, a new stream format reclocks it and power off
+ *         disables it.
+ */
+void bt_app_output_init(void);
+
+/**
+ * @brief  start or stop the output clocks with the system power
+ *
+ *         Stopping fades to silence and flushes the output first.
+ *
+ * @param [in] on  clock the output
+ */
+void bt_app_output_power(bool on);
+
+/**
+ * @brief  change the local volume by a signed amount and notify the remote controller
+ *
+ * @param [in] delta  volume change in AVRCP absolute volume units (0 ~ 127 range)
+ */
+void bt_app_volume_step(int delta);
+
 /**
  * @brief  callback function for AVRCP controller
  *
@@ -57,8 +95,6 @@ typedef enum {
 
 
 void mute_audio_output();
-extern bool is_playing ;
-extern bool party_mode ;
 
 /* AVRCP used transaction labels */
 #define APP_RC_CT_TL_GET_CAPS (0)
@@ -75,6 +111,8 @@ extern bool party_mode ;
 
 #define CLICK_TIMEOUT_MS 400
 
+#define RELAY_GPIO 18
+
 #define PARTY_MODE_LED_GPIO 2 // پایه LED روی D1 R32 معمولاً GPIO2 است (LED آبی روی برد)
 
 
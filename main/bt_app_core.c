@@ -14,23 +14,16 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "bt_app_core.h"
-#ifdef CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_INTERNAL_DAC
-#include "driver/dac_continuous.h"
-#else
-#include "driver/i2s_std.h"
-#endif
+#include "bt_app_av.h"
+#include "trace.h"
+#include "mem_telemetry.h"
 #include "freertos/ringbuf.h"
 
 
 #define RINGBUF_HIGHEST_WATER_LEVEL    (32 * 1024)
 #define RINGBUF_PREFETCH_WATER_LEVEL   (20 * 1024)
 #define MAX_AUDIO_BUF (32 * 1024)
-
-enum {
-    RINGBUFFER_MODE_PROCESSING,    /* ringbuffer is buffering incoming audio data, I2S is working */
-    RINGBUFFER_MODE_PREFETCHING,   /* ringbuffer is buffering incoming audio data, I2S is waiting */
-    RINGBUFFER_MODE_DROPPING       /* ringbuffer is not buffering (dropping) incoming audio data, I2S is working */
-};
+#define I2S_ITEM_SIZE_UPTO             (240 * 6)
 
 /*******************************
  * STATIC FUNCTION DECLARATIONS
@@ -53,19 +46,13 @@ static QueueHandle_t s_bt_app_task_queue = NULL;  /* handle of work queue */
 static TaskHandle_t s_bt_app_task_handle = NULL;  /* handle of application task  */
 static TaskHandle_t s_bt_i2s_task_handle = NULL;  /* handle of I2S task */
 static RingbufHandle_t s_ringbuf_i2s = NULL;     /* handle of ringbuffer for I2S */
+static portMUX_TYPE s_ringbuf_lock = portMUX_INITIALIZER_UNLOCKED;  /* handle against the stats readers */
 static SemaphoreHandle_t s_i2s_write_semaphore = NULL;
 static uint16_t ringbuffer_mode = RINGBUFFER_MODE_PROCESSING;
-
-/*********************************
- * EXTERNAL FUNCTION DECLARATIONS
- ********************************/
-#ifndef CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_INTERNAL_DAC
-// extern i2s_chan_handle_t tx_chan;
-extern i2s_chan_handle_t tx_chan_mid;
-extern i2s_chan_handle_t tx_chan_bass;
-#else
-extern dac_continuous_handle_t tx_chan;
-#endif
+static uint8_t s_wake_block[I2S_ITEM_SIZE_UPTO];  /* block that re-armed the outputs, replayed after prefetch */
+static size_t s_wake_block_len = 0;
+static volatile uint32_t s_underflow_cnt = 0;     /* I2S task found the ringbuffer empty */
+static volatile uint32_t s_drop_cnt = 0;          /* packets dropped because the ringbuffer was full */
 
 /*******************************
  * STATIC FUNCTION DEFINITIONS
@@ -112,6 +99,7 @@ static void bt_app_task_handler(void *arg)
 
             if (msg.param) {
                 free(msg.param);
+                mem_telemetry_free(MEM_TELEMETRY_APP_MSG);
             }
         }
     }
@@ -126,28 +114,37 @@ static void bt_i2s_task_handler(void *arg)
      * `dma_frame_num * dma_desc_num * i2s_channel_num * i2s_data_bit_width / 8`.
      * Transmit `dma_frame_num * dma_desc_num` bytes to DMA is trade-off.
      */
-    const size_t item_size_upto = 240 * 6;
-    size_t bytes_written = 0;
+    const size_t item_size_upto = I2S_ITEM_SIZE_UPTO;
 
     for (;;) {
         if (pdTRUE == xSemaphoreTake(s_i2s_write_semaphore, portMAX_DELAY)) {
+            if (s_wake_block_len > 0) {
+                /* the amplifiers had a full prefetch to settle, play the block that woke them up */
+                bt_app_audio_output(s_wake_block, s_wake_block_len);
+                s_wake_block_len = 0;
+            }
             for (;;) {
                 item_size = 0;
                 /* receive data from ringbuffer and write it to I2S DMA transmit buffer */
                 data = (uint8_t *)xRingbufferReceiveUpTo(s_ringbuf_i2s, &item_size, (TickType_t)pdMS_TO_TICKS(20), item_size_upto);
                 if (item_size == 0) {
-                    ESP_LOGI(BT_APP_CORE_TAG, "ringbuffer underflowed! mode changed: RINGBUFFER_MODE_PREFETCHING");
+                    s_underflow_cnt++;
+                    TRACE(TRACE_EV_RB_UNDERFLOW, s_underflow_cnt, 0);
                     ringbuffer_mode = RINGBUFFER_MODE_PREFETCHING;
                     break;
                 }
 
-            #ifdef CONFIG_EXAMPLE_A2DP_SINK_OUTPUT_INTERNAL_DAC
-                dac_continuous_write(tx_chan, data, item_size, &bytes_written, -1);
-            #else
-            i2s_channel_write(tx_chan_mid, data, item_size, &bytes_written, portMAX_DELAY);
-            i2s_channel_write(tx_chan_bass, data, item_size, &bytes_written, portMAX_DELAY);
-            #endif
+                bool played = bt_app_audio_output(data, item_size);
+                if (!played) {
+                    memcpy(s_wake_block, data, item_size);
+                    s_wake_block_len = item_size;
+                }
                 vRingbufferReturnItem(s_ringbuf_i2s, (void *)data);
+                if (!played) {
+                    TRACE(TRACE_EV_OUT_REARM, s_wake_block_len, 0);
+                    ringbuffer_mode = RINGBUFFER_MODE_PREFETCHING;
+                    break;
+                }
             }
         }
     }
@@ -171,7 +168,9 @@ bool bt_app_work_dispatch(bt_app_cb_t p_cback, uint16_t event, void *p_params, i
     if (param_len == 0) {
         return bt_app_send_msg(&msg);
     } else if (p_params && param_len > 0) {
-        if ((msg.param = malloc(param_len)) != NULL) {
+        msg.param = malloc(param_len);
+        mem_telemetry_alloc(MEM_TELEMETRY_APP_MSG, param_len, msg.param != NULL);
+        if (msg.param != NULL) {
             memcpy(msg.param, p_params, param_len);
             /* check if caller has provided a copy callback to do the deep copy */
             if (p_copy_cback) {
@@ -188,7 +187,7 @@ void bt_app_task_start_up(void)
 {
     if (s_bt_app_task_queue == NULL) {
         s_bt_app_task_queue = xQueueCreate(10, sizeof(bt_app_msg_t));
-        xTaskCreate(bt_app_task_handler, "BtAppTask", 3072, NULL, 10, &s_bt_app_task_handle);
+        xTaskCreate(bt_app_task_handler, "BtAppTask", 4096, NULL, 10, &s_bt_app_task_handle);
     }
 }
 
@@ -208,15 +207,21 @@ void bt_i2s_task_start_up(void)
 {
     ESP_LOGI(BT_APP_CORE_TAG, "ringbuffer data empty! mode changed: RINGBUFFER_MODE_PREFETCHING");
     ringbuffer_mode = RINGBUFFER_MODE_PREFETCHING;
+    s_wake_block_len = 0;
     if ((s_i2s_write_semaphore = xSemaphoreCreateBinary()) == NULL) {
         ESP_LOGE(BT_APP_CORE_TAG, "%s, Semaphore create failed", __func__);
         return;
     }
-    if ((s_ringbuf_i2s = xRingbufferCreate(RINGBUF_HIGHEST_WATER_LEVEL, RINGBUF_TYPE_BYTEBUF)) == NULL) {
+    RingbufHandle_t ringbuf = xRingbufferCreate(RINGBUF_HIGHEST_WATER_LEVEL, RINGBUF_TYPE_BYTEBUF);
+    mem_telemetry_alloc(MEM_TELEMETRY_RINGBUF, RINGBUF_HIGHEST_WATER_LEVEL, ringbuf != NULL);
+    portENTER_CRITICAL(&s_ringbuf_lock);
+    s_ringbuf_i2s = ringbuf;
+    portEXIT_CRITICAL(&s_ringbuf_lock);
+    if (ringbuf == NULL) {
         ESP_LOGE(BT_APP_CORE_TAG, "%s, ringbuffer create failed", __func__);
         return;
     }
-    xTaskCreate(bt_i2s_task_handler, "BtI2STask", 2048, NULL, configMAX_PRIORITIES - 3, &s_bt_i2s_task_handle);
+    xTaskCreate(bt_i2s_task_handler, "BtI2STask", 3072, NULL, configMAX_PRIORITIES - 3, &s_bt_i2s_task_handle);
 }
 
 void bt_i2s_task_shut_down(void)
@@ -225,9 +230,14 @@ void bt_i2s_task_shut_down(void)
         vTaskDelete(s_bt_i2s_task_handle);
         s_bt_i2s_task_handle = NULL;
     }
-    if (s_ringbuf_i2s) {
-        vRingbufferDelete(s_ringbuf_i2s);
-        s_ringbuf_i2s = NULL;
+    /* unpublish first: a stats reader is either done with the ringbuffer or never sees it */
+    portENTER_CRITICAL(&s_ringbuf_lock);
+    RingbufHandle_t ringbuf = s_ringbuf_i2s;
+    s_ringbuf_i2s = NULL;
+    portEXIT_CRITICAL(&s_ringbuf_lock);
+    if (ringbuf) {
+        vRingbufferDelete(ringbuf);
+        mem_telemetry_free(MEM_TELEMETRY_RINGBUF);
     }
     if (s_i2s_write_semaphore) {
         vSemaphoreDelete(s_i2s_write_semaphore);
@@ -243,10 +253,11 @@ size_t write_ringbuf(const uint8_t *data, size_t size)
     if (size > MAX_AUDIO_BUF) return 0; // محافظت
 
     if (ringbuffer_mode == RINGBUFFER_MODE_DROPPING) {
-        ESP_LOGW(BT_APP_CORE_TAG, "ringbuffer is full, drop this packet!");
+        s_drop_cnt++;
         vRingbufferGetInfo(s_ringbuf_i2s, NULL, NULL, NULL, NULL, &item_size);
+        TRACE(TRACE_EV_RB_DROP, size, item_size);
         if (item_size <= RINGBUF_PREFETCH_WATER_LEVEL) {
-            ESP_LOGI(BT_APP_CORE_TAG, "ringbuffer data decreased! mode changed: RINGBUFFER_MODE_PROCESSING");
+            TRACE(TRACE_EV_RB_DRAINED, 0, item_size);
             ringbuffer_mode = RINGBUFFER_MODE_PROCESSING;
         }
         return 0;
@@ -254,15 +265,17 @@ size_t write_ringbuf(const uint8_t *data, size_t size)
 
     done = xRingbufferSend(s_ringbuf_i2s, (void *)data, size, (TickType_t)0);
 
-    if (!done) {
-        ESP_LOGW(BT_APP_CORE_TAG, "ringbuffer overflowed, ready to decrease data! mode changed: RINGBUFFER_MODE_DROPPING");
+    /* a full ring while prefetching still has to wake the I2S task below */
+    if (!done && ringbuffer_mode != RINGBUFFER_MODE_PREFETCHING) {
+        s_drop_cnt++;
+        TRACE(TRACE_EV_RB_OVERFLOW, size, RINGBUF_HIGHEST_WATER_LEVEL);
         ringbuffer_mode = RINGBUFFER_MODE_DROPPING;
     }
 
     if (ringbuffer_mode == RINGBUFFER_MODE_PREFETCHING) {
         vRingbufferGetInfo(s_ringbuf_i2s, NULL, NULL, NULL, NULL, &item_size);
         if (item_size >= RINGBUF_PREFETCH_WATER_LEVEL) {
-            ESP_LOGI(BT_APP_CORE_TAG, "ringbuffer data increased! mode changed: RINGBUFFER_MODE_PROCESSING");
+            TRACE(TRACE_EV_RB_PREFETCHED, 0, item_size);
             ringbuffer_mode = RINGBUFFER_MODE_PROCESSING;
             if (pdFALSE == xSemaphoreGive(s_i2s_write_semaphore)) {
                 ESP_LOGE(BT_APP_CORE_TAG, "semphore give failed");
@@ -272,3 +285,23 @@ size_t write_ringbuf(const uint8_t *data, size_t size)
 
     return done ? size : 0;
 }
+
+void bt_i2s_get_buffer_stats(bt_i2s_buffer_stats_t *stats)
+{
+    size_t item_size = 0;
+    bool active;
+
+    /* called from other tasks at any time, the ringbuffer may be deleted under them otherwise */
+    portENTER_CRITICAL(&s_ringbuf_lock);
+    active = (s_ringbuf_i2s != NULL);
+    if (active) {
+        vRingbufferGetInfo(s_ringbuf_i2s, NULL, NULL, NULL, NULL, &item_size);
+    }
+    portEXIT_CRITICAL(&s_ringbuf_lock);
+    stats->active = active;
+    stats->filled = item_size;
+    stats->capacity = RINGBUF_HIGHEST_WATER_LEVEL;
+    stats->mode = ringbuffer_mode;
+    stats->underflows = s_underflow_cnt;
+    stats->drops = s_drop_cnt;
+}
@@ -17,6 +17,22 @@
 /* signal for `bt_app_work_dispatch` */
 #define BT_APP_SIG_WORK_DISPATCH    (0x01)
 
+enum {
+    RINGBUFFER_MODE_PROCESSING,    /* ringbuffer is buffering incoming audio data, I2S is working */
+    RINGBUFFER_MODE_PREFETCHING,   /* ringbuffer is buffering incoming audio data, I2S is waiting */
+    RINGBUFFER_MODE_DROPPING       /* ringbuffer is not buffering (dropping) incoming audio data, I2S is working */
+};
+
+/* health of the audio ringbuffer */
+typedef struct {
+    bool     active;       /*!< ringbuffer exists, i.e. an A2DP source is connected */
+    size_t   filled;       /*!< bytes waiting for the I2S task */
+    size_t   capacity;     /*!< ringbuffer size in byte */
+    uint8_t  mode;         /*!< RINGBUFFER_MODE_* */
+    uint32_t underflows;   /*!< times the I2S task ran dry since boot */
+    uint32_t drops;        /*!< packets dropped on overflow since boot */
+} bt_i2s_buffer_stats_t;
+
 /**
  * @brief  handler for the dispatched work
  *
@@ -85,4 +101,11 @@ void bt_i2s_task_shut_down(void);
  */
 size_t write_ringbuf(const uint8_t *data, size_t size);
 
+/**
+ * @brief  read the ringbuffer fill level and error counters
+ *
+ * @param [out] stats  buffer health
+ */
+void bt_i2s_get_buffer_stats(bt_i2s_buffer_stats_t *stats);
+
 #endif /* __BT_APP_CORE_H__ */
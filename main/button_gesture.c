@@ -0,0 +1,76 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "button_gesture.h"
+
+void button_gesture_init(button_gesture_engine_t *engine, const button_gesture_config_t *cfg)
+{
+    memset(engine, 0, sizeof(*engine));
+    engine->cfg = *cfg;
+}
+
+void button_gesture_edge(button_gesture_engine_t *engine, bool pressed, int64_t now_ms)
+{
+    engine->raw_pressed = pressed;
+    engine->raw_change_ms = now_ms;
+}
+
+button_gesture_t button_gesture_poll(button_gesture_engine_t *engine, int64_t now_ms)
+{
+    /* commit the raw level once it stopped bouncing */
+    if (engine->raw_pressed != engine->pressed &&
+        now_ms - engine->raw_change_ms >= engine->cfg.debounce_ms) {
+        engine->pressed = engine->raw_pressed;
+        if (engine->pressed) {
+            engine->press_ms = engine->raw_change_ms;
+        } else if (engine->long_fired) {
+            /* release after a long press does not start a click sequence */
+            engine->long_fired = false;
+            engine->clicks = 0;
+        } else {
+            engine->release_ms = engine->raw_change_ms;
+            if (engine->clicks < UINT8_MAX) {
+                engine->clicks++;
+            }
+        }
+    }
+
+    if (engine->pressed) {
+        if (!engine->long_fired && now_ms - engine->press_ms >= engine->cfg.long_press_ms) {
+            engine->long_fired = true;
+            engine->clicks = 0;
+            return BUTTON_GESTURE_LONG_PRESS;
+        }
+        return BUTTON_GESTURE_NONE;
+    }
+
+    if (engine->clicks > 0 && now_ms - engine->release_ms >= engine->cfg.click_timeout_ms) {
+        uint8_t clicks = engine->clicks;
+        engine->clicks = 0;
+        if (clicks > BUTTON_GESTURE_MAX_CLICKS) {
+            return BUTTON_GESTURE_NONE;
+        }
+        return (button_gesture_t)(BUTTON_GESTURE_CLICK + clicks - 1);
+    }
+    return BUTTON_GESTURE_NONE;
+}
+
+int64_t button_gesture_next_deadline(const button_gesture_engine_t *engine)
+{
+    if (engine->raw_pressed != engine->pressed) {
+        return engine->raw_change_ms + engine->cfg.debounce_ms;
+    }
+    if (engine->pressed && !engine->long_fired) {
+        return engine->press_ms + engine->cfg.long_press_ms;
+    }
+    if (!engine->pressed && engine->clicks > 0) {
+        return engine->release_ms + engine->cfg.click_timeout_ms;
+    }
+    return -1;
+}
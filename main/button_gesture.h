@@ -0,0 +1,85 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __BUTTON_GESTURE_H__
+#define __BUTTON_GESTURE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Gesture decoder for a single push button. It has no platform dependency:
+ * the caller feeds raw edges and the current time in milliseconds, so the
+ * timing can be exercised on the host.
+ */
+
+/* highest click count reported as its own gesture */
+#define BUTTON_GESTURE_MAX_CLICKS    4
+
+typedef enum {
+    BUTTON_GESTURE_NONE = 0,
+    BUTTON_GESTURE_CLICK,            /*!< one short press */
+    BUTTON_GESTURE_DOUBLE_CLICK,     /*!< two short presses */
+    BUTTON_GESTURE_TRIPLE_CLICK,     /*!< three short presses */
+    BUTTON_GESTURE_QUAD_CLICK,       /*!< four short presses */
+    BUTTON_GESTURE_LONG_PRESS,       /*!< held down for long_press_ms, fires while still held */
+    BUTTON_GESTURE_MAX,
+} button_gesture_t;
+
+typedef struct {
+    uint32_t debounce_ms;        /*!< level has to be stable this long to count */
+    uint32_t click_timeout_ms;   /*!< gap after a release that ends a click sequence */
+    uint32_t long_press_ms;      /*!< hold time of a long press */
+} button_gesture_config_t;
+
+typedef struct {
+    button_gesture_config_t cfg;
+    bool    raw_pressed;         /*!< last level seen on an edge, may still bounce */
+    int64_t raw_change_ms;       /*!< time of the last raw edge */
+    bool    pressed;             /*!< debounced level */
+    bool    long_fired;          /*!< long press already reported for this hold */
+    uint8_t clicks;              /*!< short presses in the running sequence */
+    int64_t press_ms;            /*!< time of the last debounced press */
+    int64_t release_ms;          /*!< time of the last debounced release */
+} button_gesture_engine_t;
+
+/**
+ * @brief  initialize the gesture engine with the button released
+ *
+ * @param [out] engine  engine to initialize
+ * @param [in]  cfg     timing configuration
+ */
+void button_gesture_init(button_gesture_engine_t *engine, const button_gesture_config_t *cfg);
+
+/**
+ * @brief  record a raw edge of the button
+ *
+ * @param [in] engine   gesture engine
+ * @param [in] pressed  level after the edge, true when the button is down
+ * @param [in] now_ms   time of the edge
+ */
+void button_gesture_edge(button_gesture_engine_t *engine, bool pressed, int64_t now_ms);
+
+/**
+ * @brief  advance the state machine to the given time
+ *
+ * @param [in] engine  gesture engine
+ * @param [in] now_ms  current time
+ *
+ * @return  gesture completed at this time, BUTTON_GESTURE_NONE if none
+ */
+button_gesture_t button_gesture_poll(button_gesture_engine_t *engine, int64_t now_ms);
+
+/**
+ * @brief  time at which button_gesture_poll has to run next
+ *
+ * @param [in] engine  gesture engine
+ *
+ * @return  deadline in milliseconds, -1 if the engine is idle until the next edge
+ */
+int64_t button_gesture_next_deadline(const button_gesture_engine_t *engine);
+
+#endif /* __BUTTON_GESTURE_H__ */
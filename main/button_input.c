@@ -0,0 +1,146 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "driver/gpio.h"
+#include "button_input.h"
+
+/* notification bits for the button task */
+#define BUTTON_NOTIFY_EDGE     (0x01)
+#define BUTTON_NOTIFY_TIMER    (0x02)
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* GPIO edge interrupt */
+static void button_isr_handler(void *arg);
+/* one-shot deadline timer callback */
+static void button_timer_cb(void *arg);
+/* handler for button task */
+static void button_task_handler(void *arg);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static int s_button_gpio = -1;
+static TaskHandle_t s_button_task_handle = NULL;   /* handle of button task */
+static esp_timer_handle_t s_button_timer = NULL;    /* debounce / click / hold deadline */
+static button_input_cb_t s_button_cb = NULL;
+static button_gesture_engine_t s_engine;
+static portMUX_TYPE s_edge_lock = portMUX_INITIALIZER_UNLOCKED;  /* both edge fields, 64 bits tear otherwise */
+static int64_t s_edge_us = 0;                       /* time of the last edge, written by ISR */
+static bool s_edge_pressed = false;                 /* level after the last edge, written by ISR */
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static void IRAM_ATTR button_isr_handler(void *arg)
+{
+    BaseType_t high_task_wakeup = pdFALSE;
+    int64_t now_us = esp_timer_get_time();
+    bool pressed = (gpio_get_level(s_button_gpio) == 0);
+
+    portENTER_CRITICAL_ISR(&s_edge_lock);
+    s_edge_us = now_us;
+    s_edge_pressed = pressed;
+    portEXIT_CRITICAL_ISR(&s_edge_lock);
+    xTaskNotifyFromISR(s_button_task_handle, BUTTON_NOTIFY_EDGE, eSetBits, &high_task_wakeup);
+    if (high_task_wakeup == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static void button_timer_cb(void *arg)
+{
+    xTaskNotify(s_button_task_handle, BUTTON_NOTIFY_TIMER, eSetBits);
+}
+
+static void button_task_handler(void *arg)
+{
+    uint32_t bits = 0;
+
+    for (;;) {
+        /* sleep until an edge or a deadline arrives */
+        xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+
+        if (bits & BUTTON_NOTIFY_EDGE) {
+            portENTER_CRITICAL(&s_edge_lock);
+            int64_t edge_us = s_edge_us;
+            bool edge_pressed = s_edge_pressed;
+            portEXIT_CRITICAL(&s_edge_lock);
+            button_gesture_edge(&s_engine, edge_pressed, edge_us / 1000);
+        }
+
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        button_gesture_t gesture = button_gesture_poll(&s_engine, now_ms);
+        if (gesture != BUTTON_GESTURE_NONE) {
+            ESP_LOGI(BUTTON_INPUT_TAG, "gesture: %d", gesture);
+            if (s_button_cb) {
+                s_button_cb(gesture);
+            }
+        }
+
+        esp_timer_stop(s_button_timer);
+        int64_t deadline = button_gesture_next_deadline(&s_engine);
+        if (deadline >= 0) {
+            int64_t wait_ms = deadline - now_ms;
+            esp_timer_start_once(s_button_timer, (wait_ms > 0 ? wait_ms : 1) * 1000);
+        }
+    }
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+bool button_input_start(int gpio_num, const button_gesture_config_t *cfg, button_input_cb_t cb)
+{
+    if (s_button_task_handle != NULL) {
+        return true;
+    }
+    s_button_gpio = gpio_num;
+    s_button_cb = cb;
+    button_gesture_init(&s_engine, cfg);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = button_timer_cb,
+        .name = "button",
+    };
+    if (esp_timer_create(&timer_args, &s_button_timer) != ESP_OK) {
+        ESP_LOGE(BUTTON_INPUT_TAG, "%s, timer create failed", __func__);
+        return false;
+    }
+    if (xTaskCreate(button_task_handler, "ButtonTask", 4096, NULL, 5, &s_button_task_handle) != pdPASS) {
+        ESP_LOGE(BUTTON_INPUT_TAG, "%s, task create failed", __func__);
+        return false;
+    }
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << gpio_num),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_ANYEDGE};
+    gpio_config(&io_conf);
+
+    /* the service may already be installed by another driver */
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(BUTTON_INPUT_TAG, "%s, isr service install failed: %s", __func__, esp_err_to_name(err));
+        return false;
+    }
+    gpio_isr_handler_add(gpio_num, button_isr_handler, NULL);
+    return true;
+}
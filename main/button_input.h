@@ -0,0 +1,38 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __BUTTON_INPUT_H__
+#define __BUTTON_INPUT_H__
+
+#include <stdbool.h>
+#include "button_gesture.h"
+
+/* log tag */
+#define BUTTON_INPUT_TAG    "BUTTON"
+
+/**
+ * @brief  handler for a decoded gesture, called from the button task
+ *
+ * @param [in] gesture  completed gesture
+ */
+typedef void (* button_input_cb_t) (button_gesture_t gesture);
+
+/**
+ * @brief  start interrupt driven gesture decoding on an active-low button
+ *
+ *         Edges are taken by a GPIO interrupt and the debounce, click and hold
+ *         deadlines by a one-shot esp_timer, so the button task sleeps until
+ *         one of them fires.
+ *
+ * @param [in] gpio_num  GPIO of the button, pulled up internally
+ * @param [in] cfg       gesture timing
+ * @param [in] cb        gesture handler
+ *
+ * @return  true if the button was set up successfully
+ */
+bool button_input_start(int gpio_num, const button_gesture_config_t *cfg, button_input_cb_t cb);
+
+#endif /* __BUTTON_INPUT_H__ */
@@ -0,0 +1,99 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "dsp_dac8.h"
+
+/* fed back error is kept within one 8-bit step, more can only come from clipping */
+#define DSP_DAC8_ERR_MAX    (128)
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* one 16-bit sample to an offset binary code, order is a constant after inlining */
+static inline uint8_t dsp_dac8_quantise(int32_t x, int32_t *e1, int32_t *e2, const int order);
+/* the whole block at one order, so the loop carries no branch on it */
+static inline void dsp_dac8_run(dsp_dac8_t *d, const int16_t *ch0, const int16_t *ch1, size_t stride,
+                                size_t frames, uint8_t *out, const int order);
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static inline uint8_t dsp_dac8_quantise(int32_t x, int32_t *e1, int32_t *e2, const int order)
+{
+    int32_t v = x;
+
+    if (order == 1) {
+        v -= *e1;
+    } else if (order == 2) {
+        v -= 2 * *e1 - *e2;
+    }
+    /* round to the nearest 8-bit step */
+    int32_t q = (v + 128) >> 8;
+    q = (q > 127) ? 127 : (q < -128) ? -128 : q;
+    if (order > 0) {
+        int32_t e = (q << 8) - v;
+        e = (e > DSP_DAC8_ERR_MAX) ? DSP_DAC8_ERR_MAX : (e < -DSP_DAC8_ERR_MAX) ? -DSP_DAC8_ERR_MAX : e;
+        if (order == 2) {
+            *e2 = *e1;
+        }
+        *e1 = e;
+    }
+    return (uint8_t)(q + DSP_DAC8_SILENCE);
+}
+
+static inline void dsp_dac8_run(dsp_dac8_t *d, const int16_t *ch0, const int16_t *ch1, size_t stride,
+                                size_t frames, uint8_t *out, const int order)
+{
+    /* error state in locals so it stays in registers across the block */
+    int32_t e1_0 = d->e1[0], e2_0 = d->e2[0];
+    int32_t e1_1 = d->e1[1], e2_1 = d->e2[1];
+
+    for (size_t i = 0; i < frames; i++) {
+        out[2 * i] = dsp_dac8_quantise(ch0[i * stride], &e1_0, &e2_0, order);
+        out[2 * i + 1] = dsp_dac8_quantise(ch1[i * stride], &e1_1, &e2_1, order);
+    }
+    d->e1[0] = e1_0;
+    d->e2[0] = e2_0;
+    d->e1[1] = e1_1;
+    d->e2[1] = e2_1;
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void dsp_dac8_init(dsp_dac8_t *d, uint8_t order)
+{
+    d->order = (order > DSP_DAC8_MAX_ORDER) ? DSP_DAC8_MAX_ORDER : order;
+    dsp_dac8_reset(d);
+}
+
+void dsp_dac8_reset(dsp_dac8_t *d)
+{
+    memset(d->e1, 0, sizeof(d->e1));
+    memset(d->e2, 0, sizeof(d->e2));
+}
+
+void dsp_dac8_convert(dsp_dac8_t *d, const int16_t *ch0, const int16_t *ch1, size_t stride,
+                      size_t frames, uint8_t *out)
+{
+    switch (d->order) {
+    case 0:
+        dsp_dac8_run(d, ch0, ch1, stride, frames, out, 0);
+        break;
+    case 1:
+        dsp_dac8_run(d, ch0, ch1, stride, frames, out, 1);
+        break;
+    default:
+        dsp_dac8_run(d, ch0, ch1, stride, frames, out, 2);
+        break;
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __DSP_DAC8_H__
+#define __DSP_DAC8_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* highest order of the error feedback */
+#define DSP_DAC8_MAX_ORDER    (2)
+
+/* mid scale of the 8-bit offset binary DAC code, the code of silence */
+#define DSP_DAC8_SILENCE      (128)
+
+/* two DAC channels fed from 16-bit PCM, each with its own error feedback */
+typedef struct {
+    uint8_t order;       /*!< 0 rounds, 1 and 2 push the error up in frequency by (1 - z^-1)^order */
+    int32_t e1[2];       /*!< quantisation error of the previous sample, per channel, 16-bit LSBs */
+    int32_t e2[2];       /*!< ... and of the one before */
+} dsp_dac8_t;
+
+/**
+ * @brief  set the shaping order and clear the error history
+ *
+ * @param [in] d      converter
+ * @param [in] order  0 ~ DSP_DAC8_MAX_ORDER, clamped
+ */
+void dsp_dac8_init(dsp_dac8_t *d, uint8_t order);
+
+/**
+ * @brief  clear the error history, e.g. after silence was written behind its back
+ */
+void dsp_dac8_reset(dsp_dac8_t *d);
+
+/**
+ * @brief  quantise two channels to 8 bits and interleave them as offset binary, one pass
+ *
+ *         Error feedback turns the quantisation error around and feeds it back
+ *         into the next samples, so the 8-bit noise floor leaves the midrange
+ *         for the top octave. Codes are clamped and so is the fed back error,
+ *         a clipped sample cannot wind the loop up.
+ *
+ * @param [in]  d       converter
+ * @param [in]  ch0     samples of DAC channel 0, every stride-th is taken
+ * @param [in]  ch1     samples of DAC channel 1, every stride-th is taken
+ * @param [in]  stride  interleaved channels of ch0 and ch1
+ * @param [in]  frames  samples per DAC channel
+ * @param [out] out     frames * 2 codes, channel 0 first
+ */
+void dsp_dac8_convert(dsp_dac8_t *d, const int16_t *ch0, const int16_t *ch1, size_t stride,
+                      size_t frames, uint8_t *out);
+
+#endif /* __DSP_DAC8_H__ */
@@ -0,0 +1,188 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "dsp_delay.h"
+
+#define DSP_DELAY_FRAC_ONE     (1 << DSP_DELAY_FRAC_BITS)
+#define DSP_DELAY_FRAC_MASK    (DSP_DELAY_FRAC_ONE - 1)
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* offsets and weights of the interpolator for a delay */
+static void dsp_delay_tap_make(dsp_delay_tap_t *tap, uint32_t frames_q8, uint8_t ch);
+/* delayed sample at the write position, saturated to 16 bits */
+static inline int32_t dsp_delay_read(const int16_t *buf, uint32_t mask, const dsp_delay_tap_t *tap, uint32_t pos);
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static void dsp_delay_tap_make(dsp_delay_tap_t *tap, uint32_t frames_q8, uint8_t ch)
+{
+    uint32_t whole = frames_q8 >> DSP_DELAY_FRAC_BITS;
+    float x = (float)(frames_q8 & DSP_DELAY_FRAC_MASK) / DSP_DELAY_FRAC_ONE;
+    float h[4];
+
+    tap->whole = (frames_q8 & DSP_DELAY_FRAC_MASK) == 0;
+    if (whole == 0) {
+        /* below one frame there is no newer sample to centre on, interpolate linearly */
+        tap->off[0] = 0;
+        tap->off[1] = 0;
+        tap->off[2] = ch;
+        tap->off[3] = 2 * ch;
+        h[0] = 0.0f;
+        h[1] = 1.0f - x;
+        h[2] = x;
+        h[3] = 0.0f;
+    } else {
+        /* Lagrange through the frames at whole - 1 ... whole + 2 */
+        for (int k = 0; k < 4; k++) {
+            tap->off[k] = (whole - 1 + k) * ch;
+        }
+        h[0] = -x * (x - 1.0f) * (x - 2.0f) / 6.0f;
+        h[1] = (x + 1.0f) * (x - 1.0f) * (x - 2.0f) / 2.0f;
+        h[2] = -(x + 1.0f) * x * (x - 2.0f) / 2.0f;
+        h[3] = (x + 1.0f) * x * (x - 1.0f) / 6.0f;
+    }
+
+    int32_t sum = 0;
+    for (int k = 0; k < 4; k++) {
+        tap->coef[k] = (int32_t)(h[k] * 32768.0f + ((h[k] < 0) ? -0.5f : 0.5f));
+        sum += tap->coef[k];
+    }
+    /* unity DC gain exactly, whatever the rounding did */
+    tap->coef[1] += 32768 - sum;
+}
+
+static inline int32_t dsp_delay_read(const int16_t *buf, uint32_t mask, const dsp_delay_tap_t *tap, uint32_t pos)
+{
+    /* |sum of weights| stays below 1.25, so the accumulator cannot overflow */
+    int32_t acc = 1 << 14;
+
+    for (int k = 0; k < 4; k++) {
+        acc += tap->coef[k] * buf[(pos - tap->off[k]) & mask];
+    }
+    acc >>= 15;
+    if (acc > INT16_MAX) {
+        return INT16_MAX;
+    }
+    return (acc < INT16_MIN) ? INT16_MIN : acc;
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+bool dsp_delay_init(dsp_delay_t *d, uint32_t max_frames, uint8_t max_ch)
+{
+    uint32_t need = (max_frames + DSP_DELAY_TAP_SPAN) * max_ch + 1;
+    uint32_t len = 1;
+
+    memset(d, 0, sizeof(*d));
+    while (len < need) {
+        len <<= 1;
+    }
+    /* read on every sample, keep it out of PSRAM */
+    d->buf = heap_caps_calloc(len, sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (d->buf == NULL) {
+        return false;
+    }
+    d->mask = len - 1;
+    dsp_delay_reset(d, max_ch);
+    return true;
+}
+
+size_t dsp_delay_mem_size(const dsp_delay_t *d)
+{
+    return d->buf ? (d->mask + 1) * sizeof(int16_t) : 0;
+}
+
+void dsp_delay_reset(dsp_delay_t *d, uint8_t ch)
+{
+    d->ch = (ch > 0) ? ch : 1;
+    d->pos = 0;
+    d->delay = 0;
+    d->pending = 0;
+    dsp_delay_tap_make(&d->tap, 0, d->ch);
+    if (d->buf == NULL) {
+        d->max_delay = 0;
+        return;
+    }
+    d->max_delay = (d->mask / d->ch - DSP_DELAY_TAP_SPAN) << DSP_DELAY_FRAC_BITS;
+    memset(d->buf, 0, (d->mask + 1) * sizeof(int16_t));
+}
+
+void dsp_delay_set(dsp_delay_t *d, uint32_t frames_q8)
+{
+    if (frames_q8 > d->max_delay) {
+        frames_q8 = d->max_delay;
+    }
+    __atomic_store_n(&d->pending, frames_q8, __ATOMIC_RELAXED);
+}
+
+void dsp_delay_process(dsp_delay_t *d, int16_t *buf, size_t n)
+{
+    int16_t *line = d->buf;
+    uint32_t mask = d->mask;
+    uint32_t pending = __atomic_load_n(&d->pending, __ATOMIC_RELAXED);
+    uint32_t pos = d->pos;
+
+    if (line == NULL) {
+        return;
+    }
+    if (pending != d->delay && n > 0) {
+        /* moving the tap in one step would jump in the waveform */
+        dsp_delay_tap_t next;
+        int32_t step = (1 << 15) / (int32_t)n;
+        int32_t t = 0;
+
+        dsp_delay_tap_make(&next, pending, d->ch);
+        for (size_t i = 0; i < n; i++) {
+            line[pos] = buf[i];
+            int32_t y_old = dsp_delay_read(line, mask, &d->tap, pos);
+            int32_t y_new = dsp_delay_read(line, mask, &next, pos);
+            buf[i] = (int16_t)(y_old + (((y_new - y_old) * t) >> 15));
+            pos = (pos + 1) & mask;
+            t += step;
+        }
+        d->delay = pending;
+        d->tap = next;
+        d->pos = pos;
+        return;
+    }
+    if (d->delay == 0) {
+        /* keep the history so a later delay change has real audio to fade to */
+        for (size_t i = 0; i < n; i++) {
+            line[pos] = buf[i];
+            pos = (pos + 1) & mask;
+        }
+        d->pos = pos;
+        return;
+    }
+    if (d->tap.whole) {
+        uint32_t off = d->tap.off[1];
+        for (size_t i = 0; i < n; i++) {
+            line[pos] = buf[i];
+            buf[i] = line[(pos - off) & mask];
+            pos = (pos + 1) & mask;
+        }
+        d->pos = pos;
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        line[pos] = buf[i];
+        buf[i] = (int16_t)dsp_delay_read(line, mask, &d->tap, pos);
+        pos = (pos + 1) & mask;
+    }
+    d->pos = pos;
+}
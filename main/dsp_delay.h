@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __DSP_DELAY_H__
+#define __DSP_DELAY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* fractional bits of a delay in frames */
+#define DSP_DELAY_FRAC_BITS    (8)
+
+/* frames read around the tap by the interpolator beyond the integer delay */
+#define DSP_DELAY_TAP_SPAN     (3)
+
+/* where and how a delayed sample is read: 4-point Lagrange interpolation */
+typedef struct {
+    uint32_t off[4];     /*!< offsets back from the write position, interleaved samples */
+    int32_t  coef[4];    /*!< Q15 weights */
+    bool     whole;      /*!< integer delay, off[1] alone is exact */
+} dsp_delay_tap_t;
+
+/* per driver delay line for time alignment */
+typedef struct {
+    int16_t         *buf;        /*!< power of two long, internal RAM */
+    uint32_t        mask;
+    uint32_t        pos;         /*!< write position */
+    uint8_t         ch;          /*!< interleaved channels */
+    uint32_t        max_delay;   /*!< longest delay the line holds at ch, frames in Q8 */
+    uint32_t        delay;       /*!< delay in use, frames in Q8 */
+    uint32_t        pending;     /*!< requested delay, picked up at the next block */
+    dsp_delay_tap_t tap;         /*!< interpolator for delay */
+} dsp_delay_t;
+
+/**
+ * @brief  allocate a delay line in internal RAM, call once outside the audio path
+ *
+ *         The buffer is rounded up to a power of two so wrapping is a mask.
+ *
+ * @param [in] d           delay line
+ * @param [in] max_frames  longest delay needed, in frames
+ * @param [in] max_ch      most interleaved channels a stream will have
+ *
+ * @return  false if the buffer could not be allocated, the line then passes audio through
+ */
+bool dsp_delay_init(dsp_delay_t *d, uint32_t max_frames, uint8_t max_ch);
+
+/**
+ * @brief  bytes of RAM held by a delay line
+ */
+size_t dsp_delay_mem_size(const dsp_delay_t *d);
+
+/**
+ * @brief  clear the history and the delay for a stream with ch interleaved channels
+ */
+void dsp_delay_reset(dsp_delay_t *d, uint8_t ch);
+
+/**
+ * @brief  request a new delay, clamped to the line length; safe to call from any task
+ *
+ * @param [in] d          delay line
+ * @param [in] frames_q8  delay in frames with DSP_DELAY_FRAC_BITS fractional bits
+ */
+void dsp_delay_set(dsp_delay_t *d, uint32_t frames_q8);
+
+/**
+ * @brief  delay a block in place
+ *
+ *         Fractional delays are interpolated from the four nearest frames. A changed
+ *         delay is crossfaded from the old to the new tap over the block.
+ *
+ * @param [in]    d    delay line
+ * @param [inout] buf  interleaved samples
+ * @param [in]    n    number of samples
+ */
+void dsp_delay_process(dsp_delay_t *d, int16_t *buf, size_t n);
+
+#endif /* __DSP_DELAY_H__ */
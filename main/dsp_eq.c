@@ -0,0 +1,296 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "dsp_eq.h"
+
+#define DSP_EQ_PI           (3.14159265f)
+#define DSP_EQ_OUT_MAX      (65535.0f)
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* RBJ cookbook coefficients of one band, false if the band is a no-op at this rate */
+static bool dsp_eq_design(const dsp_eq_band_t *band, float rate, dsp_biquad_t *bq);
+/* run one sample through a cascade */
+static inline float dsp_eq_run(const dsp_eq_coefs_t *coefs, float (*z)[2], float x);
+/* limit a filter output to 17 bits */
+static inline int32_t dsp_eq_out(float x);
+/* take over the set published by dsp_eq_select, runs in the audio path */
+static void dsp_eq_take(dsp_eq_t *eq, const dsp_eq_coefs_t *coefs, uint8_t ch);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const uint32_t s_rates[DSP_EQ_NUM_RATES] = {16000, 32000, 44100, 48000};
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static bool dsp_eq_design(const dsp_eq_band_t *band, float rate, dsp_biquad_t *bq)
+{
+    float q = (band->q > 0.05f) ? band->q : 0.707f;
+    float b0, b1, b2, a0, a1, a2;
+
+    /* a band at or above Nyquist cannot be realised, leave it out */
+    if (band->type == DSP_EQ_OFF || band->freq_hz <= 0.0f || band->freq_hz >= rate * 0.49f) {
+        return false;
+    }
+    if ((band->type == DSP_EQ_PEAK || band->type == DSP_EQ_LOW_SHELF || band->type == DSP_EQ_HIGH_SHELF) &&
+        fabsf(band->gain_db) < 0.05f) {
+        return false;
+    }
+
+    float w0 = 2.0f * DSP_EQ_PI * band->freq_hz / rate;
+    float cw = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+    float A = powf(10.0f, band->gain_db / 40.0f);
+
+    switch (band->type) {
+    case DSP_EQ_PEAK:
+        b0 = 1.0f + alpha * A;
+        b1 = -2.0f * cw;
+        b2 = 1.0f - alpha * A;
+        a0 = 1.0f + alpha / A;
+        a1 = -2.0f * cw;
+        a2 = 1.0f - alpha / A;
+        break;
+    case DSP_EQ_LOW_SHELF: {
+        float sa = 2.0f * sqrtf(A) * alpha;
+        b0 = A * ((A + 1.0f) - (A - 1.0f) * cw + sa);
+        b1 = 2.0f * A * ((A - 1.0f) - (A + 1.0f) * cw);
+        b2 = A * ((A + 1.0f) - (A - 1.0f) * cw - sa);
+        a0 = (A + 1.0f) + (A - 1.0f) * cw + sa;
+        a1 = -2.0f * ((A - 1.0f) + (A + 1.0f) * cw);
+        a2 = (A + 1.0f) + (A - 1.0f) * cw - sa;
+        break;
+    }
+    case DSP_EQ_HIGH_SHELF: {
+        float sa = 2.0f * sqrtf(A) * alpha;
+        b0 = A * ((A + 1.0f) + (A - 1.0f) * cw + sa);
+        b1 = -2.0f * A * ((A - 1.0f) + (A + 1.0f) * cw);
+        b2 = A * ((A + 1.0f) + (A - 1.0f) * cw - sa);
+        a0 = (A + 1.0f) - (A - 1.0f) * cw + sa;
+        a1 = 2.0f * ((A - 1.0f) - (A + 1.0f) * cw);
+        a2 = (A + 1.0f) - (A - 1.0f) * cw - sa;
+        break;
+    }
+    case DSP_EQ_HIGH_PASS:
+        b0 = (1.0f + cw) / 2.0f;
+        b1 = -(1.0f + cw);
+        b2 = (1.0f + cw) / 2.0f;
+        a0 = 1.0f + alpha;
+        a1 = -2.0f * cw;
+        a2 = 1.0f - alpha;
+        break;
+    case DSP_EQ_LOW_PASS:
+        b0 = (1.0f - cw) / 2.0f;
+        b1 = 1.0f - cw;
+        b2 = (1.0f - cw) / 2.0f;
+        a0 = 1.0f + alpha;
+        a1 = -2.0f * cw;
+        a2 = 1.0f - alpha;
+        break;
+    default:
+        return false;
+    }
+
+    bq->b0 = b0 / a0;
+    bq->b1 = b1 / a0;
+    bq->b2 = b2 / a0;
+    bq->a1 = a1 / a0;
+    bq->a2 = a2 / a0;
+    return true;
+}
+
+static inline float dsp_eq_run(const dsp_eq_coefs_t *coefs, float (*z)[2], float x)
+{
+    int nsec = (coefs != NULL) ? coefs->n : 0;
+
+    /* all sections in one pass, the sample stays in a register */
+    for (int s = 0; s < nsec; s++) {
+        const dsp_biquad_t *bq = &coefs->sec[s];
+        float y = bq->b0 * x + z[s][0];
+        z[s][0] = bq->b1 * x - bq->a1 * y + z[s][1];
+        z[s][1] = bq->b2 * x - bq->a2 * y;
+        x = y;
+    }
+    return x;
+}
+
+static inline int32_t dsp_eq_out(float x)
+{
+    if (x > DSP_EQ_OUT_MAX) {
+        x = DSP_EQ_OUT_MAX;
+    } else if (x < -DSP_EQ_OUT_MAX) {
+        x = -DSP_EQ_OUT_MAX;
+    }
+    return (int32_t)x;
+}
+
+static void dsp_eq_take(dsp_eq_t *eq, const dsp_eq_coefs_t *coefs, uint8_t ch)
+{
+    dsp_eq_coefs_t next;
+    int keep = 0;
+
+    if (coefs != NULL) {
+        next = *coefs;
+    } else {
+        memset(&next, 0, sizeof(next));
+    }
+    if (ch != eq->ch || next.rate != eq->coefs.rate || next.rate == 0) {
+        /* new format: state of the old filters would only click */
+        memset(eq->z, 0, sizeof(eq->z));
+        eq->fade_left = 0;
+        eq->coefs = next;
+        eq->ch = ch;
+        return;
+    }
+    /* sections up to the first change see the same input as before and keep their state,
+     * the rest would be driven by the state of another filter and start from rest */
+    while (keep < next.n && keep < eq->coefs.n &&
+           memcmp(&next.sec[keep], &eq->coefs.sec[keep], sizeof(dsp_biquad_t)) == 0) {
+        keep++;
+    }
+    if (keep == next.n && keep == eq->coefs.n) {
+        return;
+    }
+    /* the old cascade keeps running on a copy while it is faded out */
+    eq->fade = eq->coefs;
+    memcpy(eq->zf, eq->z, sizeof(eq->zf));
+    for (int c = 0; c < DSP_EQ_MAX_CH; c++) {
+        memset(eq->z[c][keep], 0, (DSP_EQ_MAX_BANDS - keep) * sizeof(eq->z[c][0]));
+    }
+    eq->fade_left = DSP_EQ_FADE_FRAMES;
+    eq->coefs = next;
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void dsp_eq_cache_build(dsp_eq_cache_t *cache, const dsp_eq_band_t *bands, size_t n)
+{
+    dsp_eq_cache_build_decimated(cache, bands, n, 1);
+}
+
+void dsp_eq_cache_build_decimated(dsp_eq_cache_t *cache, const dsp_eq_band_t *bands, size_t n, uint32_t factor)
+{
+    if (factor < 1) {
+        factor = 1;
+    }
+    if (n > DSP_EQ_MAX_BANDS) {
+        n = DSP_EQ_MAX_BANDS;
+    }
+    memset(cache, 0, sizeof(*cache));
+    cache->n = (uint8_t)n;
+    if (n > 0) {
+        memcpy(cache->bands, bands, n * sizeof(dsp_eq_band_t));
+    }
+    for (int r = 0; r < DSP_EQ_NUM_RATES; r++) {
+        dsp_eq_coefs_t *coefs = &cache->rates[r];
+
+        coefs->rate = s_rates[r];
+        for (size_t i = 0; i < n; i++) {
+            if (dsp_eq_design(&bands[i], (float)coefs->rate / factor, &coefs->sec[coefs->n])) {
+                coefs->n++;
+            }
+        }
+    }
+}
+
+int dsp_eq_rate_index(uint32_t rate)
+{
+    for (int r = 0; r < DSP_EQ_NUM_RATES; r++) {
+        if (s_rates[r] == rate) {
+            return r;
+        }
+    }
+    return -1;
+}
+
+uint32_t dsp_eq_rate(int idx)
+{
+    return (idx >= 0 && idx < DSP_EQ_NUM_RATES) ? s_rates[idx] : 0;
+}
+
+const dsp_eq_coefs_t *dsp_eq_cache_lookup(const dsp_eq_cache_t *cache, uint32_t rate)
+{
+    int r = dsp_eq_rate_index(rate);
+
+    return (r < 0) ? NULL : &cache->rates[r];
+}
+
+void dsp_eq_init(dsp_eq_t *eq)
+{
+    memset(eq, 0, sizeof(*eq));
+    eq->pending_ch = DSP_EQ_MAX_CH;
+    eq->ch = DSP_EQ_MAX_CH;
+}
+
+void dsp_eq_select(dsp_eq_t *eq, const dsp_eq_cache_t *cache, uint32_t rate, uint8_t ch)
+{
+    __atomic_store_n(&eq->pending_ch, (ch == 1) ? 1 : DSP_EQ_MAX_CH, __ATOMIC_RELAXED);
+    __atomic_store_n(&eq->pending, dsp_eq_cache_lookup(cache, rate), __ATOMIC_RELAXED);
+    __atomic_add_fetch(&eq->pending_seq, 1, __ATOMIC_RELEASE);
+}
+
+void dsp_eq_process(dsp_eq_t *eq, int32_t *buf, size_t n)
+{
+    uint32_t seq = __atomic_load_n(&eq->pending_seq, __ATOMIC_ACQUIRE);
+
+    if (seq != eq->seq) {
+        const dsp_eq_coefs_t *coefs = __atomic_load_n(&eq->pending, __ATOMIC_RELAXED);
+        uint8_t ch = __atomic_load_n(&eq->pending_ch, __ATOMIC_RELAXED);
+        uint32_t rate = (coefs != NULL) ? coefs->rate : 0;
+
+        /* a settings change waits for a running crossfade, a new format never does */
+        if (eq->fade_left == 0 || ch != eq->ch || rate != eq->coefs.rate) {
+            dsp_eq_take(eq, coefs, ch);
+            eq->seq = seq;
+        }
+    }
+    int nch = eq->ch;
+    size_t i = 0;
+
+    if (eq->fade_left > 0) {
+        const float step = 1.0f / DSP_EQ_FADE_FRAMES;
+
+        for (; i + nch <= n && eq->fade_left > 0; i += nch) {
+            float t = (float)(DSP_EQ_FADE_FRAMES - eq->fade_left) * step;
+            for (int c = 0; c < nch; c++) {
+                float x = (float)buf[i + c];
+                float y_old = dsp_eq_run(&eq->fade, eq->zf[c], x);
+                float y_new = dsp_eq_run(&eq->coefs, eq->z[c], x);
+                buf[i + c] = dsp_eq_out(y_old + (y_new - y_old) * t);
+            }
+            eq->fade_left--;
+        }
+    }
+    if (eq->coefs.n == 0) {
+        return;
+    }
+
+    /* the steady state loop, without per sample channel checks */
+    const dsp_eq_coefs_t *coefs = &eq->coefs;
+    if (nch == 1) {
+        for (; i < n; i++) {
+            buf[i] = dsp_eq_out(dsp_eq_run(coefs, eq->z[0], (float)buf[i]));
+        }
+        return;
+    }
+    for (; i + 1 < n; i += 2) {
+        buf[i] = dsp_eq_out(dsp_eq_run(coefs, eq->z[0], (float)buf[i]));
+        buf[i + 1] = dsp_eq_out(dsp_eq_run(coefs, eq->z[1], (float)buf[i + 1]));
+    }
+}
@@ -0,0 +1,153 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __DSP_EQ_H__
+#define __DSP_EQ_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* log tag */
+#define DSP_EQ_TAG           "DSP_EQ"
+
+/* sections per EQ */
+#define DSP_EQ_MAX_BANDS     (8)
+
+/* A2DP SBC sample rates a coefficient set is cached for */
+#define DSP_EQ_NUM_RATES     (4)
+
+/* channels of an interleaved stream */
+#define DSP_EQ_MAX_CH        (2)
+
+/* frames a new set is crossfaded in over, ~21 ms at 48 kHz, long enough for
+ * low shelves and peaks to settle */
+#define DSP_EQ_FADE_FRAMES   (1024)
+
+/* filter shape of one EQ band */
+typedef enum {
+    DSP_EQ_OFF = 0,
+    DSP_EQ_PEAK,          /*!< peaking bell, gain_db at freq_hz, width q */
+    DSP_EQ_LOW_SHELF,     /*!< shelf below freq_hz, slope q */
+    DSP_EQ_HIGH_SHELF,    /*!< shelf above freq_hz, slope q */
+    DSP_EQ_HIGH_PASS,     /*!< 12 dB/oct high pass, resonance q */
+    DSP_EQ_LOW_PASS,      /*!< 12 dB/oct low pass, resonance q */
+} dsp_eq_type_t;
+
+/* one band of an EQ configuration */
+typedef struct {
+    uint8_t type;       /*!< dsp_eq_type_t */
+    float   freq_hz;
+    float   gain_db;    /*!< peak and shelf only */
+    float   q;
+} dsp_eq_band_t;
+
+/* normalised biquad, a0 == 1 */
+typedef struct {
+    float b0, b1, b2, a1, a2;
+} dsp_biquad_t;
+
+/* cascade for one sample rate */
+typedef struct {
+    uint32_t     rate;
+    uint8_t      n;                          /*!< active sections, OFF bands are dropped */
+    dsp_biquad_t sec[DSP_EQ_MAX_BANDS];
+} dsp_eq_coefs_t;
+
+/* an EQ configuration with its coefficients computed for every supported rate */
+typedef struct {
+    uint8_t        n;
+    dsp_eq_band_t  bands[DSP_EQ_MAX_BANDS];
+    dsp_eq_coefs_t rates[DSP_EQ_NUM_RATES];
+} dsp_eq_cache_t;
+
+/* run time state of one EQ instance */
+typedef struct {
+    const dsp_eq_coefs_t *pending;                         /*!< set published by dsp_eq_select */
+    uint8_t              pending_ch;
+    uint32_t             pending_seq;                      /*!< bumped by dsp_eq_select */
+    uint32_t             seq;                              /*!< selection the audio path runs with */
+    dsp_eq_coefs_t       coefs;                            /*!< copy of the set in use, no sections bypasses */
+    uint8_t              ch;                               /*!< interleaved channels, 1 or 2 */
+    dsp_eq_coefs_t       fade;                             /*!< copy of the set being faded out */
+    uint32_t             fade_left;                        /*!< frames of the crossfade still to run */
+    float                z[DSP_EQ_MAX_CH][DSP_EQ_MAX_BANDS][2];   /*!< transposed direct form II state */
+    float                zf[DSP_EQ_MAX_CH][DSP_EQ_MAX_BANDS][2];  /*!< state of the set being faded out */
+} dsp_eq_t;
+
+/**
+ * @brief  compute the coefficients of a configuration for all supported rates
+ *
+ *         Runs outside the audio path, e.g. at boot or when the configuration changes.
+ *
+ * @param [out] cache  cache to fill
+ * @param [in]  bands  band configuration, may be NULL when n is 0
+ * @param [in]  n      number of bands, at most DSP_EQ_MAX_BANDS
+ */
+void dsp_eq_cache_build(dsp_eq_cache_t *cache, const dsp_eq_band_t *bands, size_t n);
+
+/**
+ * @brief  like dsp_eq_cache_build, for a chain that runs at the stream rate divided by factor
+ *
+ *         Entries keep the stream rate, so dsp_eq_select finds them as usual. Bands at or
+ *         above the low rate's Nyquist frequency are left out.
+ *
+ * @param [out] cache   cache to fill
+ * @param [in]  bands   band configuration, may be NULL when n is 0
+ * @param [in]  n       number of bands, at most DSP_EQ_MAX_BANDS
+ * @param [in]  factor  decimation factor, 1 is the same as dsp_eq_cache_build
+ */
+void dsp_eq_cache_build_decimated(dsp_eq_cache_t *cache, const dsp_eq_band_t *bands, size_t n, uint32_t factor);
+
+/**
+ * @brief  index of a sample rate in the cache, -1 if it is not cached
+ */
+int dsp_eq_rate_index(uint32_t rate);
+
+/**
+ * @brief  sample rate at a cache index 0 ~ DSP_EQ_NUM_RATES - 1
+ */
+uint32_t dsp_eq_rate(int idx);
+
+/**
+ * @brief  coefficient set of a cache for a sample rate, NULL if the rate is not cached
+ */
+const dsp_eq_coefs_t *dsp_eq_cache_lookup(const dsp_eq_cache_t *cache, uint32_t rate);
+
+/**
+ * @brief  initialize an EQ instance as pass through
+ */
+void dsp_eq_init(dsp_eq_t *eq);
+
+/**
+ * @brief  switch to the cached set of a stream format
+ *
+ *         No coefficients are computed here. The audio path copies the set at its
+ *         next block, or once a crossfade still running has ended, so the cache has
+ *         to stay valid until then. A new rate or channel count clears the filter
+ *         state; a new set at the same rate is crossfaded from the old one over
+ *         DSP_EQ_FADE_FRAMES frames, across as many blocks as that takes. Sections
+ *         that changed start from rest. An unknown rate bypasses the EQ.
+ *
+ * @param [in] eq     EQ instance
+ * @param [in] cache  coefficient cache
+ * @param [in] rate   sample rate in Hz
+ * @param [in] ch     interleaved channels, 1 or 2
+ */
+void dsp_eq_select(dsp_eq_t *eq, const dsp_eq_cache_t *cache, uint32_t rate, uint8_t ch);
+
+/**
+ * @brief  run all sections over a block in place, one pass per sample
+ *
+ *         Output is limited to 17 bits so it can feed the limiter.
+ *
+ * @param [in]    eq   EQ instance
+ * @param [inout] buf  interleaved samples
+ * @param [in]    n    number of samples
+ */
+void dsp_eq_process(dsp_eq_t *eq, int32_t *buf, size_t n);
+
+#endif /* __DSP_EQ_H__ */
@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "dsp_gain.h"
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+/* Q15 gain per AVRCP volume: 0 is mute, then -63 dB rising 0.5 dB per step to unity at 127 */
+static const int16_t s_vol_gain[DSP_GAIN_VOL_STEPS] = {
+        0,    23,    25,    26,    28,    29,    31,    33,
+       35,    37,    39,    41,    44,    46,    49,    52,
+       55,    58,    62,    65,    69,    73,    78,    82,
+       87,    92,    98,   104,   110,   116,   123,   130,
+      138,   146,   155,   164,   174,   184,   195,   207,
+      219,   232,   246,   260,   276,   292,   309,   328,
+      347,   368,   389,   413,   437,   463,   490,   519,
+      550,   583,   617,   654,   693,   734,   777,   823,
+      872,   924,   978,  1036,  1098,  1163,  1232,  1305,
+     1382,  1464,  1550,  1642,  1740,  1843,  1952,  2068,
+     2190,  2320,  2457,  2603,  2757,  2920,  3093,  3277,
+     3471,  3677,  3894,  4125,  4370,  4629,  4903,  5193,
+     5501,  5827,  6172,  6538,  6925,  7336,  7771,  8231,
+     8719,  9235,  9783, 10362, 10976, 11627, 12315, 13045,
+    13818, 14637, 15504, 16423, 17396, 18427, 19519, 20675,
+    21900, 23198, 24573, 26029, 27571, 29205, 30935, 32767,
+};
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+int32_t dsp_gain_from_volume(uint8_t volume, float band_gain)
+{
+    if (volume >= DSP_GAIN_VOL_STEPS) {
+        volume = DSP_GAIN_VOL_STEPS - 1;
+    }
+    if (band_gain <= 0.0f) {
+        return 0;
+    }
+    if (band_gain >= 1.0f) {
+        return s_vol_gain[volume];
+    }
+    return (int32_t)(s_vol_gain[volume] * band_gain + 0.5f);
+}
+
+void dsp_gain_init(dsp_gain_t *g, int32_t gain)
+{
+    dsp_gain_end(g, gain);
+}
+
+void dsp_gain_begin(dsp_gain_t *g, int32_t target, size_t samples)
+{
+    g->acc = g->gain * 32768;
+    if (target == g->gain || samples == 0) {
+        g->step = 0;
+        return;
+    }
+    g->step = (target - g->gain) * 32768 / (int32_t)samples;
+}
@@ -0,0 +1,80 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __DSP_GAIN_H__
+#define __DSP_GAIN_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Q15 gain treated as unity, the largest value that keeps a 17-bit sample times gain in 32 bits */
+#define DSP_GAIN_UNITY       (32767)
+
+/* volume steps of the AVRCP absolute volume, 0 ~ 127 */
+#define DSP_GAIN_VOL_STEPS   (128)
+
+/* gain that ramps to a new target over one block */
+typedef struct {
+    int32_t gain;    /*!< Q15 gain reached at the end of the last block */
+    int32_t acc;     /*!< Q30 running gain within the current block */
+    int32_t step;    /*!< Q30 increment per sample within the current block */
+} dsp_gain_t;
+
+/**
+ * @brief  Q15 gain of an AVRCP volume with a band gain folded in
+ *
+ *         Volume goes through a 0.5 dB per step table, 127 is unity and 0 is mute.
+ *
+ * @param [in] volume     AVRCP absolute volume 0 ~ 127
+ * @param [in] band_gain  linear gain of the band 0 ~ 1
+ *
+ * @return  Q15 gain 0 ~ DSP_GAIN_UNITY
+ */
+int32_t dsp_gain_from_volume(uint8_t volume, float band_gain);
+
+/**
+ * @brief  set a gain without ramping, e.g. at the start of a stream
+ */
+void dsp_gain_init(dsp_gain_t *g, int32_t gain);
+
+/**
+ * @brief  start a block: the gain moves linearly from the current to the target
+ *         value, ending within one LSB of it on the last sample
+ *
+ * @param [in] g        gain
+ * @param [in] target   Q15 gain at the end of the block
+ * @param [in] samples  samples in the block
+ */
+void dsp_gain_begin(dsp_gain_t *g, int32_t target, size_t samples);
+
+/**
+ * @brief  gain for the next sample of the block
+ */
+static inline int32_t dsp_gain_next(dsp_gain_t *g)
+{
+    g->acc += g->step;
+    return g->acc >> 15;
+}
+
+/**
+ * @brief  apply a Q15 gain to a sample of up to 17 bits, result keeps up to 17 bits
+ */
+static inline int32_t dsp_gain_scale(int32_t x, int32_t gain)
+{
+    return (x * gain) >> 15;
+}
+
+/**
+ * @brief  finish a block, snapping to the exact target
+ */
+static inline void dsp_gain_end(dsp_gain_t *g, int32_t target)
+{
+    g->gain = target;
+    g->acc = target * 32768;
+    g->step = 0;
+}
+
+#endif /* __DSP_GAIN_H__ */
@@ -0,0 +1,169 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "dsp_limiter.h"
+
+#define DSP_LIMITER_UNITY       (1 << 30)
+#define DSP_METER_UNITY         (32768)
+#define DSP_METER_DECAY_SHIFT   (3)
+
+/* soft clip table covers the knee to knee + 2^15 in steps of 2^8 */
+#define DSP_SOFT_CLIP_SHIFT     (8)
+#define DSP_SOFT_CLIP_SPAN      (1 << 15)
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+/* knee + (32767 - knee) * tanh((x - knee) / (32767 - knee)) at x = knee + i * 256 */
+static const int16_t s_soft_clip[(DSP_SOFT_CLIP_SPAN >> DSP_SOFT_CLIP_SHIFT) + 1] = {
+    24576, 24832, 25087, 25342, 25595, 25846, 26094, 26340,
+    26582, 26821, 27056, 27286, 27512, 27732, 27948, 28157,
+    28362, 28560, 28752, 28939, 29119, 29293, 29461, 29623,
+    29779, 29929, 30072, 30210, 30342, 30468, 30589, 30705,
+    30815, 30920, 31020, 31115, 31205, 31291, 31373, 31451,
+    31525, 31595, 31661, 31724, 31783, 31839, 31892, 31943,
+    31990, 32035, 32078, 32118, 32156, 32191, 32225, 32257,
+    32287, 32315, 32342, 32367, 32391, 32413, 32434, 32454,
+    32472, 32490, 32507, 32522, 32537, 32550, 32563, 32576,
+    32587, 32598, 32608, 32618, 32627, 32635, 32643, 32650,
+    32657, 32664, 32670, 32676, 32682, 32687, 32692, 32696,
+    32700, 32704, 32708, 32712, 32715, 32718, 32721, 32724,
+    32727, 32729, 32731, 32733, 32735, 32737, 32739, 32741,
+    32742, 32744, 32745, 32747, 32748, 32749, 32750, 32751,
+    32752, 32753, 32754, 32755, 32755, 32756, 32757, 32757,
+    32758, 32759, 32759, 32759, 32760, 32760, 32761, 32761,
+    32762,
+};
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void dsp_limiter_init(dsp_limiter_t *lim, int32_t threshold)
+{
+    dsp_limiter_set_threshold(lim, threshold);
+    dsp_limiter_set_rate_shift(lim, 0);
+}
+
+void dsp_limiter_set_threshold(dsp_limiter_t *lim, int32_t threshold)
+{
+    if (threshold < 1) {
+        threshold = 1;
+    } else if (threshold > 32767) {
+        threshold = 32767;
+    }
+    lim->threshold = threshold;
+}
+
+void dsp_limiter_set_rate_shift(dsp_limiter_t *lim, uint8_t shift)
+{
+    uint32_t lookahead = DSP_LIMITER_LOOKAHEAD >> shift;
+
+    /* the attack has to settle inside the shorter lookahead as well */
+    lim->mask = ((lookahead >= 4) ? lookahead : 4) - 1;
+    lim->attack_shift = (shift < DSP_LIMITER_ATTACK_SHIFT) ? DSP_LIMITER_ATTACK_SHIFT - shift : 1;
+    lim->release_shift = (shift < DSP_LIMITER_RELEASE_SHIFT) ? DSP_LIMITER_RELEASE_SHIFT - shift : 1;
+    dsp_limiter_reset(lim);
+}
+
+void dsp_limiter_reset(dsp_limiter_t *lim)
+{
+    lim->gain = DSP_LIMITER_UNITY;
+    lim->pos = 0;
+    memset(lim->delay, 0, sizeof(lim->delay));
+    __atomic_store_n(&lim->meter, DSP_METER_UNITY, __ATOMIC_RELAXED);
+}
+
+int32_t dsp_limiter_threshold_from_db(float db)
+{
+    if (db > 0.0f) {
+        db = 0.0f;
+    }
+    return (int32_t)(32767.0f * powf(10.0f, db / 20.0f) + 0.5f);
+}
+
+int16_t dsp_soft_clip(int32_t x)
+{
+    int32_t a = (x < 0) ? -x : x;
+    int32_t y;
+
+    if (a <= DSP_SOFT_CLIP_KNEE) {
+        return (int16_t)x;
+    }
+    a -= DSP_SOFT_CLIP_KNEE;
+    if (a >= DSP_SOFT_CLIP_SPAN) {
+        y = s_soft_clip[DSP_SOFT_CLIP_SPAN >> DSP_SOFT_CLIP_SHIFT];
+    } else {
+        int32_t idx = a >> DSP_SOFT_CLIP_SHIFT;
+        int32_t frac = a & ((1 << DSP_SOFT_CLIP_SHIFT) - 1);
+        y = s_soft_clip[idx] + (((s_soft_clip[idx + 1] - s_soft_clip[idx]) * frac) >> DSP_SOFT_CLIP_SHIFT);
+    }
+    return (int16_t)((x < 0) ? -y : y);
+}
+
+void dsp_limiter_process(dsp_limiter_t *lim, const int32_t *in, int16_t *out, size_t n)
+{
+    int32_t threshold = lim->threshold;
+    int32_t gain = lim->gain;
+    int32_t min_gain = gain;
+    uint32_t mask = lim->mask;
+    uint8_t attack_shift = lim->attack_shift;
+    uint8_t release_shift = lim->release_shift;
+    uint32_t pos = lim->pos;
+
+    for (size_t i = 0; i < n; i++) {
+        int32_t x = in[i];
+        int32_t a = (x < 0) ? -x : x;
+        int32_t target = DSP_LIMITER_UNITY;
+
+        /* only peaks above the threshold pay for the divide */
+        if (a > threshold) {
+            target = ((threshold << 15) / a) << 15;
+        }
+        if (target < gain) {
+            gain -= (gain - target) >> attack_shift;
+        } else {
+            gain += (target - gain) >> release_shift;
+        }
+        if (gain < min_gain) {
+            min_gain = gain;
+        }
+
+        int32_t delayed = lim->delay[pos];
+        lim->delay[pos] = x;
+        pos = (pos + 1) & mask;
+
+        out[i] = dsp_soft_clip((delayed * (gain >> 15)) >> 15);
+    }
+    lim->gain = gain;
+    lim->pos = pos;
+
+    /* meter ballistics: instant on more reduction, decays back per block */
+    int32_t meter = lim->meter;
+    meter += (DSP_METER_UNITY - meter) >> DSP_METER_DECAY_SHIFT;
+    if ((min_gain >> 15) < meter) {
+        meter = min_gain >> 15;
+    }
+    __atomic_store_n(&lim->meter, meter, __ATOMIC_RELAXED);
+}
+
+uint16_t dsp_limiter_meter_db10(const dsp_limiter_t *lim)
+{
+    int32_t meter = __atomic_load_n(&lim->meter, __ATOMIC_RELAXED);
+
+    if (meter >= DSP_METER_UNITY - 4) {
+        return 0;
+    }
+    if (meter < 1) {
+        meter = 1;
+    }
+    return (uint16_t)(-200.0f * log10f((float)meter / DSP_METER_UNITY) + 0.5f);
+}
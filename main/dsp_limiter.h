@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __DSP_LIMITER_H__
+#define __DSP_LIMITER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* lookahead in interleaved samples, power of two; 32 frames is 0.67 ms at 48 kHz */
+#define DSP_LIMITER_LOOKAHEAD        (64)
+
+/* envelope time constants as shifts per sample: 1/16 per sample reaches the target
+ * well inside the lookahead, 1/8192 releases over ~90 ms at 44.1 kHz stereo */
+#define DSP_LIMITER_ATTACK_SHIFT     (4)
+#define DSP_LIMITER_RELEASE_SHIFT    (13)
+
+/* start of the soft clip knee, -2.5 dBFS; the limiter threshold should sit at or below it */
+#define DSP_SOFT_CLIP_KNEE           (24576)
+
+/* per band peak limiter with lookahead, followed by a soft clipper */
+typedef struct {
+    int32_t  threshold;                        /*!< peak level the output is held at */
+    int32_t  gain;                             /*!< Q30 current gain */
+    uint32_t mask;                             /*!< lookahead in use minus one */
+    uint8_t  attack_shift;
+    uint8_t  release_shift;
+    uint32_t pos;                              /*!< write position in the delay line */
+    int32_t  delay[DSP_LIMITER_LOOKAHEAD];     /*!< lookahead delay line */
+    int32_t  meter;                            /*!< Q15 metered gain, peak hold with decay, read from other tasks */
+} dsp_limiter_t;
+
+/**
+ * @brief  initialize a limiter at unity gain with an empty delay line
+ *
+ * @param [out] lim        limiter
+ * @param [in]  threshold  peak sample level, 1 ~ 32767
+ */
+void dsp_limiter_init(dsp_limiter_t *lim, int32_t threshold);
+
+/**
+ * @brief  change the threshold, runs in the audio path between blocks
+ */
+void dsp_limiter_set_threshold(dsp_limiter_t *lim, int32_t threshold);
+
+/**
+ * @brief  keep lookahead, attack and release times for a limiter fed 2^shift times
+ *         fewer samples per second than 44.1 kHz stereo, e.g. after decimation
+ *
+ *         Clears the delay line; runs in the audio path between blocks.
+ *
+ * @param [in] lim    limiter
+ * @param [in] shift  0 for the defaults, at most log2(DSP_LIMITER_LOOKAHEAD) - 2
+ */
+void dsp_limiter_set_rate_shift(dsp_limiter_t *lim, uint8_t shift);
+
+/**
+ * @brief  clear the delay line and return to unity gain, e.g. at the start of a stream
+ */
+void dsp_limiter_reset(dsp_limiter_t *lim);
+
+/**
+ * @brief  threshold in dBFS converted to a peak sample level
+ */
+int32_t dsp_limiter_threshold_from_db(float db);
+
+/**
+ * @brief  limit and soft clip a block
+ *
+ *         Output is delayed by the lookahead, DSP_LIMITER_LOOKAHEAD samples unless
+ *         dsp_limiter_set_rate_shift shortened it. Interleaved channels
+ *         share one gain, so the stereo image does not shift while limiting.
+ *
+ * @param [in]  lim  limiter
+ * @param [in]  in   samples of up to 17 bits, e.g. after a gain stage
+ * @param [out] out  16-bit output, may not alias in
+ * @param [in]  n    number of samples
+ */
+void dsp_limiter_process(dsp_limiter_t *lim, const int32_t *in, int16_t *out, size_t n);
+
+/**
+ * @brief  map a sample through the soft clip curve: linear up to the knee, then
+ *         a tanh shaped table approaching full scale
+ */
+int16_t dsp_soft_clip(int32_t x);
+
+/**
+ * @brief  metered gain reduction, safe to call from any task
+ *
+ * @return  gain reduction in 0.1 dB, 0 when the limiter is idle
+ */
+uint16_t dsp_limiter_meter_db10(const dsp_limiter_t *lim);
+
+#endif /* __DSP_LIMITER_H__ */
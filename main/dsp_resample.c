@@ -0,0 +1,225 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "dsp_resample.h"
+
+#define DSP_RESAMPLE_PI            (3.14159265f)
+#define DSP_RESAMPLE_KAISER_BETA   (6.0f)    /* about 60 dB of stopband */
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* zeroth order modified Bessel function, for the Kaiser window */
+static float dsp_resample_bessel_i0(float x);
+/* windowed-sinc low pass with its corner at the low rate Nyquist frequency, unity DC gain */
+static void dsp_resample_design(uint8_t factor, float *h, int len);
+/* round Q-format weights so they sum to exactly one */
+static void dsp_resample_quantize(const float *h, int stride, int n, int shift, int16_t *out);
+/* clamp to 16 bits */
+static inline int16_t dsp_resample_sat(int32_t x);
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static float dsp_resample_bessel_i0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+        if (term < sum * 1e-8f) {
+            break;
+        }
+    }
+    return sum;
+}
+
+static void dsp_resample_design(uint8_t factor, float *h, int len)
+{
+    float fc = 0.5f / factor;
+    float mid = (len - 1) / 2.0f;
+    float norm = dsp_resample_bessel_i0(DSP_RESAMPLE_KAISER_BETA);
+    float sum = 0.0f;
+
+    for (int i = 0; i < len; i++) {
+        float t = i - mid;
+        float r = t / mid;
+        float sinc = (t == 0.0f) ? 1.0f : sinf(2.0f * DSP_RESAMPLE_PI * fc * t) / (2.0f * DSP_RESAMPLE_PI * fc * t);
+        float w = dsp_resample_bessel_i0(DSP_RESAMPLE_KAISER_BETA * sqrtf(fmaxf(0.0f, 1.0f - r * r))) / norm;
+        h[i] = 2.0f * fc * sinc * w;
+        sum += h[i];
+    }
+    for (int i = 0; i < len; i++) {
+        h[i] /= sum;
+    }
+}
+
+static void dsp_resample_quantize(const float *h, int stride, int n, int shift, int16_t *out)
+{
+    float sum = 0.0f;
+    int32_t total = 0;
+    int peak = 0;
+
+    for (int i = 0; i < n; i++) {
+        sum += h[i * stride];
+    }
+    for (int i = 0; i < n; i++) {
+        float v = h[i * stride] / sum * (1 << shift);
+        out[i] = (int16_t)lroundf(v);
+        total += out[i];
+        if (out[i] > out[peak]) {
+            peak = i;
+        }
+    }
+    /* the rounding error goes to the largest tap, DC passes exactly */
+    out[peak] += (int16_t)((1 << shift) - total);
+}
+
+static inline int16_t dsp_resample_sat(int32_t x)
+{
+    if (x > INT16_MAX) {
+        return INT16_MAX;
+    }
+    return (x < INT16_MIN) ? INT16_MIN : (int16_t)x;
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void dsp_decim_init(dsp_decim_t *d, uint8_t factor)
+{
+    float h[DSP_RESAMPLE_MAX_TAPS];
+
+    if (factor < 2 || factor > DSP_RESAMPLE_MAX_FACTOR) {
+        factor = DSP_RESAMPLE_MAX_FACTOR;
+    }
+    memset(d, 0, sizeof(*d));
+    d->factor = factor;
+    d->len = factor * DSP_RESAMPLE_PHASE_TAPS;
+    dsp_resample_design(factor, h, d->len);
+    dsp_resample_quantize(h, 1, d->len, 15, d->coef);
+}
+
+void dsp_decim_reset(dsp_decim_t *d)
+{
+    d->phase = 0;
+    d->pos = 0;
+    memset(d->hist, 0, sizeof(d->hist));
+}
+
+size_t dsp_decim_process(dsp_decim_t *d, const int32_t *in, size_t frames, uint8_t ch, int32_t *out)
+{
+    const int16_t *coef = d->coef;
+    int16_t *hist = d->hist;
+    uint32_t len = d->len;
+    uint32_t pos = d->pos;
+    uint8_t phase = d->phase;
+    size_t n = 0;
+
+    for (size_t f = 0; f < frames; f++) {
+        int32_t x = (ch == 2) ? (in[2 * f] + in[2 * f + 1]) >> 1 : in[f];
+
+        pos = (pos == 0) ? len - 1 : pos - 1;
+        hist[pos] = hist[pos + len] = dsp_resample_sat(x);
+        if (++phase < d->factor) {
+            continue;
+        }
+        /* only every factor-th output of the low pass is computed */
+        const int16_t *win = &hist[pos];
+        int32_t acc = 1 << 14;
+        for (uint32_t k = 0; k < len; k++) {
+            acc += coef[k] * win[k];
+        }
+        out[n++] = acc >> 15;
+        phase = 0;
+    }
+    d->pos = pos;
+    d->phase = phase;
+    return n;
+}
+
+void dsp_interp_init(dsp_interp_t *it, uint8_t factor)
+{
+    float h[DSP_RESAMPLE_MAX_TAPS];
+
+    if (factor < 2 || factor > DSP_RESAMPLE_MAX_FACTOR) {
+        factor = DSP_RESAMPLE_MAX_FACTOR;
+    }
+    memset(it, 0, sizeof(*it));
+    it->factor = factor;
+    dsp_resample_design(factor, h, factor * DSP_RESAMPLE_PHASE_TAPS);
+    for (int p = 0; p < factor; p++) {
+        /* branch p takes every factor-th tap; the zero stuffing gain of factor is
+         * folded in by normalising each branch on its own, Q14 leaves headroom */
+        dsp_resample_quantize(&h[p], factor, DSP_RESAMPLE_PHASE_TAPS, 14, it->coef[p]);
+    }
+    dsp_interp_reset(it);
+}
+
+void dsp_interp_reset(dsp_interp_t *it)
+{
+    it->phase = 0;
+    it->pos = 0;
+    memset(it->hist, 0, sizeof(it->hist));
+    /* the first output comes before the decimator produced anything */
+    it->has_carry = true;
+    it->carry = 0;
+}
+
+void dsp_interp_process(dsp_interp_t *it, const int16_t *in, size_t n, int16_t *out, size_t frames)
+{
+    int16_t *hist = it->hist;
+    uint32_t pos = it->pos;
+    uint8_t phase = it->phase;
+    size_t next = 0;
+
+    for (size_t f = 0; f < frames; f++) {
+        if (phase == 0) {
+            int16_t x = 0;
+            if (it->has_carry) {
+                x = it->carry;
+                it->has_carry = false;
+            } else if (next < n) {
+                x = in[next++];
+            }
+            pos = (pos == 0) ? DSP_RESAMPLE_PHASE_TAPS - 1 : pos - 1;
+            hist[pos] = hist[pos + DSP_RESAMPLE_PHASE_TAPS] = x;
+        }
+        const int16_t *coef = it->coef[phase];
+        const int16_t *win = &hist[pos];
+        int32_t acc = 1 << 13;
+        for (int k = 0; k < DSP_RESAMPLE_PHASE_TAPS; k++) {
+            acc += coef[k] * win[k];
+        }
+        out[f] = dsp_resample_sat(acc >> 14);
+        if (++phase == it->factor) {
+            phase = 0;
+        }
+    }
+    if (next < n) {
+        it->carry = in[next];
+        it->has_carry = true;
+    }
+    it->pos = pos;
+    it->phase = phase;
+}
+
+uint32_t dsp_resample_latency_q8(uint8_t factor)
+{
+    /* (len - 1) / 2 through each linear phase filter, plus the one frame an
+     * output waits between the decimator and the interpolator */
+    return (uint32_t)factor * DSP_RESAMPLE_PHASE_TAPS << 8;
+}
@@ -0,0 +1,113 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __DSP_RESAMPLE_H__
+#define __DSP_RESAMPLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* largest rate change, a power of two */
+#define DSP_RESAMPLE_MAX_FACTOR    (8)
+
+/* taps of every polyphase branch, the prototype low pass has factor times as many */
+#define DSP_RESAMPLE_PHASE_TAPS    (8)
+
+#define DSP_RESAMPLE_MAX_TAPS      (DSP_RESAMPLE_MAX_FACTOR * DSP_RESAMPLE_PHASE_TAPS)
+
+/* mono decimator: low pass and keep every factor-th sample */
+typedef struct {
+    uint8_t  factor;
+    uint8_t  phase;                              /*!< inputs since the last output */
+    uint16_t len;                                /*!< prototype taps, factor * DSP_RESAMPLE_PHASE_TAPS */
+    uint32_t pos;                                /*!< newest sample in hist */
+    int16_t  coef[DSP_RESAMPLE_MAX_TAPS];        /*!< Q15 prototype, unity DC gain */
+    int16_t  hist[2 * DSP_RESAMPLE_MAX_TAPS];    /*!< history stored twice so a window never wraps */
+} dsp_decim_t;
+
+/* mono interpolator: zero stuffing and the same low pass, one polyphase branch per output */
+typedef struct {
+    uint8_t  factor;
+    uint8_t  phase;                                               /*!< branch of the next output */
+    uint32_t pos;                                                 /*!< newest sample in hist */
+    bool     has_carry;                                           /*!< a low rate sample waits for the next block */
+    int16_t  carry;
+    int16_t  coef[DSP_RESAMPLE_MAX_FACTOR][DSP_RESAMPLE_PHASE_TAPS];   /*!< Q15 branches, unity DC gain each */
+    int16_t  hist[2 * DSP_RESAMPLE_PHASE_TAPS];
+} dsp_interp_t;
+
+/**
+ * @brief  set up a decimator with an empty history
+ *
+ *         The low pass is designed here, so call it outside the audio path.
+ *
+ * @param [out] d       decimator
+ * @param [in]  factor  2, 4 or 8
+ */
+void dsp_decim_init(dsp_decim_t *d, uint8_t factor);
+
+/**
+ * @brief  clear the history, e.g. at the start of a stream
+ */
+void dsp_decim_reset(dsp_decim_t *d);
+
+/**
+ * @brief  outputs the next frames input frames will produce
+ */
+static inline size_t dsp_decim_out_count(const dsp_decim_t *d, size_t frames)
+{
+    return (d->phase + frames) / d->factor;
+}
+
+/**
+ * @brief  sum an interleaved block to mono and decimate it
+ *
+ * @param [in]  d       decimator
+ * @param [in]  in      interleaved samples of up to 17 bits
+ * @param [in]  frames  frames in the block
+ * @param [in]  ch      interleaved channels, 1 or 2
+ * @param [out] out     dsp_decim_out_count(frames) low rate samples
+ *
+ * @return  number of samples written to out
+ */
+size_t dsp_decim_process(dsp_decim_t *d, const int32_t *in, size_t frames, uint8_t ch, int32_t *out);
+
+/**
+ * @brief  set up an interpolator with an empty history, outside the audio path
+ *
+ * @param [out] it      interpolator
+ * @param [in]  factor  2, 4 or 8
+ */
+void dsp_interp_init(dsp_interp_t *it, uint8_t factor);
+
+/**
+ * @brief  clear the history, e.g. at the start of a stream
+ */
+void dsp_interp_reset(dsp_interp_t *it);
+
+/**
+ * @brief  interpolate a block back to the full rate
+ *
+ *         Every factor outputs take one low rate sample, one output after the
+ *         decimator produced it. Fed with exactly what the decimator produced for
+ *         the same frames, the two stay in step; at most one sample is held over
+ *         to the next block.
+ *
+ * @param [in]  it      interpolator
+ * @param [in]  in      low rate samples
+ * @param [in]  n       number of low rate samples
+ * @param [out] out     mono full rate samples
+ * @param [in]  frames  number of outputs
+ */
+void dsp_interp_process(dsp_interp_t *it, const int16_t *in, size_t n, int16_t *out, size_t frames);
+
+/**
+ * @brief  delay of a decimator and interpolator pair in full rate frames, Q8
+ */
+uint32_t dsp_resample_latency_q8(uint8_t factor);
+
+#endif /* __DSP_RESAMPLE_H__ */
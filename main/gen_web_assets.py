@@ -0,0 +1,85 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+#
+# Compress the web UI and emit it as a C asset table (see web_assets.h).
+# Output only depends on the file contents, so an unchanged UI keeps its ETags
+# across firmware builds and browsers keep their cached copy.
+
+import argparse
+import gzip
+import hashlib
+import os
+
+MIME_TYPES = {
+    '.html': 'text/html; charset=utf-8',
+    '.js': 'application/javascript',
+    '.css': 'text/css',
+    '.svg': 'image/svg+xml',
+    '.ico': 'image/x-icon',
+    '.json': 'application/json',
+}
+
+
+def c_bytes(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append('    ' + ', '.join('0x%02x' % b for b in data[i:i + 16]) + ',')
+    return '\n'.join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('-o', '--output', required=True, help='generated C file')
+    parser.add_argument('files', nargs='+', help='asset files, served as /<file name>')
+    args = parser.parse_args()
+
+    assets = []
+    raw_total = 0
+    for path in sorted(args.files, key=os.path.basename):
+        name = os.path.basename(path)
+        ext = os.path.splitext(name)[1]
+        if ext not in MIME_TYPES:
+            raise SystemExit('%s: unknown asset type' % path)
+        with open(path, 'rb') as f:
+            raw = f.read()
+        # mtime=0 keeps the gzip header, and thus the ETag, reproducible
+        data = gzip.compress(raw, compresslevel=9, mtime=0)
+        etag = hashlib.sha256(data).hexdigest()[:16]
+        assets.append((name, MIME_TYPES[ext], etag, data))
+        raw_total += len(raw)
+
+    out = ['/* generated by gen_web_assets.py, do not edit */', '',
+           '#include <stdint.h>', '#include <stddef.h>', '#include "web_assets.h"', '']
+    for i, (name, mime, etag, data) in enumerate(assets):
+        out.append('/* %s */' % name)
+        out.append('static const uint8_t s_asset_%d[%d] = {' % (i, len(data)))
+        out.append(c_bytes(data))
+        out.append('};')
+        out.append('')
+    out.append('const web_asset_t web_assets[] = {')
+    for i, (name, mime, etag, data) in enumerate(assets):
+        # strong ETag, quotes included as sent on the wire
+        out.append('    {"/%s", "%s", "\\"%s\\"", s_asset_%d, sizeof(s_asset_%d)},'
+                   % (name, mime, etag, i, i))
+    out.append('};')
+    out.append('')
+    out.append('const size_t web_assets_num = %d;' % len(assets))
+    out.append('')
+
+    text = '\n'.join(out)
+    # rewrite only on change so the component is not rebuilt needlessly
+    if os.path.exists(args.output):
+        with open(args.output, 'r') as f:
+            if f.read() == text:
+                return
+    with open(args.output, 'w') as f:
+        f.write(text)
+    print('web assets: %d files, %d bytes -> %d bytes gzipped'
+          % (len(assets), raw_total, sum(len(a[3]) for a in assets)))
+
+
+if __name__ == '__main__':
+    main()
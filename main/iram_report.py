@@ -0,0 +1,89 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+#
+# Print the IRAM taken by the main component, per source file, from the linker
+# map. Run after every link while EXAMPLE_AUDIO_IRAM places the audio path
+# there (see linker.lf), so its cost shows up next to the rest of the image.
+
+import argparse
+import re
+from collections import defaultdict
+
+OUT_SECTION = re.compile(r'^(\.\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+))?\s*$')
+IN_SECTION = re.compile(r'^ (\.\S+|COMMON)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*))?$')
+IN_CONT = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$')
+MEMORY = re.compile(r'^(iram0_0_seg)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)')
+OBJECT = re.compile(r'libmain\.a\((.+?)\.obj\)')
+IRAM_SECTION = '.iram0.text'
+
+
+def parse(path):
+    per_file = defaultdict(int)
+    out_size = {}
+    seg_len = None
+    out = None
+    pending = None
+
+    with open(path, 'r') as f:
+        for line in f:
+            line = line.rstrip('\n')
+            m = MEMORY.match(line)
+            if m and seg_len is None:
+                seg_len = int(m.group(3), 16)
+                continue
+            m = OUT_SECTION.match(line)
+            if m:
+                out = m.group(1)
+                if m.group(3):
+                    out_size[out] = int(m.group(3), 16)
+                pending = None
+                continue
+            if out == IRAM_SECTION and IRAM_SECTION not in out_size:
+                # a long output section name puts address and size on the next line
+                m = IN_CONT.match(line)
+                if m:
+                    out_size[out] = int(m.group(2), 16)
+                    continue
+            if out != IRAM_SECTION:
+                continue
+            m = IN_SECTION.match(line)
+            if m:
+                if m.group(3) is None:
+                    pending = m.group(1)
+                    continue
+                size, obj = int(m.group(3), 16), m.group(4)
+            elif pending:
+                m = IN_CONT.match(line)
+                pending = None
+                if not m:
+                    continue
+                size, obj = int(m.group(2), 16), m.group(3)
+            else:
+                continue
+            m = OBJECT.search(obj)
+            if m:
+                per_file[m.group(1)] += size
+    return per_file, out_size.get(IRAM_SECTION, 0), seg_len
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('map', help='linker map of the application')
+    args = parser.parse_args()
+
+    per_file, total, seg_len = parse(args.map)
+    main_total = sum(per_file.values())
+    print('IRAM used by main (EXAMPLE_AUDIO_IRAM):')
+    for name, size in sorted(per_file.items(), key=lambda kv: -kv[1]):
+        print('    %-20s %6d bytes' % (name, size))
+    line = '    %-20s %6d bytes of %d in %s' % ('total', main_total, total, IRAM_SECTION)
+    if seg_len:
+        line += ', segment %d' % seg_len
+    print(line)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,60 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include "json_writer.h"
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void json_writer_init(json_writer_t *w, char *buf, size_t len)
+{
+    w->buf = buf;
+    w->len = len;
+    w->pos = 0;
+    w->overflow = (len == 0);
+}
+
+void json_writer_printf(json_writer_t *w, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (w->overflow) {
+        return;
+    }
+    va_start(ap, fmt);
+    int n = vsnprintf(w->buf + w->pos, w->len - w->pos, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= w->len - w->pos) {
+        w->overflow = true;
+        return;
+    }
+    w->pos += n;
+}
+
+void json_writer_string(json_writer_t *w, const char *str)
+{
+    json_writer_printf(w, "\"");
+    for (const unsigned char *p = (const unsigned char *)str; *p && !w->overflow; p++) {
+        if (*p == '"' || *p == '\\') {
+            json_writer_printf(w, "\\%c", *p);
+        } else if (*p < 0x20) {
+            json_writer_printf(w, "\\u%04x", *p);
+        } else {
+            json_writer_printf(w, "%c", *p);
+        }
+    }
+    json_writer_printf(w, "\"");
+}
+
+int json_writer_result(const json_writer_t *w)
+{
+    return w->overflow ? -1 : (int)w->pos;
+}
@@ -0,0 +1,45 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __JSON_WRITER_H__
+#define __JSON_WRITER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* bounded JSON output, sticks at overflow so one check at the end is enough */
+typedef struct {
+    char   *buf;
+    size_t len;
+    size_t pos;
+    bool   overflow;
+} json_writer_t;
+
+/**
+ * @brief  start writing into a buffer
+ *
+ * @param [out] w    writer
+ * @param [out] buf  output buffer
+ * @param [in]  len  output buffer size in byte
+ */
+void json_writer_init(json_writer_t *w, char *buf, size_t len);
+
+/**
+ * @brief  append formatted text, nothing once the buffer overflowed
+ */
+void json_writer_printf(json_writer_t *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief  append a quoted and escaped string
+ */
+void json_writer_string(json_writer_t *w, const char *str);
+
+/**
+ * @brief  length of the text written, -1 if it did not fit
+ */
+int json_writer_result(const json_writer_t *w);
+
+#endif /* __JSON_WRITER_H__ */
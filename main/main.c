@@ -28,14 +28,21 @@
 #include "driver/gpio.h"
 #include "esp_timer.h"
 #include "web_control.h"
+#include "volume_encoder.h"
+#include "button_input.h"
+#include "app_ctrl.h"
+#include "wifi_coex.h"
+#include "trace.h"
+#include "app_state.h"
+#include "audio_dsp.h"
+#include "audio_preset.h"
+#include "settings.h"
+#include "mem_telemetry.h"
 
-#define RELAY_GPIO 18
-#define ENCODER_SW_GPIO 19 
-#define CLICK_TIMEOUT_MS 400
+#define ENCODER_SW_GPIO 19
+#define BUTTON_DEBOUNCE_MS 30
+#define BUTTON_LONG_PRESS_MS 3000
 
-bool party_mode = false;
-bool is_playing = false;
-bool system_on = false;
 
 
 static const char local_device_name[] = CONFIG_EXAMPLE_LOCAL_DEVICE_NAME;
@@ -201,7 +208,9 @@ static void bt_av_hdl_stack_evt(uint16_t event, void *p_param)
  void system_start(void)
 {
     gpio_set_level(RELAY_GPIO, 1);
+    bt_app_output_power(true);
 
+    mem_telemetry_cycle_begin(MEM_TELEMETRY_BT_STACK);
     esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
     esp_bt_controller_init(&bt_cfg);
     esp_bt_controller_enable(ESP_BT_MODE_CLASSIC_BT);
@@ -215,7 +224,7 @@ static void bt_av_hdl_stack_evt(uint16_t event, void *p_param)
     bt_app_work_dispatch(bt_av_hdl_stack_evt, BT_APP_EVT_STACK_UP, NULL, 0, NULL);
     ESP_LOGI("SYSTEM", "System turned ON");
 
-    system_on = true;
+    app_state_set_power(true);
 }
 
  void system_stop(void)
@@ -233,126 +242,148 @@ static void bt_av_hdl_stack_evt(uint16_t event, void *p_param)
     err = esp_avrc_tg_deinit();
     ESP_LOGI("SYSTEM", "esp_avrc_tg_deinit: %s", esp_err_to_name(err));
 
-    bt_app_task_shut_down();
     esp_bluedroid_disable();
     esp_bluedroid_deinit();
-    mute_audio_output();
+    bt_app_output_power(false);
     esp_bt_controller_disable();
     esp_bt_controller_deinit();
+    mem_telemetry_cycle_end(MEM_TELEMETRY_BT_STACK);
     ESP_LOGI("SYSTEM", "System turned OFF");
 
-    system_on = false;
+    app_state_set_power(false);
+    /* the supply may be cut next, do not wait for the quiet period */
+    settings_flush();
 }
 
-void encoder_task(void *arg)
+/*******************************
+ * CONTROL COMMAND EXECUTION
+ ******************************/
+
+static void ctrl_send_passthrough(uint8_t key_code)
 {
-    int last_state = 1;
-    int click_count = 0;
-    int64_t last_click_time = 0;
-    int64_t press_start = 0;
-    bool pressed = false;
+    esp_avrc_ct_send_passthrough_cmd(0, key_code, ESP_AVRC_PT_CMD_STATE_PRESSED);
+    esp_avrc_ct_send_passthrough_cmd(0, key_code, ESP_AVRC_PT_CMD_STATE_RELEASED);
+}
 
-    while (1)
+/* state change notification: the party LED follows the published mode */
+static void app_state_changed(uint32_t changed, const app_state_t *state)
+{
+    if (changed & APP_STATE_F_MODE)
     {
-        int state = gpio_get_level(ENCODER_SW_GPIO);
+        gpio_set_level(PARTY_MODE_LED_GPIO, (state->party_mode ? 1 : 0));
+    }
+}
+
+/* runs in the control task, one command at a time */
+static bool app_ctrl_execute(app_ctrl_cmd_t cmd, int32_t arg)
+{
+    app_state_t state;
 
-        // لبه پایین‌رو: شروع کلیک یا نگه داشتن
-        if (last_state == 1 && state == 0)
+    app_state_read(&state);
+    switch (cmd)
+    {
+    case APP_CTRL_CMD_POWER_ON:
+        if (!state.system_on)
         {
-            int64_t now = esp_timer_get_time() / 1000;
-            if (now - last_click_time > CLICK_TIMEOUT_MS)
-            {
-                click_count = 0;
-            }
-            click_count++;
-            last_click_time = now;
-            press_start = now;
-            pressed = true;
+            system_start();
         }
-
-        // لبه بالا‌رو: پایان کلیک یا نگه داشتن
-        if (last_state == 0 && state == 1)
+        return true;
+    case APP_CTRL_CMD_POWER_OFF:
+        if (state.system_on)
         {
-            pressed = false;
+            system_stop();
         }
-
-        // نگه داشتن دکمه
-        if (pressed)
+        return true;
+    case APP_CTRL_CMD_POWER_TOGGLE:
+        if (!state.system_on)
         {
-            int64_t now = esp_timer_get_time() / 1000;
-            if (now - press_start > 3000)
-            {
-                if (!system_on)
-                {
-                    system_start();
-                }
-                else
-                {
-                    system_stop();
-                }
-                // منتظر رها شدن دکمه
-                while (gpio_get_level(ENCODER_SW_GPIO) == 0)
-                {
-                    vTaskDelay(pdMS_TO_TICKS(10));
-                }
-                pressed = false;
-                click_count = 0;
-            }
+            system_start();
         }
-
-        // تشخیص کلیک‌های کوتاه
-        if (click_count > 0)
+        else
         {
-            int64_t now = esp_timer_get_time() / 1000;
-            if (now - last_click_time > CLICK_TIMEOUT_MS && !pressed)
-            {
-                if (system_on)
-                {
-                    if (click_count == 1)
-                    {
-                        // Play/Pause
-                        if (is_playing)
-                        {
-                            // اگر در حال پخش است، Pause کن
-                            esp_avrc_ct_send_passthrough_cmd(0, ESP_AVRC_PT_CMD_PAUSE, ESP_AVRC_PT_CMD_STATE_PRESSED);
-                            esp_avrc_ct_send_passthrough_cmd(0, ESP_AVRC_PT_CMD_PAUSE, ESP_AVRC_PT_CMD_STATE_RELEASED);
-                            is_playing = false; // وضعیت local را هم تغییر بده
-                        }
-                        else
-                        {
-                            // اگر پخش نیست، Play کن
-                            esp_avrc_ct_send_passthrough_cmd(0, ESP_AVRC_PT_CMD_PLAY, ESP_AVRC_PT_CMD_STATE_PRESSED);
-                            esp_avrc_ct_send_passthrough_cmd(0, ESP_AVRC_PT_CMD_PLAY, ESP_AVRC_PT_CMD_STATE_RELEASED);
-                            is_playing = true; // وضعیت local را هم تغییر بده
-                        }
-                    }
-                    else if (click_count == 2)
-                    {
-                        // Next Track
-                        esp_avrc_ct_send_passthrough_cmd(0, ESP_AVRC_PT_CMD_FORWARD, ESP_AVRC_PT_CMD_STATE_PRESSED);
-                        esp_avrc_ct_send_passthrough_cmd(0, ESP_AVRC_PT_CMD_FORWARD, ESP_AVRC_PT_CMD_STATE_RELEASED);
-                    }
-                    else if (click_count == 3)
-                    {
-                        // Previous Track
-                        esp_avrc_ct_send_passthrough_cmd(0, ESP_AVRC_PT_CMD_BACKWARD, ESP_AVRC_PT_CMD_STATE_PRESSED);
-                        esp_avrc_ct_send_passthrough_cmd(0, ESP_AVRC_PT_CMD_BACKWARD, ESP_AVRC_PT_CMD_STATE_RELEASED);
-                    }
-                    else if (click_count == 4)
-                    {
-                        party_mode = !party_mode;
-                        gpio_set_level(PARTY_MODE_LED_GPIO, (party_mode ? 1 : 0));
-                    }
-                }
-                click_count = 0;
-            }
+            system_stop();
         }
+        return true;
+    case APP_CTRL_CMD_MODE_PARTY:
+        return audio_preset_select(AUDIO_PRESET_PARTY) == ESP_OK;
+    case APP_CTRL_CMD_MODE_HOME:
+        return audio_preset_select(AUDIO_PRESET_HOME) == ESP_OK;
+    case APP_CTRL_CMD_MODE_TOGGLE:
+        return audio_preset_select(state.party_mode ? AUDIO_PRESET_HOME : AUDIO_PRESET_PARTY) == ESP_OK;
+    case APP_CTRL_CMD_PRESET_SELECT:
+        return audio_preset_select(arg) == ESP_OK;
+    case APP_CTRL_CMD_PRESET_NEXT:
+        return audio_preset_select(audio_preset_next()) == ESP_OK;
+    case APP_CTRL_CMD_PRESET_STORE:
+        return audio_preset_store(arg) == ESP_OK;
+    case APP_CTRL_CMD_VOLUME_SET:
+        bt_app_volume_step(arg - state.volume);
+        return true;
+    case APP_CTRL_CMD_VOLUME_STEP:
+        bt_app_volume_step(arg);
+        return true;
+    default:
+        break;
+    }
+
+    /* transport controls need a running stack */
+    if (!state.system_on)
+    {
+        return false;
+    }
+    switch (cmd)
+    {
+    case APP_CTRL_CMD_PLAY_PAUSE:
+        // اگر در حال پخش است، Pause کن؛ در غیر این صورت Play
+        ctrl_send_passthrough(state.is_playing ? ESP_AVRC_PT_CMD_PAUSE : ESP_AVRC_PT_CMD_PLAY);
+        app_state_set_playing(!state.is_playing); // وضعیت local را هم تغییر بده
+        return true;
+    case APP_CTRL_CMD_NEXT_TRACK:
+        ctrl_send_passthrough(ESP_AVRC_PT_CMD_FORWARD);
+        return true;
+    case APP_CTRL_CMD_PREV_TRACK:
+        ctrl_send_passthrough(ESP_AVRC_PT_CMD_BACKWARD);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*******************************
+ * BUTTON GESTURE ACTIONS
+ ******************************/
+
+/* gesture to command table, transport commands fail while the system is off */
+static const struct {
+    button_gesture_t gesture;
+    app_ctrl_cmd_t   cmd;
+} s_button_actions[] = {
+    { BUTTON_GESTURE_LONG_PRESS,   APP_CTRL_CMD_POWER_TOGGLE },
+    { BUTTON_GESTURE_CLICK,        APP_CTRL_CMD_PLAY_PAUSE },
+    { BUTTON_GESTURE_DOUBLE_CLICK, APP_CTRL_CMD_NEXT_TRACK },
+    { BUTTON_GESTURE_TRIPLE_CLICK, APP_CTRL_CMD_PREV_TRACK },
+    { BUTTON_GESTURE_QUAD_CLICK,   APP_CTRL_CMD_PRESET_NEXT },
+};
 
-        last_state = state;
-        vTaskDelay(pdMS_TO_TICKS(10));
+static void button_gesture_cb(button_gesture_t gesture)
+{
+    /* any gesture brings a suspended soft-AP back, the gesture still does its job */
+    wifi_coex_wake();
+    for (size_t i = 0; i < sizeof(s_button_actions) / sizeof(s_button_actions[0]); i++)
+    {
+        if (s_button_actions[i].gesture == gesture)
+        {
+            app_ctrl_submit(s_button_actions[i].cmd, 0);
+            return;
+        }
     }
 }
 
+static void encoder_volume_cb(int delta)
+{
+    app_ctrl_submit(APP_CTRL_CMD_VOLUME_STEP, delta);
+}
+
 void app_main(void)
 {
     // مقداردهی اولیه پایه رله (قبل از هر چیز)
@@ -368,10 +399,7 @@ void app_main(void)
     // مقداردهی اولیه پایه LED پارتی‌مد
     gpio_set_direction(PARTY_MODE_LED_GPIO, GPIO_MODE_OUTPUT);
     gpio_set_level(PARTY_MODE_LED_GPIO, 0);
-
-    // مقداردهی اولیه پایه دکمه (در صورت نیاز)
-    gpio_set_direction(ENCODER_SW_GPIO, GPIO_MODE_INPUT);
-    gpio_pullup_en(ENCODER_SW_GPIO);
+    app_state_register_cb(app_state_changed);
 
     esp_err_t err = nvs_flash_init();
     if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND)
@@ -383,10 +411,47 @@ void app_main(void)
 
     ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_BLE));
 
+    mem_telemetry_start();
+    trace_start();
+    audio_dsp_init();
+    /* created once, connections and power cycles only start, stop and reclock them */
+    bt_app_output_init();
+    /* volume, preset and routing survive a reboot, the rest starts from defaults */
+    settings_init();
+    int32_t preset = AUDIO_PRESET_BOOT;
+    int32_t volume;
+    int32_t routing;
+    if (settings_get(SETTINGS_ROUTING, &routing))
+    {
+        /* before the preset, which keeps the live routing */
+        audio_dsp_params_t dsp_params;
+        audio_dsp_get_params(&dsp_params);
+        if (audio_dsp_routing_unpack(&dsp_params, (uint32_t)routing))
+        {
+            audio_dsp_set_params(&dsp_params);
+        }
+    }
+    settings_get(SETTINGS_PRESET, &preset);
+    audio_preset_init(preset);
+    if (settings_get(SETTINGS_VOLUME, &volume))
+    {
+        app_state_set_volume(volume);
+    }
     wifi_init_softap();
+    wifi_coex_start();
     start_webserver();
 
-    xTaskCreate(encoder_task, "encoder_task", 4096, NULL, 5, NULL);
+    /* the application task and the control executor outlive power cycles */
+    bt_app_task_start_up();
+    app_ctrl_start_up(app_ctrl_execute);
+
+    button_gesture_config_t button_cfg = {
+        .debounce_ms = BUTTON_DEBOUNCE_MS,
+        .click_timeout_ms = CLICK_TIMEOUT_MS,
+        .long_press_ms = BUTTON_LONG_PRESS_MS,
+    };
+    button_input_start(ENCODER_SW_GPIO, &button_cfg, button_gesture_cb);
+    volume_encoder_start(ENCODER_PIN_A, ENCODER_PIN_B, encoder_volume_cb);
 
     // ... سایر کدهای راه‌اندازی (در صورت نیاز) ...
 }
@@ -0,0 +1,241 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#include "json_writer.h"
+#include "mem_telemetry.h"
+
+#define MEM_TELEMETRY_PERIOD_US    ((uint64_t)CONFIG_EXAMPLE_MEM_TELEMETRY_PERIOD_S * 1000000)
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* heap_caps failed allocation hook, may run in any context */
+static void mem_telemetry_alloc_failed(size_t size, uint32_t caps, const char *function_name);
+/* take one history sample, runs in the esp_timer task */
+static void mem_telemetry_sample(void *arg);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const char *s_subsys_str[MEM_TELEMETRY_NUM] = {"ringbuf", "app_msg", "avrc_meta", "bt_stack", "dsp", "pcm_tap"};
+
+/* heap regions reported, internal RAM alone and what DMA or byte access can use */
+static const struct {
+    const char *name;
+    uint32_t   caps;
+} s_heaps[] = {
+    {"internal", MALLOC_CAP_INTERNAL},
+    {"dma", MALLOC_CAP_DMA},
+    {"8bit", MALLOC_CAP_8BIT},
+};
+
+/* tasks whose stack high water marks are reported, looked up by name; absent ones are skipped */
+static const char *s_task_names[] = {
+    "BtAppTask", "BtI2STask", "AppCtrlTask", "ButtonTask", "EncoderTask", "SettingsTask",
+    "WebPushTask", "WifiCoexTask", "TraceTask", "BTC_TASK", "BTU_TASK", "btController",
+    "httpd", "wifi", "tiT", "sys_evt", "esp_timer",
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static mem_telemetry_subsys_stats_t s_subsys[MEM_TELEMETRY_NUM];
+static uint32_t s_cycle_free[MEM_TELEMETRY_NUM];      /* internal free heap when the open cycle began */
+static uint32_t s_failed_count = 0;
+static uint32_t s_failed_size = 0;
+static uint32_t s_failed_caps = 0;
+static mem_telemetry_sample_t s_history[MEM_TELEMETRY_HISTORY_LEN];
+static uint32_t s_history_head = 0;                    /* samples taken since boot */
+static esp_timer_handle_t s_sample_timer = NULL;
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static void IRAM_ATTR mem_telemetry_alloc_failed(size_t size, uint32_t caps, const char *function_name)
+{
+    portENTER_CRITICAL_SAFE(&s_lock);
+    s_failed_count++;
+    s_failed_size = size;
+    s_failed_caps = caps;
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+static void mem_telemetry_sample(void *arg)
+{
+    mem_telemetry_sample_t sample = {
+        .uptime_s = (uint32_t)(esp_timer_get_time() / 1000000),
+        .internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+        .internal_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+        .dma_free = heap_caps_get_free_size(MALLOC_CAP_DMA),
+        .internal_min = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+    };
+
+    portENTER_CRITICAL(&s_lock);
+    s_history[s_history_head % MEM_TELEMETRY_HISTORY_LEN] = sample;
+    s_history_head++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void mem_telemetry_start(void)
+{
+    if (s_sample_timer != NULL) {
+        return;
+    }
+    heap_caps_register_failed_alloc_callback(mem_telemetry_alloc_failed);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = mem_telemetry_sample,
+        .name = "mem_telemetry",
+    };
+    if (esp_timer_create(&timer_args, &s_sample_timer) != ESP_OK) {
+        ESP_LOGE(MEM_TELEMETRY_TAG, "%s, timer create failed", __func__);
+        return;
+    }
+    mem_telemetry_sample(NULL);
+    esp_timer_start_periodic(s_sample_timer, MEM_TELEMETRY_PERIOD_US);
+}
+
+void mem_telemetry_alloc(mem_telemetry_subsys_t subsys, size_t bytes, bool ok)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (ok) {
+        s_subsys[subsys].allocs++;
+        s_subsys[subsys].bytes += bytes;
+    } else {
+        s_subsys[subsys].failures++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void mem_telemetry_free(mem_telemetry_subsys_t subsys)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_subsys[subsys].frees++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void mem_telemetry_cycle_begin(mem_telemetry_subsys_t subsys)
+{
+    uint32_t free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+
+    portENTER_CRITICAL(&s_lock);
+    s_cycle_free[subsys] = free;
+    s_subsys[subsys].allocs++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void mem_telemetry_cycle_end(mem_telemetry_subsys_t subsys)
+{
+    uint32_t free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    int32_t retained;
+
+    portENTER_CRITICAL(&s_lock);
+    s_subsys[subsys].frees++;
+    if (s_cycle_free[subsys] != 0) {
+        s_subsys[subsys].retained = (int32_t)(s_cycle_free[subsys] - free);
+        s_cycle_free[subsys] = 0;
+    }
+    retained = s_subsys[subsys].retained;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(MEM_TELEMETRY_TAG, "%s cycle done, %" PRId32 " bytes of internal heap not given back",
+             s_subsys_str[subsys], retained);
+}
+
+int mem_telemetry_to_json(char *buf, size_t len)
+{
+    json_writer_t w;
+    mem_telemetry_subsys_stats_t subsys[MEM_TELEMETRY_NUM];
+    uint32_t failed_count, failed_size, failed_caps;
+
+    portENTER_CRITICAL(&s_lock);
+    memcpy(subsys, s_subsys, sizeof(subsys));
+    failed_count = s_failed_count;
+    failed_size = s_failed_size;
+    failed_caps = s_failed_caps;
+    portEXIT_CRITICAL(&s_lock);
+
+    json_writer_init(&w, buf, len);
+    json_writer_printf(&w, "{\"uptime_s\":%" PRIu32 ",\"heap\":{", (uint32_t)(esp_timer_get_time() / 1000000));
+    for (size_t i = 0; i < sizeof(s_heaps) / sizeof(s_heaps[0]); i++) {
+        uint32_t caps = s_heaps[i].caps;
+        json_writer_printf(&w, "%s\"%s\":{\"free\":%u,\"largest\":%u,\"min\":%u,\"total\":%u}",
+                           (i > 0) ? "," : "", s_heaps[i].name,
+                           (unsigned)heap_caps_get_free_size(caps), (unsigned)heap_caps_get_largest_free_block(caps),
+                           (unsigned)heap_caps_get_minimum_free_size(caps), (unsigned)heap_caps_get_total_size(caps));
+    }
+    json_writer_printf(&w, "},\"failed\":{\"count\":%" PRIu32 ",\"last_size\":%" PRIu32 ",\"last_caps\":\"0x%" PRIx32 "\"}",
+                       failed_count, failed_size, failed_caps);
+
+    /* free stack in bytes at the deepest point each task reached */
+    bool first = true;
+    json_writer_printf(&w, ",\"stack_free\":{");
+    for (size_t i = 0; i < sizeof(s_task_names) / sizeof(s_task_names[0]); i++) {
+        /* no task is deleted between the lookup and the query on this core */
+        vTaskSuspendAll();
+        TaskHandle_t task = xTaskGetHandle(s_task_names[i]);
+        UBaseType_t mark = task ? uxTaskGetStackHighWaterMark(task) : 0;
+        xTaskResumeAll();
+        if (task == NULL) {
+            continue;
+        }
+        json_writer_printf(&w, "%s\"%s\":%u", first ? "" : ",", s_task_names[i], (unsigned)mark);
+        first = false;
+    }
+
+    json_writer_printf(&w, "},\"subsystems\":{");
+    for (int s = 0; s < MEM_TELEMETRY_NUM; s++) {
+        const mem_telemetry_subsys_stats_t *st = &subsys[s];
+        json_writer_printf(&w, "%s\"%s\":{\"allocs\":%" PRIu32 ",\"frees\":%" PRIu32 ",\"live\":%" PRId32
+                           ",\"failures\":%" PRIu32 ",\"bytes\":%" PRIu32 ",\"retained\":%" PRId32 "}",
+                           (s > 0) ? "," : "", s_subsys_str[s], st->allocs, st->frees,
+                           (int32_t)(st->allocs - st->frees), st->failures, st->bytes, st->retained);
+    }
+    json_writer_printf(&w, "}}");
+    return json_writer_result(&w);
+}
+
+int mem_telemetry_history_to_json(char *buf, size_t len)
+{
+    json_writer_t w;
+    mem_telemetry_sample_t history[MEM_TELEMETRY_HISTORY_LEN];
+    uint32_t head;
+
+    portENTER_CRITICAL(&s_lock);
+    memcpy(history, s_history, sizeof(history));
+    head = s_history_head;
+    portEXIT_CRITICAL(&s_lock);
+
+    uint32_t count = (head < MEM_TELEMETRY_HISTORY_LEN) ? head : MEM_TELEMETRY_HISTORY_LEN;
+    json_writer_init(&w, buf, len);
+    json_writer_printf(&w, "{\"period_s\":%d,"
+                       "\"fields\":[\"uptime_s\",\"internal_free\",\"internal_largest\",\"dma_free\",\"internal_min\"],"
+                       "\"samples\":[", CONFIG_EXAMPLE_MEM_TELEMETRY_PERIOD_S);
+    for (uint32_t i = 0; i < count; i++) {
+        const mem_telemetry_sample_t *p = &history[(head - count + i) % MEM_TELEMETRY_HISTORY_LEN];
+        json_writer_printf(&w, "%s[%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 "]",
+                           (i > 0) ? "," : "", p->uptime_s, p->internal_free, p->internal_largest,
+                           p->dma_free, p->internal_min);
+    }
+    json_writer_printf(&w, "]}");
+    return json_writer_result(&w);
+}
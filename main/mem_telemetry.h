@@ -0,0 +1,105 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __MEM_TELEMETRY_H__
+#define __MEM_TELEMETRY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* log tag */
+#define MEM_TELEMETRY_TAG    "MEM_TELEMETRY"
+
+/* samples kept, one every CONFIG_EXAMPLE_MEM_TELEMETRY_PERIOD_S */
+#define MEM_TELEMETRY_HISTORY_LEN    (32)
+
+/* allocation sites the counters are attributed to, keep in sync with s_subsys_str */
+typedef enum {
+    MEM_TELEMETRY_RINGBUF = 0,   /*!< I2S ringbuffer, one per A2DP connection */
+    MEM_TELEMETRY_APP_MSG,       /*!< parameters of work dispatched to the application task */
+    MEM_TELEMETRY_AVRC_META,     /*!< AVRCP metadata text */
+    MEM_TELEMETRY_BT_STACK,      /*!< controller and Bluedroid, one allocation per power cycle */
+    MEM_TELEMETRY_DSP,           /*!< delay lines */
+    MEM_TELEMETRY_PCM_TAP,       /*!< ring of an armed PCM tap */
+    MEM_TELEMETRY_NUM,
+} mem_telemetry_subsys_t;
+
+/* allocation counters of one subsystem since boot */
+typedef struct {
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;
+    uint32_t bytes;       /*!< requested in total, where the size is known */
+    int32_t  retained;    /*!< internal heap not given back by the last alloc / free cycle */
+} mem_telemetry_subsys_stats_t;
+
+/* one point of the history */
+typedef struct {
+    uint32_t uptime_s;
+    uint32_t internal_free;
+    uint32_t internal_largest;    /*!< largest free block, falls with fragmentation */
+    uint32_t dma_free;
+    uint32_t internal_min;        /*!< lowest internal free heap ever */
+} mem_telemetry_sample_t;
+
+/**
+ * @brief  hook failed allocations and start periodic sampling
+ *
+ *         Call once, early in app_main.
+ */
+void mem_telemetry_start(void);
+
+/**
+ * @brief  count an allocation of a subsystem
+ *
+ * @param [in] subsys  subsystem
+ * @param [in] bytes   size requested, 0 if not known
+ * @param [in] ok      the allocation succeeded
+ */
+void mem_telemetry_alloc(mem_telemetry_subsys_t subsys, size_t bytes, bool ok);
+
+/**
+ * @brief  count a free of a subsystem
+ */
+void mem_telemetry_free(mem_telemetry_subsys_t subsys);
+
+/**
+ * @brief  count an allocation and note the internal free heap before it
+ *
+ *         For subsystems that allocate a lot at once and give it all back
+ *         later, e.g. a BT stack power cycle. The matching
+ *         mem_telemetry_cycle_end records what was not given back.
+ */
+void mem_telemetry_cycle_begin(mem_telemetry_subsys_t subsys);
+
+/**
+ * @brief  count the free that ends a cycle and record the heap it kept
+ */
+void mem_telemetry_cycle_end(mem_telemetry_subsys_t subsys);
+
+/**
+ * @brief  serialise heap per capability, failed allocations, stack high water
+ *         marks of the known tasks and the subsystem counters as JSON
+ *
+ * @param [out] buf  output buffer
+ * @param [in]  len  output buffer size in byte
+ *
+ * @return  length of the JSON text, -1 if it does not fit
+ */
+int mem_telemetry_to_json(char *buf, size_t len);
+
+/**
+ * @brief  serialise the sample history as JSON, oldest first
+ *
+ * @param [out] buf  output buffer
+ * @param [in]  len  output buffer size in byte
+ *
+ * @return  length of the JSON text, -1 if it does not fit
+ */
+int mem_telemetry_history_to_json(char *buf, size_t len);
+
+#endif /* __MEM_TELEMETRY_H__ */
@@ -0,0 +1,328 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#include "audio_output.h"
+#include "mem_telemetry.h"
+#include "pcm_tap.h"
+
+/* One tap point at a time copies what passes it into a ring of 16-bit
+ * frames. The audio task is the only writer, the streaming task the only
+ * reader, head and tail are free running sample counts. */
+
+#ifdef CONFIG_EXAMPLE_PCM_TAP_RING_KB
+#define PCM_TAP_RING_BYTES    (CONFIG_EXAMPLE_PCM_TAP_RING_KB * 1024)
+#else
+#define PCM_TAP_RING_BYTES    (16 * 1024)
+#endif
+#define PCM_TAP_MAX_CH        (4)        /* both ports of a stereo stream */
+
+/* what a tap point hands over, a constant of pcm_tap_put after inlining */
+#define PCM_TAP_SRC_16        (0)        /* interleaved 16-bit samples */
+#define PCM_TAP_SRC_32        (1)        /* interleaved 32-bit band chunk */
+#define PCM_TAP_SRC_PORTS     (2)        /* mid and bass port, one frame out of both */
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* little endian fields of the WAV header */
+static void pcm_tap_put16(uint8_t *p, uint16_t v);
+static void pcm_tap_put32(uint8_t *p, uint32_t v);
+/* one sample of channel c of a frame, saturated to 16 bits */
+static inline int32_t pcm_tap_sample(const void *a, const int16_t *b, size_t frame, int c, const int src);
+/* average, convert and copy a block into the ring, or drop it whole */
+static inline void pcm_tap_put(pcm_tap_point_t point, const void *a, const int16_t *b, size_t samples, const int src);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const char *s_point_str[PCM_TAP_NUM] = {"input", "xover_mid", "xover_bass", "limiter"};
+
+static uint32_t s_claimed = 0;           /* arm to disarm, keeps a second stream out */
+static int s_point = -1;                 /* point the audio task copies from */
+static uint32_t s_writing = 0;           /* audio task inside pcm_tap_put */
+static uint32_t s_stale = 0;             /* stream format differs from the armed one */
+static int16_t *s_ring = NULL;
+static uint32_t s_mask = 0;              /* ring length in samples - 1 */
+static uint32_t s_head = 0;              /* written by the audio task */
+static uint32_t s_tail = 0;              /* written by the reader */
+static uint32_t s_src_rate = 0;          /* stream format the tap was armed for */
+static uint8_t s_src_ch = 0;             /* interleaved channels of one source buffer */
+static uint8_t s_ch = 0;                 /* channels of a ring frame */
+static uint8_t s_decim = 1;
+static uint8_t s_shift = 0;              /* log2 of s_decim */
+static uint8_t s_phase = 0;              /* frames summed into s_acc so far */
+static int32_t s_acc[PCM_TAP_MAX_CH];
+static pcm_tap_stats_t s_stats = {.point = -1, .decim = 1};
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static void pcm_tap_put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void pcm_tap_put32(uint8_t *p, uint32_t v)
+{
+    pcm_tap_put16(p, (uint16_t)v);
+    pcm_tap_put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static inline __attribute__((always_inline))
+int32_t pcm_tap_sample(const void *a, const int16_t *b, size_t frame, int c, const int src)
+{
+    if (src == PCM_TAP_SRC_32) {
+        int32_t x = ((const int32_t *)a)[frame * s_src_ch + c];
+        return (x > INT16_MAX) ? INT16_MAX : (x < INT16_MIN) ? INT16_MIN : x;
+    }
+    if (src == PCM_TAP_SRC_PORTS) {
+        return (c < s_src_ch) ? ((const int16_t *)a)[frame * s_src_ch + c] : b[frame * s_src_ch + c - s_src_ch];
+    }
+    return ((const int16_t *)a)[frame * s_src_ch + c];
+}
+
+static inline __attribute__((always_inline))
+void pcm_tap_put(pcm_tap_point_t point, const void *a, const int16_t *b, size_t samples, const int src)
+{
+    /* most blocks pass with the point not armed */
+    if (__atomic_load_n(&s_point, __ATOMIC_RELAXED) != (int)point) {
+        return;
+    }
+    /* announced before the check, so disarm either sees it or this call sees the tap gone */
+    __atomic_store_n(&s_writing, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&s_point, __ATOMIC_SEQ_CST) != (int)point || __atomic_load_n(&s_stale, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&s_writing, 0, __ATOMIC_RELEASE);
+        return;
+    }
+
+    size_t frames = samples / s_src_ch;
+    uint32_t need = ((s_phase + frames) >> s_shift) * s_ch;
+    uint32_t head = s_head;
+    uint32_t used = head - __atomic_load_n(&s_tail, __ATOMIC_ACQUIRE);
+
+    if (need > s_mask + 1 - used) {
+        /* the whole block or nothing: the reader sees one gap, never a torn block */
+        s_stats.drops++;
+        s_stats.dropped_bytes += need * sizeof(int16_t);
+        s_phase = 0;
+        memset(s_acc, 0, sizeof(s_acc));
+        __atomic_store_n(&s_writing, 0, __ATOMIC_RELEASE);
+        return;
+    }
+    for (size_t f = 0; f < frames; f++) {
+        for (int c = 0; c < s_ch; c++) {
+            s_acc[c] += pcm_tap_sample(a, b, f, c, src);
+        }
+        if (++s_phase == s_decim) {
+            /* boxcar average, enough to keep the bulk of what folds down out of a scope trace */
+            for (int c = 0; c < s_ch; c++) {
+                s_ring[head++ & s_mask] = (int16_t)(s_acc[c] >> s_shift);
+                s_acc[c] = 0;
+            }
+            s_phase = 0;
+        }
+    }
+    __atomic_store_n(&s_head, head, __ATOMIC_RELEASE);
+    s_stats.bytes += need * sizeof(int16_t);
+    __atomic_store_n(&s_writing, 0, __ATOMIC_RELEASE);
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+esp_err_t pcm_tap_arm(pcm_tap_point_t point, uint8_t decim, pcm_tap_format_t *fmt)
+{
+    audio_output_stats_t out;
+    size_t bytes = 1;
+    uint8_t shift = 0;
+
+    if ((unsigned)point >= PCM_TAP_NUM || decim == 0 || decim > PCM_TAP_MAX_DECIM || (decim & (decim - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (__atomic_exchange_n(&s_claimed, 1, __ATOMIC_ACQUIRE)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    while ((1u << shift) < decim) {
+        shift++;
+    }
+    while (bytes * 2 <= PCM_TAP_RING_BYTES) {
+        bytes *= 2;
+    }
+    s_ring = heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    mem_telemetry_alloc(MEM_TELEMETRY_PCM_TAP, bytes, s_ring != NULL);
+    if (s_ring == NULL) {
+        ESP_LOGW(PCM_TAP_TAG, "%s, no internal RAM for a %u byte ring", __func__, (unsigned)bytes);
+        __atomic_store_n(&s_claimed, 0, __ATOMIC_RELEASE);
+        return ESP_ERR_NO_MEM;
+    }
+
+    audio_output_get_stats(&out);
+    s_src_rate = out.rate;
+    s_src_ch = out.ch;
+    s_ch = (point == PCM_TAP_LIMITER) ? out.ch * 2 : out.ch;
+    s_decim = decim;
+    s_shift = shift;
+    s_phase = 0;
+    memset(s_acc, 0, sizeof(s_acc));
+    s_mask = bytes / sizeof(int16_t) - 1;
+    s_head = 0;
+    s_tail = 0;
+    s_stale = 0;
+    s_stats.decim = decim;
+    s_stats.rate = out.rate / decim;
+    s_stats.ch = s_ch;
+    s_stats.ring_bytes = bytes;
+    s_stats.arms++;
+    s_stats.point = point;
+    /* everything above is visible to the audio task before it sees the point */
+    __atomic_store_n(&s_point, (int)point, __ATOMIC_SEQ_CST);
+
+    fmt->rate = s_stats.rate;
+    fmt->ch = s_ch;
+    ESP_LOGI(PCM_TAP_TAG, "%s armed, %" PRIu32 " Hz, %u ch, %u byte ring", s_point_str[point], fmt->rate, fmt->ch,
+             (unsigned)bytes);
+    return ESP_OK;
+}
+
+void pcm_tap_disarm(void)
+{
+    if (!__atomic_load_n(&s_claimed, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    __atomic_store_n(&s_point, -1, __ATOMIC_SEQ_CST);
+    /* at most one block, the audio task never waits inside */
+    while (__atomic_load_n(&s_writing, __ATOMIC_SEQ_CST)) {
+        vTaskDelay(1);
+    }
+    heap_caps_free(s_ring);
+    s_ring = NULL;
+    mem_telemetry_free(MEM_TELEMETRY_PCM_TAP);
+    s_stats.point = -1;
+    s_stats.ring_bytes = 0;
+    ESP_LOGI(PCM_TAP_TAG, "disarmed, %" PRIu32 " blocks dropped so far", s_stats.drops);
+    __atomic_store_n(&s_claimed, 0, __ATOMIC_RELEASE);
+}
+
+size_t pcm_tap_read(uint8_t *buf, size_t len)
+{
+    if (s_ring == NULL) {
+        return 0;
+    }
+    uint32_t tail = s_tail;
+    uint32_t avail = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE) - tail;
+    /* the writer only ever adds whole frames */
+    uint32_t n = (len / sizeof(int16_t) / s_ch) * s_ch;
+
+    if (n > avail) {
+        n = avail;
+    }
+    uint32_t at = tail & s_mask;
+    uint32_t first = s_mask + 1 - at;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(buf, &s_ring[at], first * sizeof(int16_t));
+    memcpy(buf + first * sizeof(int16_t), s_ring, (n - first) * sizeof(int16_t));
+    __atomic_store_n(&s_tail, tail + n, __ATOMIC_RELEASE);
+    return n * sizeof(int16_t);
+}
+
+bool pcm_tap_stale(void)
+{
+    return __atomic_load_n(&s_stale, __ATOMIC_RELAXED) != 0;
+}
+
+void pcm_tap_set_format(uint32_t sample_rate, uint8_t ch_count)
+{
+    /* a WAV stream cannot change format halfway, the reader drains what is left and ends it */
+    if (__atomic_load_n(&s_point, __ATOMIC_ACQUIRE) >= 0 && (sample_rate != s_src_rate || ch_count != s_src_ch)) {
+        __atomic_store_n(&s_stale, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void pcm_tap_write(pcm_tap_point_t point, const int16_t *in, size_t samples)
+{
+    pcm_tap_put(point, in, NULL, samples, PCM_TAP_SRC_16);
+}
+
+void pcm_tap_write32(pcm_tap_point_t point, const int32_t *in, size_t samples)
+{
+    pcm_tap_put(point, in, NULL, samples, PCM_TAP_SRC_32);
+}
+
+void pcm_tap_write_ports(const int16_t *mid, const int16_t *bass, size_t samples)
+{
+    pcm_tap_put(PCM_TAP_LIMITER, mid, bass, samples, PCM_TAP_SRC_PORTS);
+}
+
+void pcm_tap_wav_header(uint8_t *hdr, const pcm_tap_format_t *fmt)
+{
+    /* the stream may end early, players read up to the end of the connection */
+    memcpy(hdr, "RIFF", 4);
+    pcm_tap_put32(hdr + 4, UINT32_MAX);
+    memcpy(hdr + 8, "WAVEfmt ", 8);
+    pcm_tap_put32(hdr + 16, 16);
+    pcm_tap_put16(hdr + 20, 1);                                  /* PCM */
+    pcm_tap_put16(hdr + 22, fmt->ch);
+    pcm_tap_put32(hdr + 24, fmt->rate);
+    pcm_tap_put32(hdr + 28, fmt->rate * fmt->ch * sizeof(int16_t));
+    pcm_tap_put16(hdr + 32, fmt->ch * sizeof(int16_t));
+    pcm_tap_put16(hdr + 34, 16);
+    memcpy(hdr + 36, "data", 4);
+    pcm_tap_put32(hdr + 40, UINT32_MAX);
+}
+
+const char *pcm_tap_point_str(int point)
+{
+    return (point >= 0 && point < PCM_TAP_NUM) ? s_point_str[point] : "none";
+}
+
+int pcm_tap_point_from_str(const char *str)
+{
+    for (int i = 0; i < PCM_TAP_NUM; i++) {
+        if (strcmp(str, s_point_str[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void pcm_tap_get_stats(pcm_tap_stats_t *stats)
+{
+    /* counters are read without a lock, a torn value only skews one report */
+    *stats = s_stats;
+    stats->stale = pcm_tap_stale();
+}
+
+int pcm_tap_to_json(char *buf, size_t len)
+{
+    pcm_tap_stats_t stats;
+
+    pcm_tap_get_stats(&stats);
+    int n = snprintf(buf, len,
+                     "{\"points\":[\"%s\",\"%s\",\"%s\",\"%s\"],\"armed\":\"%s\",\"decim\":%u,\"rate\":%" PRIu32 ",\"ch\":%u,"
+                     "\"stale\":%s,\"ring_bytes\":%" PRIu32 ",\"arms\":%" PRIu32 ",\"bytes\":%" PRIu64 ","
+                     "\"drops\":{\"count\":%" PRIu32 ",\"bytes\":%" PRIu64 "}}",
+                     s_point_str[0], s_point_str[1], s_point_str[2], s_point_str[3], pcm_tap_point_str(stats.point),
+                     stats.decim, stats.rate, stats.ch, stats.stale ? "true" : "false", stats.ring_bytes, stats.arms,
+                     stats.bytes, stats.drops, stats.dropped_bytes);
+    return (n < 0 || (size_t)n >= len) ? -1 : n;
+}
@@ -0,0 +1,149 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __PCM_TAP_H__
+#define __PCM_TAP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* log tag */
+#define PCM_TAP_TAG    "PCM_TAP"
+
+/* bytes of the WAV header in front of a tap stream */
+#define PCM_TAP_WAV_HDR_LEN    (44)
+
+/* largest decimation factor, a power of two */
+#define PCM_TAP_MAX_DECIM    (8)
+
+/* points in the audio path a copy can be taken from, keep in sync with s_point_str */
+typedef enum {
+    PCM_TAP_INPUT = 0,        /*!< decoded stream before the DSP, ch channels */
+    PCM_TAP_XOVER_MID,        /*!< mid band right after the crossover and its gain, ch channels */
+    PCM_TAP_XOVER_BASS,       /*!< bass band right after the crossover, before its gain when decimated */
+    PCM_TAP_LIMITER,          /*!< both ports after limiter, delay and routing: mid L, R, bass L, R */
+    PCM_TAP_NUM,
+} pcm_tap_point_t;
+
+/* what the armed tap produces */
+typedef struct {
+    uint32_t rate;            /*!< frames per second after decimation */
+    uint8_t  ch;              /*!< interleaved 16-bit channels per frame */
+} pcm_tap_format_t;
+
+/* tap activity since boot */
+typedef struct {
+    int      point;           /*!< pcm_tap_point_t armed, -1 if none */
+    uint8_t  decim;
+    uint32_t rate;            /*!< format of the armed tap */
+    uint8_t  ch;
+    bool     stale;           /*!< the stream changed format under the armed tap */
+    uint32_t ring_bytes;      /*!< ring held while armed, 0 otherwise */
+    uint32_t arms;            /*!< times a tap was armed */
+    uint64_t bytes;           /*!< PCM bytes put into the ring */
+    uint32_t drops;           /*!< blocks dropped because the ring was full */
+    uint64_t dropped_bytes;
+} pcm_tap_stats_t;
+
+/**
+ * @brief  arm one tap point; its ring is allocated here and only lives while armed
+ *
+ * @param [in]  point  tap point
+ * @param [in]  decim  1 for full rate, 2, 4 or PCM_TAP_MAX_DECIM to average that many frames into one
+ * @param [out] fmt    rate and channels of the PCM that will come out of pcm_tap_read
+ *
+ * @return  ESP_ERR_INVALID_STATE while another tap is armed, ESP_ERR_INVALID_ARG, ESP_ERR_NO_MEM
+ */
+esp_err_t pcm_tap_arm(pcm_tap_point_t point, uint8_t decim, pcm_tap_format_t *fmt);
+
+/**
+ * @brief  disarm, wait for the audio path to leave the ring and free it
+ */
+void pcm_tap_disarm(void);
+
+/**
+ * @brief  take PCM out of the ring, never waits
+ *
+ * @param [out] buf  output, whole frames only
+ * @param [in]  len  output size in byte
+ *
+ * @return  bytes copied, 0 if the ring is empty
+ */
+size_t pcm_tap_read(uint8_t *buf, size_t len);
+
+/**
+ * @brief  the stream changed format since the tap was armed, nothing more will arrive
+ */
+bool pcm_tap_stale(void);
+
+/**
+ * @brief  announce the format the outputs are about to run at, from the reclock
+ *
+ * @param [in] sample_rate  sample rate in Hz
+ * @param [in] ch_count     interleaved channels of the stream, 1 or 2
+ */
+void pcm_tap_set_format(uint32_t sample_rate, uint8_t ch_count);
+
+/**
+ * @brief  copy interleaved 16-bit samples of a point into the ring, if that point is armed
+ *
+ *         Audio path only. The copy is bounded by the block, and a block
+ *         that does not fit the ring is dropped whole: the audio never waits.
+ *
+ * @param [in] point    tap point, PCM_TAP_INPUT
+ * @param [in] in       samples, ch interleaved
+ * @param [in] samples  number of samples
+ */
+void pcm_tap_write(pcm_tap_point_t point, const int16_t *in, size_t samples);
+
+/**
+ * @brief  same for the 32-bit band chunks of the crossover, saturated to 16 bits
+ */
+void pcm_tap_write32(pcm_tap_point_t point, const int32_t *in, size_t samples);
+
+/**
+ * @brief  same for the two ports, PCM_TAP_LIMITER, interleaved into one frame
+ */
+void pcm_tap_write_ports(const int16_t *mid, const int16_t *bass, size_t samples);
+
+/**
+ * @brief  WAV header of a stream of unknown length, both sizes at their maximum
+ *
+ * @param [out] hdr  PCM_TAP_WAV_HDR_LEN bytes
+ * @param [in]  fmt  format returned by pcm_tap_arm
+ */
+void pcm_tap_wav_header(uint8_t *hdr, const pcm_tap_format_t *fmt);
+
+/**
+ * @brief  name of a tap point, "none" for anything else
+ */
+const char *pcm_tap_point_str(int point);
+
+/**
+ * @brief  tap point of a name
+ *
+ * @return  pcm_tap_point_t, -1 if unknown
+ */
+int pcm_tap_point_from_str(const char *str);
+
+/**
+ * @brief  get the tap counters
+ */
+void pcm_tap_get_stats(pcm_tap_stats_t *stats);
+
+/**
+ * @brief  serialise the tap points and counters as JSON
+ *
+ * @param [out] buf  output buffer
+ * @param [in]  len  output buffer size in byte
+ *
+ * @return  length of the JSON text, -1 if it does not fit
+ */
+int pcm_tap_to_json(char *buf, size_t len);
+
+#endif /* __PCM_TAP_H__ */
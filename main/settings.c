@@ -0,0 +1,277 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+#include "app_state.h"
+#include "audio_stall.h"
+#include "settings.h"
+
+#define SETTINGS_NVS_NAMESPACE    "settings"
+#define SETTINGS_WRITES_KEY       "writes"     /* lifetime value writes, part of every commit */
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* handler for flush task */
+static void settings_task_handler(void *arg);
+/* published state change, mirrors the persisted fields */
+static void settings_state_changed(uint32_t changed, const app_state_t *state);
+/* last chance on esp_restart */
+static void settings_shutdown(void);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const char *s_settings_key[SETTINGS_NUM] = {"volume", "preset", "routing"};
+
+/* RAM shadow, written under s_lock */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static int32_t s_value[SETTINGS_NUM];
+static int32_t s_stored[SETTINGS_NUM];            /* what NVS holds */
+static uint32_t s_has_value = 0;                  /* bit per setting, a value is known */
+static uint32_t s_has_stored = 0;                 /* bit per setting, NVS holds a value */
+static uint32_t s_dirty = 0;                      /* bit per setting, value differs from NVS */
+static settings_stats_t s_stats;
+
+static SemaphoreHandle_t s_flush_lock = NULL;     /* one flush at a time */
+static TaskHandle_t s_settings_task_handle = NULL;    /* handle of flush task */
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static void settings_task_handler(void *arg)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        /* every further change restarts the quiet period */
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_EXAMPLE_SETTINGS_QUIET_MS)) > 0) {
+        }
+        if (settings_flush() != ESP_OK) {
+            /* retry after another quiet period */
+            xTaskNotifyGive(s_settings_task_handle);
+        }
+    }
+}
+
+static void settings_state_changed(uint32_t changed, const app_state_t *state)
+{
+    if (changed & APP_STATE_F_VOLUME) {
+        settings_set(SETTINGS_VOLUME, state->volume);
+    }
+    if (changed & APP_STATE_F_MODE) {
+        settings_set(SETTINGS_PRESET, state->preset);
+    }
+}
+
+static void settings_shutdown(void)
+{
+    settings_flush();
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void settings_init(void)
+{
+    nvs_handle_t handle;
+
+    if (s_flush_lock != NULL) {
+        return;
+    }
+    s_flush_lock = xSemaphoreCreateMutex();
+
+    esp_err_t err = nvs_open(SETTINGS_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_OK) {
+        for (int i = 0; i < SETTINGS_NUM; i++) {
+            if (nvs_get_i32(handle, s_settings_key[i], &s_stored[i]) == ESP_OK) {
+                s_value[i] = s_stored[i];
+                s_has_stored |= 1 << i;
+                s_has_value |= 1 << i;
+            }
+        }
+        nvs_get_u32(handle, SETTINGS_WRITES_KEY, &s_stats.lifetime_writes);
+        nvs_close(handle);
+    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW(SETTINGS_TAG, "%s, nvs_open failed: %s", __func__, esp_err_to_name(err));
+    }
+    ESP_LOGI(SETTINGS_TAG, "%d of %d settings restored, %" PRIu32 " values written over lifetime",
+             __builtin_popcount(s_has_stored), SETTINGS_NUM, s_stats.lifetime_writes);
+
+    xTaskCreate(settings_task_handler, "SettingsTask", 3072, NULL, 1, &s_settings_task_handle);
+    esp_register_shutdown_handler(settings_shutdown);
+    app_state_register_cb(settings_state_changed);
+}
+
+bool settings_get(settings_id_t id, int32_t *value)
+{
+    bool found = false;
+
+    if (id >= SETTINGS_NUM) {
+        return false;
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (s_has_value & (1 << id)) {
+        *value = s_value[id];
+        found = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return found;
+}
+
+void settings_set(settings_id_t id, int32_t value)
+{
+    uint32_t bit = 1 << id;
+    bool wake = false;
+
+    if (id >= SETTINGS_NUM) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.sets++;
+    if ((s_has_value & bit) && s_value[id] == value) {
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    if (s_dirty & bit) {
+        s_stats.coalesced++;
+    }
+    s_value[id] = value;
+    s_has_value |= bit;
+    if ((s_has_stored & bit) && s_stored[id] == value) {
+        /* back to what flash holds, nothing to write */
+        s_dirty &= ~bit;
+    } else {
+        s_dirty |= bit;
+        wake = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (wake && s_settings_task_handle) {
+        xTaskNotifyGive(s_settings_task_handle);
+    }
+}
+
+esp_err_t settings_flush(void)
+{
+    int32_t value[SETTINGS_NUM];
+    uint32_t dirty;
+    uint32_t written = 0;
+    nvs_handle_t handle;
+
+    if (s_flush_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_flush_lock, portMAX_DELAY);
+    portENTER_CRITICAL(&s_lock);
+    dirty = s_dirty;
+    memcpy(value, s_value, sizeof(value));
+    portEXIT_CRITICAL(&s_lock);
+    if (dirty == 0) {
+        xSemaphoreGive(s_flush_lock);
+        return ESP_OK;
+    }
+
+    /* all pending keys go into one commit */
+    audio_stall_flash_begin();
+    esp_err_t err = nvs_open(SETTINGS_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        for (int i = 0; i < SETTINGS_NUM && err == ESP_OK; i++) {
+            if (dirty & (1 << i)) {
+                err = nvs_set_i32(handle, s_settings_key[i], value[i]);
+                written++;
+            }
+        }
+        if (err == ESP_OK) {
+            err = nvs_set_u32(handle, SETTINGS_WRITES_KEY, s_stats.lifetime_writes + written + 1);
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    audio_stall_flash_end();
+
+    portENTER_CRITICAL(&s_lock);
+    if (err == ESP_OK) {
+        for (int i = 0; i < SETTINGS_NUM; i++) {
+            if (dirty & (1 << i)) {
+                s_stored[i] = value[i];
+                s_has_stored |= 1 << i;
+                /* a change that came in meanwhile stays pending */
+                if (s_value[i] == value[i]) {
+                    s_dirty &= ~(1 << i);
+                }
+            }
+        }
+        s_stats.flushes++;
+        s_stats.key_writes += written + 1;
+        s_stats.lifetime_writes += written + 1;
+    } else {
+        s_stats.failures++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    xSemaphoreGive(s_flush_lock);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(SETTINGS_TAG, "%s, %s", __func__, esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(SETTINGS_TAG, "%" PRIu32 " settings written in one commit", written);
+    return ESP_OK;
+}
+
+void settings_get_stats(settings_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+int settings_to_json(char *buf, size_t len)
+{
+    int32_t value[SETTINGS_NUM];
+    uint32_t has_value;
+    uint32_t dirty;
+    settings_stats_t stats;
+    int n = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    memcpy(value, s_value, sizeof(value));
+    has_value = s_has_value;
+    dirty = s_dirty;
+    stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+
+    n += snprintf(buf + n, len - n, "{");
+    for (int i = 0; i < SETTINGS_NUM && n < (int)len; i++) {
+        if (has_value & (1 << i)) {
+            n += snprintf(buf + n, len - n, "\"%s\":{\"value\":%" PRId32 ",\"pending\":%s},",
+                          s_settings_key[i], value[i], (dirty & (1 << i)) ? "true" : "false");
+        }
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, "\"sets\":%" PRIu32 ",\"coalesced\":%" PRIu32 ",\"flushes\":%" PRIu32
+                      ",\"key_writes\":%" PRIu32 ",\"failures\":%" PRIu32 ",\"lifetime_writes\":%" PRIu32 "}",
+                      stats.sets, stats.coalesced, stats.flushes, stats.key_writes, stats.failures,
+                      stats.lifetime_writes);
+    }
+    return (n < (int)len) ? n : -1;
+}
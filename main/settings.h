@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __SETTINGS_H__
+#define __SETTINGS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* log tag */
+#define SETTINGS_TAG    "SETTINGS"
+
+/* persisted settings, keep in sync with s_settings_key */
+typedef enum {
+    SETTINGS_VOLUME = 0,     /*!< AVRCP volume 0 ~ 127 */
+    SETTINGS_PRESET,         /*!< audio_preset_id_t */
+    SETTINGS_ROUTING,        /*!< audio_dsp_routing_pack of the wiring */
+    SETTINGS_NUM,
+} settings_id_t;
+
+/* flash wear counters */
+typedef struct {
+    uint32_t sets;           /*!< changes handed to settings_set */
+    uint32_t coalesced;      /*!< changes that replaced a value still waiting to be written */
+    uint32_t flushes;        /*!< NVS commits since boot */
+    uint32_t key_writes;     /*!< NVS values written since boot */
+    uint32_t failures;       /*!< flushes that failed and will be retried */
+    uint32_t lifetime_writes;/*!< NVS values written over the life of the device */
+} settings_stats_t;
+
+/**
+ * @brief  load the stored settings into RAM and start the flush task
+ *
+ *         Call once after nvs_flash_init. Changes of volume and preset in
+ *         app_state are picked up from then on.
+ */
+void settings_init(void);
+
+/**
+ * @brief  stored value of a setting
+ *
+ * @param [in]  id     setting
+ * @param [out] value  value, left untouched if the setting was never stored
+ *
+ * @return  true if a value was stored
+ */
+bool settings_get(settings_id_t id, int32_t *value);
+
+/**
+ * @brief  change a setting in RAM
+ *
+ *         Never blocks and never touches flash. The value is written together
+ *         with every other pending change once no change came in for the quiet
+ *         period; setting the stored value again cancels a pending write.
+ */
+void settings_set(settings_id_t id, int32_t value);
+
+/**
+ * @brief  write every pending change now, in one NVS commit
+ *
+ * @return  ESP_OK, also when nothing was pending, or the NVS error
+ */
+esp_err_t settings_flush(void);
+
+/**
+ * @brief  flash wear counters
+ */
+void settings_get_stats(settings_stats_t *stats);
+
+/**
+ * @brief  serialise values, pending changes and wear counters as JSON
+ *
+ * @return  length written, -1 if buf is too small
+ */
+int settings_to_json(char *buf, size_t len);
+
+#endif /* __SETTINGS_H__ */
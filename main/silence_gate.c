@@ -0,0 +1,75 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "silence_gate.h"
+
+/* default stream rate until the codec is configured (44.1 kHz stereo) */
+#define SILENCE_GATE_DEFAULT_RATE    (44100 * 2)
+
+void silence_gate_init(silence_gate_t *gate, int32_t threshold, uint32_t timeout_ms)
+{
+    gate->threshold = threshold;
+    gate->timeout_ms = timeout_ms;
+    silence_gate_set_rate(gate, SILENCE_GATE_DEFAULT_RATE);
+    silence_gate_reset(gate);
+}
+
+void silence_gate_set_rate(silence_gate_t *gate, uint32_t samples_per_sec)
+{
+    gate->timeout_samples = (uint32_t)(((uint64_t)gate->timeout_ms * samples_per_sec) / 1000);
+}
+
+void silence_gate_reset(silence_gate_t *gate)
+{
+    gate->silent_samples = 0;
+    gate->state = SILENCE_GATE_OPEN;
+}
+
+int32_t silence_gate_peak(const int16_t *samples, size_t count)
+{
+    int32_t peak = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int32_t a = samples[i];
+        a = (a < 0) ? -a : a;
+        if (a > peak) {
+            peak = a;
+        }
+    }
+    return peak;
+}
+
+silence_gate_action_t silence_gate_update(silence_gate_t *gate, int32_t peak, size_t samples)
+{
+    if (gate->timeout_ms == 0) {
+        return SILENCE_GATE_ACT_NONE;
+    }
+
+    if (peak > gate->threshold) {
+        gate->silent_samples = 0;
+        if (gate->state == SILENCE_GATE_CLOSED) {
+            gate->state = SILENCE_GATE_OPEN;
+            return SILENCE_GATE_ACT_OPEN;
+        }
+        return SILENCE_GATE_ACT_NONE;
+    }
+
+    if (gate->state == SILENCE_GATE_CLOSED) {
+        return SILENCE_GATE_ACT_NONE;
+    }
+
+    /* saturate instead of wrapping during very long pauses */
+    if (gate->silent_samples < UINT32_MAX - samples) {
+        gate->silent_samples += samples;
+    }
+    if (gate->silent_samples >= gate->timeout_samples) {
+        gate->state = SILENCE_GATE_CLOSED;
+        return SILENCE_GATE_ACT_CLOSE;
+    }
+    return SILENCE_GATE_ACT_NONE;
+}
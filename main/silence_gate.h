@@ -0,0 +1,83 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __SILENCE_GATE_H__
+#define __SILENCE_GATE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* log tag */
+#define SILENCE_GATE_TAG    "SILENCE_GATE"
+
+/* state of the output gate */
+typedef enum {
+    SILENCE_GATE_OPEN = 0,      /*!< outputs powered, audio is being played */
+    SILENCE_GATE_CLOSED,        /*!< amplifiers and I2S clocks are gated off */
+} silence_gate_state_t;
+
+/* what the caller has to do with the outputs after a block was checked */
+typedef enum {
+    SILENCE_GATE_ACT_NONE = 0,  /*!< keep the outputs as they are */
+    SILENCE_GATE_ACT_CLOSE,     /*!< timeout elapsed: ramp this block to mute and gate the outputs */
+    SILENCE_GATE_ACT_OPEN,      /*!< signal returned: power the outputs up again */
+} silence_gate_action_t;
+
+typedef struct {
+    int32_t              threshold;        /*!< peak at or below this value counts as silence */
+    uint32_t             timeout_ms;       /*!< silence needed before the outputs are gated, 0 disables the gate */
+    uint32_t             timeout_samples;  /*!< timeout_ms converted at the current stream rate */
+    uint32_t             silent_samples;   /*!< samples of continuous silence seen so far */
+    silence_gate_state_t state;
+} silence_gate_t;
+
+/**
+ * @brief  initialize a silence gate in the open state
+ *
+ * @param [out] gate        gate to initialize
+ * @param [in]  threshold   absolute 16-bit peak treated as silence
+ * @param [in]  timeout_ms  continuous silence before gating, 0 disables the gate
+ */
+void silence_gate_init(silence_gate_t *gate, int32_t threshold, uint32_t timeout_ms);
+
+/**
+ * @brief  update the timeout for a new stream format
+ *
+ * @param [in] gate            gate to update
+ * @param [in] samples_per_sec sample rate multiplied by channel count
+ */
+void silence_gate_set_rate(silence_gate_t *gate, uint32_t samples_per_sec);
+
+/**
+ * @brief  force the gate back to the open state and restart the silence timer
+ *
+ * @param [in] gate  gate to reset
+ */
+void silence_gate_reset(silence_gate_t *gate);
+
+/**
+ * @brief  absolute peak of a block of interleaved 16-bit samples
+ *
+ * @param [in] samples  sample buffer
+ * @param [in] count    number of samples
+ *
+ * @return  peak value in the range 0..32768
+ */
+int32_t silence_gate_peak(const int16_t *samples, size_t count);
+
+/**
+ * @brief  feed the peak of one block into the gate
+ *
+ * @param [in] gate     gate to update
+ * @param [in] peak     absolute peak of the block
+ * @param [in] samples  number of samples in the block
+ *
+ * @return  action the caller has to apply to the outputs
+ */
+silence_gate_action_t silence_gate_update(silence_gate_t *gate, int32_t peak, size_t samples);
+
+#endif /* __SILENCE_GATE_H__ */
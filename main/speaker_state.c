@@ -0,0 +1,245 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_avrc_api.h"
+#include "bt_app_core.h"
+#include "audio_dsp.h"
+#include "audio_preset.h"
+#include "app_state.h"
+#include "json_writer.h"
+#include "speaker_state.h"
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* copy metadata text, cutting at a UTF-8 character boundary */
+static void speaker_state_copy_text(char *dst, size_t dst_len, const uint8_t *text, int len);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static portMUX_TYPE s_track_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_track_seq = 0;
+static char s_title[SPEAKER_STATE_TITLE_LEN];
+static char s_artist[SPEAKER_STATE_ARTIST_LEN];
+static char s_album[SPEAKER_STATE_ALBUM_LEN];
+static const char *s_buffer_mode_str[] = {"processing", "prefetching", "dropping"};
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static void speaker_state_copy_text(char *dst, size_t dst_len, const uint8_t *text, int len)
+{
+    size_t n = (len > 0) ? (size_t)len : 0;
+
+    if (n >= dst_len) {
+        n = dst_len - 1;
+        /* step back over continuation bytes so no character is split */
+        while (n > 0 && (text[n] & 0xc0) == 0x80) {
+            n--;
+        }
+    }
+    memcpy(dst, text, n);
+    dst[n] = '\0';
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void speaker_state_set_track(uint8_t attr_id, const uint8_t *text, int len)
+{
+    portENTER_CRITICAL(&s_track_lock);
+    switch (attr_id) {
+    case ESP_AVRC_MD_ATTR_TITLE:
+        speaker_state_copy_text(s_title, sizeof(s_title), text, len);
+        break;
+    case ESP_AVRC_MD_ATTR_ARTIST:
+        speaker_state_copy_text(s_artist, sizeof(s_artist), text, len);
+        break;
+    case ESP_AVRC_MD_ATTR_ALBUM:
+        speaker_state_copy_text(s_album, sizeof(s_album), text, len);
+        break;
+    default:
+        portEXIT_CRITICAL(&s_track_lock);
+        return;
+    }
+    s_track_seq++;
+    portEXIT_CRITICAL(&s_track_lock);
+}
+
+void speaker_state_clear_track(void)
+{
+    portENTER_CRITICAL(&s_track_lock);
+    s_title[0] = '\0';
+    s_artist[0] = '\0';
+    s_album[0] = '\0';
+    s_track_seq++;
+    portEXIT_CRITICAL(&s_track_lock);
+}
+
+void speaker_state_snapshot(speaker_state_t *state)
+{
+    bt_i2s_buffer_stats_t stats;
+    app_state_t app;
+
+    app_state_read(&app);
+    state->system_on = app.system_on;
+    state->party_mode = app.party_mode;
+    state->preset = app.preset;
+    state->is_playing = app.is_playing;
+    state->volume = app.volume;
+
+    portENTER_CRITICAL(&s_track_lock);
+    state->track_seq = s_track_seq;
+    memcpy(state->title, s_title, sizeof(state->title));
+    memcpy(state->artist, s_artist, sizeof(state->artist));
+    memcpy(state->album, s_album, sizeof(state->album));
+    portEXIT_CRITICAL(&s_track_lock);
+
+    bt_i2s_get_buffer_stats(&stats);
+    state->stream_active = stats.active;
+    state->buffer_level = (stats.capacity > 0) ? (uint8_t)(stats.filled * 100 / stats.capacity) : 0;
+    state->buffer_mode = stats.mode;
+    state->underflows = stats.underflows;
+    state->drops = stats.drops;
+
+    audio_dsp_limiter_meter(&state->limiter_bass, &state->limiter_mid);
+}
+
+uint32_t speaker_state_diff(const speaker_state_t *old_state, const speaker_state_t *new_state)
+{
+    uint32_t fields = 0;
+    int level_delta = (int)new_state->buffer_level - (int)old_state->buffer_level;
+    int bass_delta = (int)new_state->limiter_bass - (int)old_state->limiter_bass;
+    int mid_delta = (int)new_state->limiter_mid - (int)old_state->limiter_mid;
+
+    if (old_state->system_on != new_state->system_on) {
+        fields |= SPEAKER_STATE_F_POWER;
+    }
+    if (old_state->party_mode != new_state->party_mode || old_state->preset != new_state->preset) {
+        fields |= SPEAKER_STATE_F_MODE;
+    }
+    if (old_state->volume != new_state->volume) {
+        fields |= SPEAKER_STATE_F_VOLUME;
+    }
+    if (old_state->is_playing != new_state->is_playing) {
+        fields |= SPEAKER_STATE_F_PLAY;
+    }
+    if (old_state->track_seq != new_state->track_seq) {
+        fields |= SPEAKER_STATE_F_TRACK;
+    }
+    if (old_state->stream_active != new_state->stream_active ||
+        old_state->buffer_mode != new_state->buffer_mode ||
+        old_state->underflows != new_state->underflows ||
+        old_state->drops != new_state->drops ||
+        level_delta >= SPEAKER_STATE_BUFFER_STEP || level_delta <= -SPEAKER_STATE_BUFFER_STEP) {
+        fields |= SPEAKER_STATE_F_BUFFER;
+    }
+    /* report the return to zero even when it is a small step */
+    if (bass_delta >= SPEAKER_STATE_LIMITER_STEP || bass_delta <= -SPEAKER_STATE_LIMITER_STEP ||
+        mid_delta >= SPEAKER_STATE_LIMITER_STEP || mid_delta <= -SPEAKER_STATE_LIMITER_STEP ||
+        (old_state->limiter_bass != new_state->limiter_bass && new_state->limiter_bass == 0) ||
+        (old_state->limiter_mid != new_state->limiter_mid && new_state->limiter_mid == 0)) {
+        fields |= SPEAKER_STATE_F_LIMITER;
+    }
+    return fields;
+}
+
+void speaker_state_merge(speaker_state_t *dst, const speaker_state_t *src, uint32_t fields)
+{
+    if (fields & SPEAKER_STATE_F_POWER) {
+        dst->system_on = src->system_on;
+    }
+    if (fields & SPEAKER_STATE_F_MODE) {
+        dst->party_mode = src->party_mode;
+        dst->preset = src->preset;
+    }
+    if (fields & SPEAKER_STATE_F_VOLUME) {
+        dst->volume = src->volume;
+    }
+    if (fields & SPEAKER_STATE_F_PLAY) {
+        dst->is_playing = src->is_playing;
+    }
+    if (fields & SPEAKER_STATE_F_TRACK) {
+        dst->track_seq = src->track_seq;
+        memcpy(dst->title, src->title, sizeof(dst->title));
+        memcpy(dst->artist, src->artist, sizeof(dst->artist));
+        memcpy(dst->album, src->album, sizeof(dst->album));
+    }
+    if (fields & SPEAKER_STATE_F_BUFFER) {
+        dst->stream_active = src->stream_active;
+        dst->buffer_level = src->buffer_level;
+        dst->buffer_mode = src->buffer_mode;
+        dst->underflows = src->underflows;
+        dst->drops = src->drops;
+    }
+    if (fields & SPEAKER_STATE_F_LIMITER) {
+        dst->limiter_bass = src->limiter_bass;
+        dst->limiter_mid = src->limiter_mid;
+    }
+}
+
+int speaker_state_to_json(const speaker_state_t *state, uint32_t fields, char *buf, size_t len)
+{
+    json_writer_t w;
+    const char *sep = "";
+
+    json_writer_init(&w, buf, len);
+
+    json_writer_printf(&w, "{");
+    if (fields & SPEAKER_STATE_F_POWER) {
+        json_writer_printf(&w, "%s\"power\":%s", sep, state->system_on ? "true" : "false");
+        sep = ",";
+    }
+    if (fields & SPEAKER_STATE_F_MODE) {
+        json_writer_printf(&w, "%s\"mode\":\"%s\",\"preset\":\"%s\"", sep, state->party_mode ? "party" : "home",
+                           audio_preset_name(state->preset));
+        sep = ",";
+    }
+    if (fields & SPEAKER_STATE_F_VOLUME) {
+        json_writer_printf(&w, "%s\"volume\":%u", sep, state->volume);
+        sep = ",";
+    }
+    if (fields & SPEAKER_STATE_F_PLAY) {
+        json_writer_printf(&w, "%s\"playing\":%s", sep, state->is_playing ? "true" : "false");
+        sep = ",";
+    }
+    if (fields & SPEAKER_STATE_F_TRACK) {
+        json_writer_printf(&w, "%s\"track\":{\"title\":", sep);
+        json_writer_string(&w, state->title);
+        json_writer_printf(&w, ",\"artist\":");
+        json_writer_string(&w, state->artist);
+        json_writer_printf(&w, ",\"album\":");
+        json_writer_string(&w, state->album);
+        json_writer_printf(&w, "}");
+        sep = ",";
+    }
+    if (fields & SPEAKER_STATE_F_BUFFER) {
+        const char *mode = (state->buffer_mode < 3) ? s_buffer_mode_str[state->buffer_mode] : "unknown";
+        json_writer_printf(&w, "%s\"buffer\":{\"active\":%s,\"level\":%u,\"mode\":\"%s\",\"underflows\":%" PRIu32 ",\"drops\":%" PRIu32 "}",
+                           sep, state->stream_active ? "true" : "false", state->buffer_level, mode,
+                           state->underflows, state->drops);
+        sep = ",";
+    }
+    if (fields & SPEAKER_STATE_F_LIMITER) {
+        json_writer_printf(&w, "%s\"limiter\":{\"bass\":%u.%u,\"mid\":%u.%u}", sep,
+                           state->limiter_bass / 10, state->limiter_bass % 10,
+                           state->limiter_mid / 10, state->limiter_mid % 10);
+    }
+    json_writer_printf(&w, "}");
+
+    return json_writer_result(&w);
+}
@@ -0,0 +1,114 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __SPEAKER_STATE_H__
+#define __SPEAKER_STATE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* log tag */
+#define SPEAKER_STATE_TAG    "SPK_STATE"
+
+/* track metadata field sizes, including the terminating zero */
+#define SPEAKER_STATE_TITLE_LEN     (64)
+#define SPEAKER_STATE_ARTIST_LEN    (48)
+#define SPEAKER_STATE_ALBUM_LEN     (48)
+
+/* buffer level change in percent that is worth reporting */
+#define SPEAKER_STATE_BUFFER_STEP   (10)
+
+/* limiter gain reduction change in 0.1 dB that is worth reporting */
+#define SPEAKER_STATE_LIMITER_STEP  (10)
+
+/* field groups, used as change mask and as serialisation filter */
+#define SPEAKER_STATE_F_POWER     (1 << 0)
+#define SPEAKER_STATE_F_MODE      (1 << 1)
+#define SPEAKER_STATE_F_VOLUME    (1 << 2)
+#define SPEAKER_STATE_F_PLAY      (1 << 3)
+#define SPEAKER_STATE_F_TRACK     (1 << 4)
+#define SPEAKER_STATE_F_BUFFER    (1 << 5)
+#define SPEAKER_STATE_F_LIMITER   (1 << 6)
+#define SPEAKER_STATE_F_ALL       (0x7f)
+
+/* point-in-time copy of everything a remote client can observe */
+typedef struct {
+    bool     system_on;
+    bool     party_mode;
+    uint8_t  preset;                             /*!< audio_preset_id_t */
+    bool     is_playing;
+    uint8_t  volume;                             /*!< AVRCP volume 0 ~ 127 */
+    uint32_t track_seq;                          /*!< bumped on every metadata update */
+    char     title[SPEAKER_STATE_TITLE_LEN];
+    char     artist[SPEAKER_STATE_ARTIST_LEN];
+    char     album[SPEAKER_STATE_ALBUM_LEN];
+    bool     stream_active;                      /*!< an A2DP source is connected */
+    uint8_t  buffer_level;                       /*!< ringbuffer fill in percent */
+    uint8_t  buffer_mode;                        /*!< RINGBUFFER_MODE_* */
+    uint32_t underflows;
+    uint32_t drops;
+    uint16_t limiter_bass;                       /*!< bass limiter gain reduction in 0.1 dB */
+    uint16_t limiter_mid;                        /*!< mid limiter gain reduction in 0.1 dB */
+} speaker_state_t;
+
+/**
+ * @brief  store one AVRCP metadata attribute of the current track
+ *
+ * @param [in] attr_id  ESP_AVRC_MD_ATTR_* of the attribute
+ * @param [in] text     UTF-8 text, not necessarily zero terminated
+ * @param [in] len      text length in byte
+ */
+void speaker_state_set_track(uint8_t attr_id, const uint8_t *text, int len);
+
+/**
+ * @brief  forget the metadata of the current track
+ */
+void speaker_state_clear_track(void);
+
+/**
+ * @brief  take a consistent copy of the current state
+ *
+ * @param [out] state  snapshot
+ */
+void speaker_state_snapshot(speaker_state_t *state);
+
+/**
+ * @brief  compare two snapshots
+ *
+ *         Buffer level only counts as changed once it moved by
+ *         SPEAKER_STATE_BUFFER_STEP, the counters and mode on any change.
+ *         Limiter gain reduction likewise needs SPEAKER_STATE_LIMITER_STEP.
+ *
+ * @param [in] old_state  snapshot the client has seen
+ * @param [in] new_state  current snapshot
+ *
+ * @return  mask of SPEAKER_STATE_F_* groups that differ
+ */
+uint32_t speaker_state_diff(const speaker_state_t *old_state, const speaker_state_t *new_state);
+
+/**
+ * @brief  copy the selected field groups from one snapshot to another
+ *
+ * @param [out] dst     snapshot to update
+ * @param [in]  src     source snapshot
+ * @param [in]  fields  mask of SPEAKER_STATE_F_* groups
+ */
+void speaker_state_merge(speaker_state_t *dst, const speaker_state_t *src, uint32_t fields);
+
+/**
+ * @brief  serialise the selected field groups as one JSON object
+ *
+ * @param [in]  state   snapshot
+ * @param [in]  fields  mask of SPEAKER_STATE_F_* groups
+ * @param [out] buf     output buffer
+ * @param [in]  len     output buffer size in byte
+ *
+ * @return  length of the JSON text, -1 if it does not fit
+ */
+int speaker_state_to_json(const speaker_state_t *state, uint32_t fields, char *buf, size_t len);
+
+#endif /* __SPEAKER_STATE_H__ */
@@ -0,0 +1,177 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "trace.h"
+
+#define TRACE_RING_MASK          (TRACE_RING_LEN - 1)
+#define TRACE_DRAIN_PERIOD_MS    (200)
+#define TRACE_DRAIN_BATCH        (16)
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* print a run of identical events as one line */
+static void trace_log_run(const trace_rec_t *rec, uint32_t count);
+/* handler for trace drain task */
+static void trace_task_handler(void *arg);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const char *s_trace_ev_str[] = {"none", "rb_drop", "rb_overflow", "rb_drained", "rb_prefetched",
+                                       "rb_underflow", "out_rearm", "volume_step"};
+
+static trace_rec_t s_ring[TRACE_RING_LEN];
+static uint32_t s_head = 0;                        /* index of the next record to be claimed */
+static TaskHandle_t s_trace_task_handle = NULL;    /* handle of trace drain task */
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static void trace_log_run(const trace_rec_t *rec, uint32_t count)
+{
+    char line[80];
+
+    trace_format(rec, line, sizeof(line));
+    if (count > 1) {
+        ESP_LOGI(TRACE_TAG, "%s (x%" PRIu32 ")", line, count);
+    } else {
+        ESP_LOGI(TRACE_TAG, "%s", line);
+    }
+}
+
+static void trace_task_handler(void *arg)
+{
+    trace_rec_t batch[TRACE_DRAIN_BATCH];
+    trace_rec_t last;
+    uint32_t run = 0;
+    uint32_t cursor = trace_oldest();
+    uint32_t lost = 0;
+
+    for (;;) {
+        size_t n = trace_read(&cursor, batch, TRACE_DRAIN_BATCH, &lost);
+        if (lost > 0) {
+            ESP_LOGW(TRACE_TAG, "%" PRIu32 " records overwritten before printing", lost);
+        }
+        /* collapse bursts, e.g. one line per run of dropped packets */
+        for (size_t i = 0; i < n; i++) {
+            if (run > 0 && batch[i].id == last.id) {
+                run++;
+                last = batch[i];
+                continue;
+            }
+            if (run > 0) {
+                trace_log_run(&last, run);
+            }
+            last = batch[i];
+            run = 1;
+        }
+        if (n < TRACE_DRAIN_BATCH) {
+            if (run > 0) {
+                trace_log_run(&last, run);
+                run = 0;
+            }
+            vTaskDelay(pdMS_TO_TICKS(TRACE_DRAIN_PERIOD_MS));
+        }
+    }
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void trace_emit(uint16_t id, uint32_t a0, uint32_t a1)
+{
+    uint32_t idx = __atomic_fetch_add(&s_head, 1, __ATOMIC_RELAXED);
+    trace_rec_t *rec = &s_ring[idx & TRACE_RING_MASK];
+
+    /* readers skip the slot until the final sequence number is stored */
+    __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    rec->ts_us = (uint32_t)esp_timer_get_time();
+    rec->id = id;
+    rec->core = (uint16_t)esp_cpu_get_core_id();
+    rec->a0 = a0;
+    rec->a1 = a1;
+    __atomic_store_n(&rec->seq, idx + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t trace_oldest(void)
+{
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+
+    return (head > TRACE_RING_LEN) ? head - TRACE_RING_LEN : 0;
+}
+
+size_t trace_read(uint32_t *cursor, trace_rec_t *out, size_t max, uint32_t *lost)
+{
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    uint32_t skipped = 0;
+    size_t n = 0;
+
+    if (head - *cursor > TRACE_RING_LEN) {
+        skipped = head - *cursor - TRACE_RING_LEN;
+        *cursor = head - TRACE_RING_LEN;
+    }
+    while (n < max && *cursor != head) {
+        const trace_rec_t *rec = &s_ring[*cursor & TRACE_RING_MASK];
+        uint32_t seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+
+        if (seq == *cursor + 1) {
+            out[n] = *rec;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) == seq) {
+                n++;
+                (*cursor)++;
+                continue;
+            }
+            seq = 0;
+        }
+        if (seq == 0 || (int32_t)(seq - (*cursor + 1)) < 0) {
+            /* still being written, pick it up next time */
+            break;
+        }
+        /* a writer lapped the reader */
+        skipped++;
+        (*cursor)++;
+    }
+    if (lost) {
+        *lost = skipped;
+    }
+    return n;
+}
+
+int trace_format(const trace_rec_t *rec, char *buf, size_t len)
+{
+    const char *name = (rec->id < TRACE_EV_MAX) ? s_trace_ev_str[rec->id] : "?";
+
+    return snprintf(buf, len, "%10" PRIu32 " us cpu%u %-13s %" PRIu32 " %" PRId32,
+                    rec->ts_us, rec->core, name, rec->a0, (int32_t)rec->a1);
+}
+
+void trace_start(void)
+{
+#if CONFIG_EXAMPLE_TRACE_LOG
+    if (s_trace_task_handle == NULL) {
+        xTaskCreate(trace_task_handler, "TraceTask", 3072, NULL, 1, &s_trace_task_handle);
+    }
+#else
+    (void)trace_task_handler;
+    (void)s_trace_task_handle;
+#endif
+}
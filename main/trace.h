@@ -0,0 +1,92 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+/* log tag */
+#define TRACE_TAG    "TRACE"
+
+/* records kept in the ring, power of two */
+#define TRACE_RING_LEN    (256)
+
+/* trace events, keep in sync with s_trace_ev_str */
+typedef enum {
+    TRACE_EV_NONE = 0,
+    TRACE_EV_RB_DROP,          /*!< a0: packet size, a1: ringbuffer fill */
+    TRACE_EV_RB_OVERFLOW,      /*!< a0: packet size, a1: ringbuffer fill; entering DROPPING */
+    TRACE_EV_RB_DRAINED,       /*!< a1: ringbuffer fill; DROPPING -> PROCESSING */
+    TRACE_EV_RB_PREFETCHED,    /*!< a1: ringbuffer fill; PREFETCHING -> PROCESSING */
+    TRACE_EV_RB_UNDERFLOW,     /*!< a0: underflows since boot */
+    TRACE_EV_OUT_REARM,        /*!< a0: wake block size; silence gate opened */
+    TRACE_EV_VOLUME_STEP,      /*!< a0: new volume, a1: signed delta */
+    TRACE_EV_MAX,
+} trace_ev_t;
+
+/* one fixed size trace record */
+typedef struct {
+    uint32_t seq;      /*!< index + 1 of the record, written last, 0 while being written */
+    uint32_t ts_us;    /*!< esp_timer time, wraps after ~71 minutes */
+    uint16_t id;       /*!< trace_ev_t */
+    uint16_t core;     /*!< CPU that emitted it */
+    uint32_t a0;
+    uint32_t a1;
+} trace_rec_t;
+
+#if CONFIG_EXAMPLE_TRACE_ENABLE
+#define TRACE(id, a0, a1)    trace_emit((id), (uint32_t)(a0), (uint32_t)(a1))
+#else
+#define TRACE(id, a0, a1)    do { } while (0)
+#endif
+
+/**
+ * @brief  append a record, lock free and safe from any task, core or ISR
+ *
+ *         The oldest record is overwritten when the ring is full.
+ *
+ * @param [in] id  trace_ev_t
+ * @param [in] a0  first argument
+ * @param [in] a1  second argument
+ */
+void trace_emit(uint16_t id, uint32_t a0, uint32_t a1);
+
+/**
+ * @brief  cursor positioned at the oldest record still in the ring
+ */
+uint32_t trace_oldest(void);
+
+/**
+ * @brief  copy records starting at a cursor
+ *
+ *         Records overwritten before they were read are skipped and counted.
+ *
+ * @param [inout] cursor  read position, advanced past the copied records
+ * @param [out]   out     record buffer
+ * @param [in]    max     number of records that fit in out
+ * @param [out]   lost    records skipped because they were overwritten, may be NULL
+ *
+ * @return  number of records copied
+ */
+size_t trace_read(uint32_t *cursor, trace_rec_t *out, size_t max, uint32_t *lost);
+
+/**
+ * @brief  format one record as a line of text without trailing newline
+ *
+ * @return  length of the text as snprintf
+ */
+int trace_format(const trace_rec_t *rec, char *buf, size_t len);
+
+/**
+ * @brief  start the low priority task printing trace records on the console
+ */
+void trace_start(void);
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,169 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "driver/pulse_cnt.h"
+#include "volume_encoder.h"
+
+/* counts of the x4 quadrature decoder that make up one volume detent */
+#define ENCODER_COUNTS_PER_DETENT    CONFIG_EXAMPLE_ENCODER_COUNTS_PER_DETENT
+/* longest glitch the PCNT input filter can reject on ESP32 is 1023 APB cycles */
+#define ENCODER_GLITCH_NS            10000
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* watch point reached, runs in ISR context */
+static bool volume_encoder_on_reach(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *edata, void *user_ctx);
+/* handler for encoder task */
+static void volume_encoder_task(void *arg);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static pcnt_unit_handle_t s_pcnt_unit = NULL;       /* handle of pulse counter unit */
+static QueueHandle_t s_encoder_evt_queue = NULL;    /* watch point events from ISR */
+static TaskHandle_t s_encoder_task_handle = NULL;   /* handle of encoder task */
+static volume_encoder_cb_t s_encoder_cb = NULL;
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static bool volume_encoder_on_reach(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *edata, void *user_ctx)
+{
+    BaseType_t high_task_wakeup = pdFALSE;
+    int watch_point = edata->watch_point_value;
+
+    xQueueSendFromISR((QueueHandle_t)user_ctx, &watch_point, &high_task_wakeup);
+    return (high_task_wakeup == pdTRUE);
+}
+
+static void volume_encoder_task(void *arg)
+{
+    int watch_point = 0;
+    int count = 0;
+    int last_count = 0;
+    int64_t last_ms = esp_timer_get_time() / 1000;
+
+    for (;;) {
+        /* sleep until the counter crosses a detent */
+        if (xQueueReceive(s_encoder_evt_queue, &watch_point, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        /* a fast spin may have queued several detents, fold them into one update */
+        while (xQueueReceive(s_encoder_evt_queue, &watch_point, 0) == pdTRUE) {
+        }
+
+        if (pcnt_unit_get_count(s_pcnt_unit, &count) != ESP_OK) {
+            continue;
+        }
+        int detents = (count - last_count) / ENCODER_COUNTS_PER_DETENT;
+        if (detents == 0) {
+            continue;
+        }
+        last_count += detents * ENCODER_COUNTS_PER_DETENT;
+
+        int64_t now = esp_timer_get_time() / 1000;
+        int step = volume_encoder_step((now - last_ms) / abs(detents));
+        last_ms = now;
+
+        if (s_encoder_cb) {
+            s_encoder_cb(detents * step);
+        }
+    }
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+int volume_encoder_step(int64_t interval_ms)
+{
+    if (interval_ms < 50) {
+        return 5;
+    } else if (interval_ms < 120) {
+        return 3;
+    } else if (interval_ms < 300) {
+        return 2;
+    }
+    return 1;
+}
+
+bool volume_encoder_start(int pin_a, int pin_b, volume_encoder_cb_t cb)
+{
+    if (s_pcnt_unit != NULL) {
+        return true;
+    }
+    s_encoder_cb = cb;
+
+    /* the unit wraps to zero at each detent, accum_count keeps the running total */
+    pcnt_unit_config_t unit_cfg = {
+        .high_limit = ENCODER_COUNTS_PER_DETENT,
+        .low_limit = -ENCODER_COUNTS_PER_DETENT,
+        .flags.accum_count = true,
+    };
+    if (pcnt_new_unit(&unit_cfg, &s_pcnt_unit) != ESP_OK) {
+        ESP_LOGE(VOLUME_ENCODER_TAG, "%s, pcnt unit create failed", __func__);
+        return false;
+    }
+
+    pcnt_glitch_filter_config_t filter_cfg = {
+        .max_glitch_ns = ENCODER_GLITCH_NS,
+    };
+    ESP_ERROR_CHECK(pcnt_unit_set_glitch_filter(s_pcnt_unit, &filter_cfg));
+
+    /* x4 decoding: each channel counts both edges of one pin, direction from the other */
+    pcnt_chan_config_t chan_a_cfg = {
+        .edge_gpio_num = pin_a,
+        .level_gpio_num = pin_b,
+    };
+    pcnt_chan_config_t chan_b_cfg = {
+        .edge_gpio_num = pin_b,
+        .level_gpio_num = pin_a,
+    };
+    pcnt_channel_handle_t chan_a = NULL;
+    pcnt_channel_handle_t chan_b = NULL;
+    ESP_ERROR_CHECK(pcnt_new_channel(s_pcnt_unit, &chan_a_cfg, &chan_a));
+    ESP_ERROR_CHECK(pcnt_new_channel(s_pcnt_unit, &chan_b_cfg, &chan_b));
+    ESP_ERROR_CHECK(pcnt_channel_set_edge_action(chan_a, PCNT_CHANNEL_EDGE_ACTION_DECREASE, PCNT_CHANNEL_EDGE_ACTION_INCREASE));
+    ESP_ERROR_CHECK(pcnt_channel_set_level_action(chan_a, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE));
+    ESP_ERROR_CHECK(pcnt_channel_set_edge_action(chan_b, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_DECREASE));
+    ESP_ERROR_CHECK(pcnt_channel_set_level_action(chan_b, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE));
+    gpio_pullup_en(pin_a);
+    gpio_pullup_en(pin_b);
+
+    /* limits have to be watch points for accum_count, they are also our detent events */
+    ESP_ERROR_CHECK(pcnt_unit_add_watch_point(s_pcnt_unit, ENCODER_COUNTS_PER_DETENT));
+    ESP_ERROR_CHECK(pcnt_unit_add_watch_point(s_pcnt_unit, -ENCODER_COUNTS_PER_DETENT));
+
+    if ((s_encoder_evt_queue = xQueueCreate(8, sizeof(int))) == NULL) {
+        ESP_LOGE(VOLUME_ENCODER_TAG, "%s, queue create failed", __func__);
+        return false;
+    }
+    pcnt_event_callbacks_t cbs = {
+        .on_reach = volume_encoder_on_reach,
+    };
+    ESP_ERROR_CHECK(pcnt_unit_register_event_callbacks(s_pcnt_unit, &cbs, s_encoder_evt_queue));
+
+    ESP_ERROR_CHECK(pcnt_unit_enable(s_pcnt_unit));
+    ESP_ERROR_CHECK(pcnt_unit_clear_count(s_pcnt_unit));
+    ESP_ERROR_CHECK(pcnt_unit_start(s_pcnt_unit));
+
+    xTaskCreate(volume_encoder_task, "EncoderTask", 3072, NULL, 5, &s_encoder_task_handle);
+    ESP_LOGI(VOLUME_ENCODER_TAG, "volume encoder started on GPIO%d/GPIO%d", pin_a, pin_b);
+    return true;
+}
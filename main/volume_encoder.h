@@ -0,0 +1,46 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __VOLUME_ENCODER_H__
+#define __VOLUME_ENCODER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* log tag */
+#define VOLUME_ENCODER_TAG    "ENCODER"
+
+/**
+ * @brief  handler for decoded encoder movement
+ *
+ * @param [in] delta  signed volume change, already scaled by the acceleration curve
+ */
+typedef void (* volume_encoder_cb_t) (int delta);
+
+/**
+ * @brief  volume step for one detent, based on the time since the previous detent
+ *
+ * @param [in] interval_ms  time per detent in milliseconds
+ *
+ * @return  1, 2, 3 or 5 volume units
+ */
+int volume_encoder_step(int64_t interval_ms);
+
+/**
+ * @brief  start quadrature decoding of the volume encoder on the pulse counter
+ *
+ *         The encoder task sleeps until the counter reaches a watch point, so it
+ *         runs independently of any Bluetooth connection state.
+ *
+ * @param [in] pin_a  GPIO of encoder channel A
+ * @param [in] pin_b  GPIO of encoder channel B
+ * @param [in] cb     handler called from the encoder task for each movement
+ *
+ * @return  true if the pulse counter and the task were set up
+ */
+bool volume_encoder_start(int pin_a, int pin_b, volume_encoder_cb_t cb);
+
+#endif /* __VOLUME_ENCODER_H__ */
@@ -0,0 +1,110 @@
+// Renders the speaker state pushed over /ws. The socket sends the full state
+// once and then only the groups that changed, so the object is merged.
+(function () {
+  'use strict';
+
+  var state = {};
+  var volumeDragging = false;
+  var pollTimer = null;
+
+  function $(id) {
+    return document.getElementById(id);
+  }
+
+  function render() {
+    if ('power' in state) {
+      $('power').textContent = state.power ? 'روشن' : 'خاموش';
+    }
+    if ('mode' in state) {
+      $('mode').textContent = state.mode === 'party' ? 'پارتی' : 'خونه';
+      $('preset').textContent = state.preset;
+    }
+    if ('playing' in state) {
+      $('playing').textContent = state.playing ? '▶' : '⏸';
+    }
+    if ('volume' in state && !volumeDragging) {
+      $('volume').value = state.volume;
+    }
+    if (state.track) {
+      $('title').textContent = state.track.title;
+      $('artist').textContent = state.track.artist;
+    }
+    if (state.buffer) {
+      var b = state.buffer;
+      $('buffer').textContent = b.active
+        ? b.level + '% ' + b.mode + ', underflows ' + b.underflows + ', drops ' + b.drops
+        : 'idle';
+    }
+    if (state.limiter) {
+      $('limiter').textContent = 'bass -' + state.limiter.bass + ' dB, mid -' + state.limiter.mid + ' dB';
+    }
+  }
+
+  function merge(delta) {
+    for (var key in delta) {
+      state[key] = delta[key];
+    }
+    render();
+  }
+
+  function post(uri, body) {
+    var xhr = new XMLHttpRequest();
+    xhr.open('POST', uri);
+    xhr.setRequestHeader('Content-Type', 'application/json');
+    xhr.send(JSON.stringify(body));
+  }
+
+  function poll() {
+    var xhr = new XMLHttpRequest();
+    xhr.open('GET', '/api/state');
+    xhr.onload = function () {
+      if (xhr.status === 200) {
+        merge(JSON.parse(xhr.responseText));
+      }
+    };
+    xhr.send();
+  }
+
+  function connect() {
+    var ws = new WebSocket('ws://' + location.host + '/ws');
+    ws.onopen = function () {
+      $('link').textContent = 'live';
+      if (pollTimer) {
+        clearInterval(pollTimer);
+        pollTimer = null;
+      }
+    };
+    ws.onmessage = function (ev) {
+      merge(JSON.parse(ev.data));
+    };
+    ws.onclose = function () {
+      // keep the page usable with slow polling until the socket is back
+      $('link').textContent = 'reconnecting';
+      if (!pollTimer) {
+        poll();
+        pollTimer = setInterval(poll, 5000);
+      }
+      setTimeout(connect, 2000);
+    };
+  }
+
+  var buttons = document.querySelectorAll('button[data-api]');
+  for (var i = 0; i < buttons.length; i++) {
+    buttons[i].onclick = function () {
+      var body = {};
+      body[this.dataset.key] = this.dataset.value;
+      post(this.dataset.api, body);
+    };
+  }
+
+  var volume = $('volume');
+  volume.oninput = function () {
+    volumeDragging = true;
+    post('/api/volume', {volume: parseInt(volume.value, 10)});
+  };
+  volume.onchange = function () {
+    volumeDragging = false;
+  };
+
+  connect();
+})();
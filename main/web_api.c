@@ -0,0 +1,1124 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_http_server.h"
+#include "app_ctrl.h"
+#include "speaker_state.h"
+#include "app_state.h"
+#include "wifi_coex.h"
+#include "audio_stall.h"
+#include "audio_output.h"
+#include "pcm_tap.h"
+#include "mem_telemetry.h"
+#include "trace.h"
+#include "audio_dsp.h"
+#include "audio_preset.h"
+#include "settings.h"
+#include "web_api.h"
+
+#define WEB_API_MAX_WS_CLIENTS    (4)      /* one per soft-AP station */
+#define WEB_API_PUSH_PERIOD_MS    (250)    /* state is sampled at most this often */
+#define WEB_API_PUSH_SLOW_MS      (1000)   /* ... and this often while the soft-AP is throttled */
+#define WEB_API_JSON_LEN          (512)
+#define WEB_API_BODY_LEN          (64)
+#define WEB_API_DSP_BODY_LEN      (192)
+#define WEB_API_LARGE_JSON_LEN    (2560)   /* DSP parameters, memory telemetry */
+#define WEB_API_TAP_SECONDS       (10)     /* length of a tap stream unless asked for */
+#define WEB_API_TAP_MAX_SECONDS   (600)
+#define WEB_API_TAP_GRACE_MS      (2000)   /* a stream without audio ends this long after its length */
+#define WEB_API_TAP_POLL_MS       (20)     /* ring drained this often, well inside its fill time */
+#define WEB_API_TAP_CHUNK         (1024)   /* bytes per HTTP chunk, whole frames of any format */
+
+/* the one tap stream, the tap point itself is exclusive */
+typedef struct {
+    httpd_req_t      *req;       /* detached from the server task */
+    pcm_tap_format_t fmt;
+    uint32_t         seconds;
+} web_api_tap_stream_t;
+
+/* a WebSocket client and what it still has to be sent */
+typedef struct {
+    int  fd;       /* -1 when unused */
+    bool fresh;    /* has not seen the full state yet */
+} web_api_ws_client_t;
+
+/* one push handed over to the server task */
+typedef struct {
+    int  fd;
+    bool full;
+} web_api_push_target_t;
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* read a small request body */
+static bool web_api_read_body(httpd_req_t *req, char *buf, size_t len);
+/* find the value of a top level key in a flat JSON object, quotes stripped */
+static bool web_api_json_value(const char *json, const char *key, char *out, size_t out_len);
+/* answer a control request with its command ID */
+static esp_err_t web_api_send_cmd(httpd_req_t *req, uint32_t id);
+/* GET /api/state */
+static esp_err_t web_api_state_get_handler(httpd_req_t *req);
+/* GET /api/coex */
+static esp_err_t web_api_coex_get_handler(httpd_req_t *req);
+/* GET /api/stalls */
+static esp_err_t web_api_stalls_get_handler(httpd_req_t *req);
+/* GET /api/output */
+static esp_err_t web_api_output_get_handler(httpd_req_t *req);
+/* GET /api/memory */
+static esp_err_t web_api_memory_get_handler(httpd_req_t *req);
+/* GET /api/memory/history */
+static esp_err_t web_api_memory_history_get_handler(httpd_req_t *req);
+/* GET /api/trace */
+static esp_err_t web_api_trace_get_handler(httpd_req_t *req);
+/* GET /api/tap */
+static esp_err_t web_api_tap_get_handler(httpd_req_t *req);
+/* GET /api/tap/stream, arms a tap and hands the request to the stream task */
+static esp_err_t web_api_tap_stream_get_handler(httpd_req_t *req);
+/* sends the armed tap as chunked WAV, then disarms it */
+static void web_api_tap_task_handler(void *arg);
+/* POST /api/volume */
+static esp_err_t web_api_volume_post_handler(httpd_req_t *req);
+/* POST /api/power */
+static esp_err_t web_api_power_post_handler(httpd_req_t *req);
+/* POST /api/mode */
+static esp_err_t web_api_mode_post_handler(httpd_req_t *req);
+/* POST /api/transport */
+static esp_err_t web_api_transport_post_handler(httpd_req_t *req);
+/* answer with the current sound parameters */
+static esp_err_t web_api_send_dsp(httpd_req_t *req);
+/* read a number from a flat JSON object */
+static bool web_api_json_float(const char *json, const char *key, float *out);
+/* GET /api/dsp */
+static esp_err_t web_api_dsp_get_handler(httpd_req_t *req);
+/* POST /api/dsp */
+static esp_err_t web_api_dsp_post_handler(httpd_req_t *req);
+/* POST /api/dsp/eq */
+static esp_err_t web_api_dsp_eq_post_handler(httpd_req_t *req);
+/* POST /api/dsp/route */
+static esp_err_t web_api_dsp_route_post_handler(httpd_req_t *req);
+/* GET /api/preset */
+static esp_err_t web_api_preset_get_handler(httpd_req_t *req);
+/* POST /api/preset */
+static esp_err_t web_api_preset_post_handler(httpd_req_t *req);
+/* GET /api/settings */
+static esp_err_t web_api_settings_get_handler(httpd_req_t *req);
+/* GET /ws, handshake and incoming frames */
+static esp_err_t web_api_ws_handler(httpd_req_t *req);
+/* mark a WebSocket client as needing the full state */
+static void web_api_ws_add(int fd);
+/* sends the prepared frames, runs in the server task */
+static void web_api_push_work(void *arg);
+/* handler for push task */
+static void web_api_push_task_handler(void *arg);
+/* command completion, wakes the push task */
+static void web_api_cmd_done(uint32_t id, app_ctrl_cmd_t cmd, app_ctrl_status_t status);
+/* published state change, wakes the push task */
+static void web_api_state_changed(uint32_t changed, const app_state_t *state);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static httpd_handle_t s_server = NULL;
+static TaskHandle_t s_push_task_handle = NULL;    /* handle of push task */
+static portMUX_TYPE s_ws_lock = portMUX_INITIALIZER_UNLOCKED;
+static web_api_ws_client_t s_ws_clients[WEB_API_MAX_WS_CLIENTS];
+static volatile bool s_push_busy = false;          /* frames below are owned by the server task */
+static web_api_push_target_t s_push_targets[WEB_API_MAX_WS_CLIENTS];
+static int s_push_target_num = 0;
+static char s_full_json[WEB_API_JSON_LEN];
+static int s_full_len = 0;
+static char s_delta_json[WEB_API_JSON_LEN];
+static int s_delta_len = 0;
+static speaker_state_t s_pushed;                   /* state the synced clients have seen */
+static speaker_state_t s_current;
+static char s_large_json[WEB_API_LARGE_JSON_LEN];  /* handlers run one at a time in the server task */
+static web_api_tap_stream_t s_tap;
+static uint8_t s_tap_buf[WEB_API_TAP_CHUNK];        /* owned by the stream task */
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static bool web_api_read_body(httpd_req_t *req, char *buf, size_t len)
+{
+    size_t received = 0;
+
+    if (req->content_len >= len) {
+        return false;
+    }
+    while (received < req->content_len) {
+        int ret = httpd_req_recv(req, buf + received, req->content_len - received);
+        if (ret <= 0) {
+            return false;
+        }
+        received += ret;
+    }
+    buf[received] = '\0';
+    return true;
+}
+
+static bool web_api_json_value(const char *json, const char *key, char *out, size_t out_len)
+{
+    size_t key_len = strlen(key);
+    const char *p = json;
+
+    while ((p = strchr(p, '"')) != NULL) {
+        p++;
+        if (strncmp(p, key, key_len) != 0 || p[key_len] != '"') {
+            continue;
+        }
+        p += key_len + 1;
+        while (*p == ' ' || *p == ':') {
+            p++;
+        }
+        bool quoted = (*p == '"');
+        if (quoted) {
+            p++;
+        }
+        size_t n = 0;
+        while (p[n] && (quoted ? p[n] != '"' : (p[n] != ',' && p[n] != '}' && p[n] != ' '))) {
+            n++;
+        }
+        if (n == 0 || n >= out_len) {
+            return false;
+        }
+        memcpy(out, p, n);
+        out[n] = '\0';
+        return true;
+    }
+    return false;
+}
+
+static esp_err_t web_api_send_cmd(httpd_req_t *req, uint32_t id)
+{
+    char resp[48];
+
+    if (id == 0) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+    } else {
+        httpd_resp_set_status(req, "202 Accepted");
+    }
+    snprintf(resp, sizeof(resp), "{\"id\":%" PRIu32 ",\"status\":\"%s\"}",
+             id, app_ctrl_status_str(app_ctrl_get_status(id)));
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
+}
+
+static esp_err_t web_api_state_get_handler(httpd_req_t *req)
+{
+    speaker_state_t state;
+    char json[WEB_API_JSON_LEN];
+
+    speaker_state_snapshot(&state);
+    int len = speaker_state_to_json(&state, SPEAKER_STATE_F_ALL, json, sizeof(json));
+    if (len < 0) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "state too large");
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, json, len);
+}
+
+static esp_err_t web_api_coex_get_handler(httpd_req_t *req)
+{
+    char json[256];
+
+    int len = wifi_coex_to_json(json, sizeof(json));
+    if (len < 0) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "coex stats too large");
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, json, len);
+}
+
+static esp_err_t web_api_stalls_get_handler(httpd_req_t *req)
+{
+    char json[320];
+
+    int len = audio_stall_to_json(json, sizeof(json));
+    if (len < 0) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "stall stats too large");
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, json, len);
+}
+
+static esp_err_t web_api_output_get_handler(httpd_req_t *req)
+{
+    char json[384];
+
+    int len = audio_output_to_json(json, sizeof(json));
+    if (len < 0) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "output stats too large");
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, json, len);
+}
+
+static esp_err_t web_api_memory_get_handler(httpd_req_t *req)
+{
+    int len = mem_telemetry_to_json(s_large_json, sizeof(s_large_json));
+    if (len < 0) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "memory stats too large");
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, s_large_json, len);
+}
+
+static esp_err_t web_api_memory_history_get_handler(httpd_req_t *req)
+{
+    int len = mem_telemetry_history_to_json(s_large_json, sizeof(s_large_json));
+    if (len < 0) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "memory history too large");
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, s_large_json, len);
+}
+
+static esp_err_t web_api_trace_get_handler(httpd_req_t *req)
+{
+    trace_rec_t recs[8];
+    char text[8 * 64];
+    uint32_t cursor = trace_oldest();
+    uint32_t lost = 0;
+    size_t n;
+
+    /* a snapshot of the ring, oldest first; records written meanwhile may be included */
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    while ((n = trace_read(&cursor, recs, sizeof(recs) / sizeof(recs[0]), &lost)) > 0) {
+        int len = 0;
+        for (size_t i = 0; i < n; i++) {
+            len += trace_format(&recs[i], text + len, sizeof(text) - len - 1);
+            if (len > (int)sizeof(text) - 2) {
+                len = sizeof(text) - 2;
+            }
+            text[len++] = '\n';
+        }
+        if (httpd_resp_send_chunk(req, text, len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t web_api_tap_get_handler(httpd_req_t *req)
+{
+    char json[320];
+
+    int len = pcm_tap_to_json(json, sizeof(json));
+    if (len < 0) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "tap stats too large");
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, json, len);
+}
+
+static esp_err_t web_api_tap_stream_get_handler(httpd_req_t *req)
+{
+    char query[64];
+    char value[16];
+    int point = -1;
+    long decim = 1;
+    long seconds = WEB_API_TAP_SECONDS;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "point", value, sizeof(value)) == ESP_OK) {
+            point = pcm_tap_point_from_str(value);
+        }
+        if (httpd_query_key_value(query, "decim", value, sizeof(value)) == ESP_OK) {
+            decim = strtol(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "seconds", value, sizeof(value)) == ESP_OK) {
+            seconds = strtol(value, NULL, 10);
+        }
+    }
+    if (point < 0) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "expected point=input|xover_mid|xover_bass|limiter");
+    }
+    if (seconds < 1 || seconds > WEB_API_TAP_MAX_SECONDS) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "seconds out of range");
+    }
+    if (decim < 1 || decim > PCM_TAP_MAX_DECIM) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "decim out of range");
+    }
+
+    esp_err_t err = pcm_tap_arm(point, decim, &s_tap.fmt);
+    if (err == ESP_ERR_INVALID_STATE) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_send(req, "a tap is already streaming", HTTPD_RESP_USE_STRLEN);
+    }
+    if (err == ESP_ERR_NO_MEM) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_send(req, "no memory for the tap ring", HTTPD_RESP_USE_STRLEN);
+    }
+    if (err != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "decim must be 1, 2, 4 or 8");
+    }
+
+    /* the server task moves on, the stream is sent from a task of its own */
+    if (httpd_req_async_handler_begin(req, &s_tap.req) != ESP_OK) {
+        pcm_tap_disarm();
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "cannot detach request");
+    }
+    s_tap.seconds = seconds;
+    if (xTaskCreate(web_api_tap_task_handler, "WebTapTask", 3072, NULL, 1, NULL) != pdPASS) {
+        pcm_tap_disarm();
+        httpd_resp_send_err(s_tap.req, HTTPD_500_INTERNAL_SERVER_ERROR, "no memory for the stream task");
+        httpd_req_async_handler_complete(s_tap.req);
+    }
+    return ESP_OK;
+}
+
+static void web_api_tap_task_handler(void *arg)
+{
+    httpd_req_t *req = s_tap.req;
+    uint8_t hdr[PCM_TAP_WAV_HDR_LEN];
+    uint64_t left = (uint64_t)s_tap.fmt.rate * s_tap.fmt.ch * sizeof(int16_t) * s_tap.seconds;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t limit = pdMS_TO_TICKS(s_tap.seconds * 1000 + WEB_API_TAP_GRACE_MS);
+
+    pcm_tap_wav_header(hdr, &s_tap.fmt);
+    httpd_resp_set_type(req, "audio/wav");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    esp_err_t err = httpd_resp_send_chunk(req, (const char *)hdr, sizeof(hdr));
+    /* ends after its length of audio, without audio after its length in time,
+     * on a format change and when the client goes away */
+    while (err == ESP_OK && left > 0 && xTaskGetTickCount() - start < limit) {
+        size_t n = pcm_tap_read(s_tap_buf, (left < sizeof(s_tap_buf)) ? (size_t)left : sizeof(s_tap_buf));
+        if (n == 0) {
+            if (pcm_tap_stale()) {
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(WEB_API_TAP_POLL_MS));
+            continue;
+        }
+        err = httpd_resp_send_chunk(req, (const char *)s_tap_buf, n);
+        left -= n;
+    }
+    pcm_tap_disarm();
+    if (err == ESP_OK) {
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    httpd_req_async_handler_complete(req);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t web_api_volume_post_handler(httpd_req_t *req)
+{
+    char body[WEB_API_BODY_LEN];
+    char value[8];
+
+    if (!web_api_read_body(req, body, sizeof(body))) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "bad body");
+    }
+    if (web_api_json_value(body, "volume", value, sizeof(value))) {
+        long volume = strtol(value, NULL, 10);
+        if (volume < 0 || volume > 127) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "volume out of range");
+        }
+        return web_api_send_cmd(req, app_ctrl_submit(APP_CTRL_CMD_VOLUME_SET, volume));
+    }
+    if (web_api_json_value(body, "step", value, sizeof(value))) {
+        return web_api_send_cmd(req, app_ctrl_submit(APP_CTRL_CMD_VOLUME_STEP, strtol(value, NULL, 10)));
+    }
+    return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "expected volume or step");
+}
+
+static esp_err_t web_api_power_post_handler(httpd_req_t *req)
+{
+    char body[WEB_API_BODY_LEN];
+    char value[8];
+    app_ctrl_cmd_t cmd = APP_CTRL_CMD_NONE;
+
+    if (!web_api_read_body(req, body, sizeof(body)) ||
+        !web_api_json_value(body, "power", value, sizeof(value))) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "expected power");
+    }
+    if (strcmp(value, "on") == 0) {
+        cmd = APP_CTRL_CMD_POWER_ON;
+    } else if (strcmp(value, "off") == 0) {
+        cmd = APP_CTRL_CMD_POWER_OFF;
+    } else if (strcmp(value, "toggle") == 0) {
+        cmd = APP_CTRL_CMD_POWER_TOGGLE;
+    } else {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown power state");
+    }
+    return web_api_send_cmd(req, app_ctrl_submit(cmd, 0));
+}
+
+static esp_err_t web_api_mode_post_handler(httpd_req_t *req)
+{
+    char body[WEB_API_BODY_LEN];
+    char value[8];
+    app_ctrl_cmd_t cmd = APP_CTRL_CMD_NONE;
+
+    if (!web_api_read_body(req, body, sizeof(body)) ||
+        !web_api_json_value(body, "mode", value, sizeof(value))) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "expected mode");
+    }
+    if (strcmp(value, "party") == 0) {
+        cmd = APP_CTRL_CMD_MODE_PARTY;
+    } else if (strcmp(value, "home") == 0) {
+        cmd = APP_CTRL_CMD_MODE_HOME;
+    } else if (strcmp(value, "toggle") == 0) {
+        cmd = APP_CTRL_CMD_MODE_TOGGLE;
+    } else {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown mode");
+    }
+    return web_api_send_cmd(req, app_ctrl_submit(cmd, 0));
+}
+
+static esp_err_t web_api_transport_post_handler(httpd_req_t *req)
+{
+    char body[WEB_API_BODY_LEN];
+    char value[12];
+    app_ctrl_cmd_t cmd = APP_CTRL_CMD_NONE;
+
+    if (!web_api_read_body(req, body, sizeof(body)) ||
+        !web_api_json_value(body, "action", value, sizeof(value))) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "expected action");
+    }
+    if (strcmp(value, "play_pause") == 0) {
+        cmd = APP_CTRL_CMD_PLAY_PAUSE;
+    } else if (strcmp(value, "next") == 0) {
+        cmd = APP_CTRL_CMD_NEXT_TRACK;
+    } else if (strcmp(value, "prev") == 0) {
+        cmd = APP_CTRL_CMD_PREV_TRACK;
+    } else {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown action");
+    }
+    return web_api_send_cmd(req, app_ctrl_submit(cmd, 0));
+}
+
+static esp_err_t web_api_send_dsp(httpd_req_t *req)
+{
+    audio_dsp_params_t params;
+    audio_dsp_bass_stats_t bass;
+
+    audio_dsp_get_params(&params);
+    audio_dsp_get_bass_stats(&bass);
+    int len = audio_dsp_params_to_json(&params, s_large_json, sizeof(s_large_json));
+    if (len > 0) {
+        /* what the delay lines cost, against what internal RAM has left, and
+         * the cycles per frame of the block loop with the bass on either path
+         * under the split kernel in use */
+        len--;
+        len += snprintf(s_large_json + len, sizeof(s_large_json) - len,
+                        ",\"memory\":{\"delay\":%u,\"internal_free\":%u},"
+                        "\"bass_path\":{\"decimation\":%u,\"enabled\":%s,\"active\":%s,"
+                        "\"cycles_per_frame\":{\"full_rate\":%.1f,\"decimated\":%.1f}},\"kernel\":\"%s\"}",
+                        (unsigned)audio_dsp_delay_mem_size(), (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                        bass.decimation, bass.enabled ? "true" : "false", bass.active ? "true" : "false",
+                        bass.cycles_full, bass.cycles_decimated, audio_dsp_kernel_name());
+    }
+    if (len < 0 || len >= (int)sizeof(s_large_json)) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "parameters too large");
+    }
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, s_large_json, len);
+}
+
+static bool web_api_json_float(const char *json, const char *key, float *out)
+{
+    char value[16];
+    char *end;
+
+    if (!web_api_json_value(json, key, value, sizeof(value))) {
+        return false;
+    }
+    float v = strtof(value, &end);
+    if (end == value) {
+        return false;
+    }
+    *out = v;
+    return true;
+}
+
+static esp_err_t web_api_dsp_get_handler(httpd_req_t *req)
+{
+    return web_api_send_dsp(req);
+}
+
+static esp_err_t web_api_dsp_post_handler(httpd_req_t *req)
+{
+    char body[WEB_API_DSP_BODY_LEN];
+    char value[8];
+    audio_dsp_params_t params;
+    bool any = false;
+
+    if (!web_api_read_body(req, body, sizeof(body))) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "bad body");
+    }
+    bool decim = web_api_json_value(body, "bass_decimation", value, sizeof(value));
+    if (decim) {
+        if (strcmp(value, "true") != 0 && strcmp(value, "false") != 0) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "bass_decimation is true or false");
+        }
+        if (audio_dsp_set_bass_decimation(strcmp(value, "true") == 0) != ESP_OK) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "built without bass decimation");
+        }
+    }
+    audio_dsp_get_params(&params);
+    any |= web_api_json_float(body, "crossover", &params.crossover_hz);
+    any |= web_api_json_float(body, "crossover_high", &params.crossover_high_hz);
+    any |= web_api_json_float(body, "limiter", &params.limiter_db);
+    any |= web_api_json_float(body, "bass_trim", &params.trim_db[AUDIO_DSP_BAND_BASS]);
+    any |= web_api_json_float(body, "mid_trim", &params.trim_db[AUDIO_DSP_BAND_MID]);
+    any |= web_api_json_float(body, "high_trim", &params.trim_db[AUDIO_DSP_BAND_HIGH]);
+    any |= web_api_json_float(body, "bass_delay", &params.delay_ms[AUDIO_DSP_BAND_BASS]);
+    any |= web_api_json_float(body, "mid_delay", &params.delay_ms[AUDIO_DSP_BAND_MID]);
+    any |= web_api_json_float(body, "high_delay", &params.delay_ms[AUDIO_DSP_BAND_HIGH]);
+    if (!any && !decim) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "no known parameter");
+    }
+    if (any && audio_dsp_set_params(&params) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "dsp not running");
+    }
+    return web_api_send_dsp(req);
+}
+
+static esp_err_t web_api_dsp_eq_post_handler(httpd_req_t *req)
+{
+    char body[WEB_API_DSP_BODY_LEN];
+    char value[16];
+    audio_dsp_params_t params;
+
+    if (!web_api_read_body(req, body, sizeof(body)) ||
+        !web_api_json_value(body, "band", value, sizeof(value))) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "expected band");
+    }
+    int band = audio_dsp_band_from_str(value);
+    if (band < 0 || band >= AUDIO_DSP_NUM_BANDS) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown band");
+    }
+    if (!web_api_json_value(body, "index", value, sizeof(value))) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "expected index");
+    }
+    long index = strtol(value, NULL, 10);
+    if (index < 0 || index >= DSP_EQ_MAX_BANDS) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "index out of range");
+    }
+
+    audio_dsp_get_params(&params);
+    dsp_eq_band_t *eq = &params.eq[band][index];
+    if (web_api_json_value(body, "type", value, sizeof(value))) {
+        int type = audio_dsp_eq_type_from_str(value);
+        if (type < 0) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown type");
+        }
+        eq->type = (uint8_t)type;
+    }
+    web_api_json_float(body, "freq", &eq->freq_hz);
+    web_api_json_float(body, "gain", &eq->gain_db);
+    web_api_json_float(body, "q", &eq->q);
+    if (index >= params.eq_n[band]) {
+        /* bands in between stay off */
+        params.eq_n[band] = (uint8_t)(index + 1);
+    }
+    if (audio_dsp_set_params(&params) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "dsp not running");
+    }
+    return web_api_send_dsp(req);
+}
+
+static esp_err_t web_api_dsp_route_post_handler(httpd_req_t *req)
+{
+    char body[WEB_API_DSP_BODY_LEN];
+    char value[16];
+    audio_dsp_params_t params;
+    bool any = false;
+
+    if (!web_api_read_body(req, body, sizeof(body))) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "bad body");
+    }
+    audio_dsp_get_params(&params);
+    if (web_api_json_value(body, "layout", value, sizeof(value))) {
+        int layout = audio_dsp_layout_from_str(value);
+        if (layout < 0 || layout == AUDIO_DSP_LAYOUT_CUSTOM) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown layout");
+        }
+        audio_dsp_set_layout(&params, layout);
+        any = true;
+    }
+    if (web_api_json_value(body, "ways", value, sizeof(value))) {
+        long ways = strtol(value, NULL, 10);
+        if (ways < 2 || ways > AUDIO_DSP_NUM_BANDS) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "ways out of range");
+        }
+        params.ways = (uint8_t)ways;
+        any = true;
+    }
+    if (web_api_json_value(body, "slot", value, sizeof(value))) {
+        int slot = audio_dsp_slot_from_str(value);
+        if (slot < 0) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown slot");
+        }
+        audio_dsp_route_t *route = &params.route[slot];
+        if (web_api_json_value(body, "band", value, sizeof(value))) {
+            int band = audio_dsp_band_from_str(value);
+            if (band < 0) {
+                return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown band");
+            }
+            route->band = (uint8_t)band;
+        }
+        if (web_api_json_value(body, "src", value, sizeof(value))) {
+            int src = audio_dsp_src_from_str(value);
+            if (src < 0) {
+                return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown src");
+            }
+            route->src = (uint8_t)src;
+        }
+        any = true;
+    }
+    if (!any) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "expected layout, ways or slot");
+    }
+    for (int slot = 0; slot < AUDIO_DSP_NUM_SLOTS; slot++) {
+        if (params.route[slot].band != AUDIO_DSP_BAND_NONE && params.route[slot].band >= params.ways) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "band not produced with these ways");
+        }
+    }
+    if (audio_dsp_set_params(&params) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "dsp not running");
+    }
+    /* the routing follows the wiring, keep it across reboots */
+    settings_set(SETTINGS_ROUTING, (int32_t)audio_dsp_routing_pack(&params));
+    return web_api_send_dsp(req);
+}
+
+static esp_err_t web_api_preset_get_handler(httpd_req_t *req)
+{
+    char json[256];
+    int len = snprintf(json, sizeof(json), "{\"current\":\"%s\",\"presets\":[",
+                       audio_preset_name(audio_preset_current()));
+
+    for (int id = 0; id < AUDIO_PRESET_NUM && len < (int)sizeof(json); id++) {
+        len += snprintf(json + len, sizeof(json) - len, "%s{\"name\":\"%s\",\"stored\":%s}",
+                        (id > 0) ? "," : "", audio_preset_name(id), audio_preset_is_stored(id) ? "true" : "false");
+    }
+    if (len < (int)sizeof(json)) {
+        len += snprintf(json + len, sizeof(json) - len, "]}");
+    }
+    if (len >= (int)sizeof(json)) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "presets too large");
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, json, len);
+}
+
+static esp_err_t web_api_preset_post_handler(httpd_req_t *req)
+{
+    char body[WEB_API_BODY_LEN];
+    char value[12];
+    app_ctrl_cmd_t cmd = APP_CTRL_CMD_NONE;
+
+    if (!web_api_read_body(req, body, sizeof(body))) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "bad body");
+    }
+    if (web_api_json_value(body, "preset", value, sizeof(value))) {
+        cmd = APP_CTRL_CMD_PRESET_SELECT;
+    } else if (web_api_json_value(body, "store", value, sizeof(value))) {
+        cmd = APP_CTRL_CMD_PRESET_STORE;
+    } else {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "expected preset or store");
+    }
+    int id = audio_preset_from_name(value);
+    if (id < 0) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown preset");
+    }
+    return web_api_send_cmd(req, app_ctrl_submit(cmd, id));
+}
+
+static esp_err_t web_api_settings_get_handler(httpd_req_t *req)
+{
+    char json[256];
+
+    int len = settings_to_json(json, sizeof(json));
+    if (len < 0) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "settings too large");
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, json, len);
+}
+
+static void web_api_ws_add(int fd)
+{
+    int slot = -1;
+
+    portENTER_CRITICAL(&s_ws_lock);
+    for (int i = 0; i < WEB_API_MAX_WS_CLIENTS; i++) {
+        if (s_ws_clients[i].fd == fd) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 && s_ws_clients[i].fd < 0) {
+            slot = i;
+        }
+    }
+    if (slot >= 0) {
+        s_ws_clients[slot].fd = fd;
+        s_ws_clients[slot].fresh = true;
+    }
+    portEXIT_CRITICAL(&s_ws_lock);
+
+    if (slot < 0) {
+        ESP_LOGW(WEB_API_TAG, "%s, no room for WebSocket client %d", __func__, fd);
+        return;
+    }
+    if (s_push_task_handle) {
+        xTaskNotifyGive(s_push_task_handle);
+    }
+}
+
+static esp_err_t web_api_ws_handler(httpd_req_t *req)
+{
+    uint8_t buf[WEB_API_BODY_LEN];
+    httpd_ws_frame_t frame;
+
+    if (req->method == HTTP_GET) {
+        /* handshake done, the push task sends the full state */
+        web_api_ws_add(httpd_req_to_sockfd(req));
+        return ESP_OK;
+    }
+
+    memset(&frame, 0, sizeof(frame));
+    frame.payload = buf;
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, sizeof(buf) - 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    buf[frame.len] = '\0';
+    /* a client that lost track of the deltas can ask for everything again */
+    if (frame.type == HTTPD_WS_TYPE_TEXT && strcmp((char *)buf, "state") == 0) {
+        web_api_ws_add(httpd_req_to_sockfd(req));
+    }
+    return ESP_OK;
+}
+
+static void web_api_push_work(void *arg)
+{
+    for (int i = 0; i < s_push_target_num; i++) {
+        web_api_push_target_t *target = &s_push_targets[i];
+        httpd_ws_frame_t frame = {
+            .final = true,
+            .type = HTTPD_WS_TYPE_TEXT,
+            .payload = (uint8_t *)(target->full ? s_full_json : s_delta_json),
+            .len = target->full ? s_full_len : s_delta_len,
+        };
+
+        if (httpd_ws_get_fd_info(s_server, target->fd) != HTTPD_WS_CLIENT_WEBSOCKET ||
+            httpd_ws_send_frame_async(s_server, target->fd, &frame) != ESP_OK) {
+            /* gone or stuck, it gets the full state again if it reconnects */
+            portENTER_CRITICAL(&s_ws_lock);
+            for (int j = 0; j < WEB_API_MAX_WS_CLIENTS; j++) {
+                if (s_ws_clients[j].fd == target->fd) {
+                    s_ws_clients[j].fd = -1;
+                }
+            }
+            portEXIT_CRITICAL(&s_ws_lock);
+            ESP_LOGI(WEB_API_TAG, "WebSocket client %d removed", target->fd);
+        }
+    }
+    s_push_busy = false;
+}
+
+static void web_api_push_task_handler(void *arg)
+{
+    for (;;) {
+        /* less WiFi traffic while the radio is busy with audio */
+        uint32_t period_ms = (wifi_coex_get_state() == WIFI_COEX_AP_THROTTLED) ? WEB_API_PUSH_SLOW_MS : WEB_API_PUSH_PERIOD_MS;
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(period_ms));
+        if (s_push_busy) {
+            continue;
+        }
+
+        /* pick the clients first, nothing is sampled while nobody listens */
+        int synced = 0;
+        int fresh = 0;
+        s_push_target_num = 0;
+        portENTER_CRITICAL(&s_ws_lock);
+        for (int i = 0; i < WEB_API_MAX_WS_CLIENTS; i++) {
+            if (s_ws_clients[i].fd < 0) {
+                continue;
+            }
+            s_push_targets[s_push_target_num].fd = s_ws_clients[i].fd;
+            s_push_targets[s_push_target_num].full = s_ws_clients[i].fresh;
+            s_push_target_num++;
+            if (s_ws_clients[i].fresh) {
+                fresh++;
+            } else {
+                synced++;
+            }
+            s_ws_clients[i].fresh = false;
+        }
+        portEXIT_CRITICAL(&s_ws_lock);
+        if (s_push_target_num == 0) {
+            continue;
+        }
+
+        speaker_state_snapshot(&s_current);
+        uint32_t fields = (synced > 0) ? speaker_state_diff(&s_pushed, &s_current) : 0;
+        s_delta_len = 0;
+        if (fields) {
+            s_delta_len = speaker_state_to_json(&s_current, fields, s_delta_json, sizeof(s_delta_json));
+        }
+        s_full_len = 0;
+        if (fresh > 0) {
+            s_full_len = speaker_state_to_json(&s_current, SPEAKER_STATE_F_ALL, s_full_json, sizeof(s_full_json));
+        }
+
+        /* drop targets that have nothing to receive */
+        int n = 0;
+        for (int i = 0; i < s_push_target_num; i++) {
+            int len = s_push_targets[i].full ? s_full_len : s_delta_len;
+            if (len > 0) {
+                s_push_targets[n++] = s_push_targets[i];
+            }
+        }
+        s_push_target_num = n;
+
+        if (synced > 0) {
+            speaker_state_merge(&s_pushed, &s_current, fields);
+        } else {
+            s_pushed = s_current;
+        }
+        if (n == 0) {
+            continue;
+        }
+
+        /* sockets are only written from the server task */
+        s_push_busy = true;
+        if (httpd_queue_work(s_server, web_api_push_work, NULL) != ESP_OK) {
+            ESP_LOGW(WEB_API_TAG, "%s, queue work failed", __func__);
+            s_push_busy = false;
+        }
+    }
+}
+
+static void web_api_cmd_done(uint32_t id, app_ctrl_cmd_t cmd, app_ctrl_status_t status)
+{
+    if (s_push_task_handle) {
+        xTaskNotifyGive(s_push_task_handle);
+    }
+}
+
+static void web_api_state_changed(uint32_t changed, const app_state_t *state)
+{
+    if (s_push_task_handle) {
+        xTaskNotifyGive(s_push_task_handle);
+    }
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void web_api_register(httpd_handle_t server)
+{
+    s_server = server;
+    for (int i = 0; i < WEB_API_MAX_WS_CLIENTS; i++) {
+        s_ws_clients[i].fd = -1;
+    }
+
+    httpd_uri_t state_get = {
+        .uri = "/api/state",
+        .method = HTTP_GET,
+        .handler = web_api_state_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &state_get);
+
+    httpd_uri_t volume_post = {
+        .uri = "/api/volume",
+        .method = HTTP_POST,
+        .handler = web_api_volume_post_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &volume_post);
+
+    httpd_uri_t coex_get = {
+        .uri = "/api/coex",
+        .method = HTTP_GET,
+        .handler = web_api_coex_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &coex_get);
+
+    httpd_uri_t stalls_get = {
+        .uri = "/api/stalls",
+        .method = HTTP_GET,
+        .handler = web_api_stalls_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &stalls_get);
+
+    httpd_uri_t output_get = {
+        .uri = "/api/output",
+        .method = HTTP_GET,
+        .handler = web_api_output_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &output_get);
+
+    httpd_uri_t memory_get = {
+        .uri = "/api/memory",
+        .method = HTTP_GET,
+        .handler = web_api_memory_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &memory_get);
+
+    httpd_uri_t memory_history_get = {
+        .uri = "/api/memory/history",
+        .method = HTTP_GET,
+        .handler = web_api_memory_history_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &memory_history_get);
+
+    httpd_uri_t trace_get = {
+        .uri = "/api/trace",
+        .method = HTTP_GET,
+        .handler = web_api_trace_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &trace_get);
+
+    httpd_uri_t tap_get = {
+        .uri = "/api/tap",
+        .method = HTTP_GET,
+        .handler = web_api_tap_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &tap_get);
+
+    httpd_uri_t tap_stream_get = {
+        .uri = "/api/tap/stream",
+        .method = HTTP_GET,
+        .handler = web_api_tap_stream_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &tap_stream_get);
+
+    httpd_uri_t power_post = {
+        .uri = "/api/power",
+        .method = HTTP_POST,
+        .handler = web_api_power_post_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &power_post);
+
+    httpd_uri_t mode_post = {
+        .uri = "/api/mode",
+        .method = HTTP_POST,
+        .handler = web_api_mode_post_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &mode_post);
+
+    httpd_uri_t transport_post = {
+        .uri = "/api/transport",
+        .method = HTTP_POST,
+        .handler = web_api_transport_post_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &transport_post);
+
+    httpd_uri_t dsp_get = {
+        .uri = "/api/dsp",
+        .method = HTTP_GET,
+        .handler = web_api_dsp_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &dsp_get);
+
+    httpd_uri_t dsp_post = {
+        .uri = "/api/dsp",
+        .method = HTTP_POST,
+        .handler = web_api_dsp_post_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &dsp_post);
+
+    httpd_uri_t dsp_eq_post = {
+        .uri = "/api/dsp/eq",
+        .method = HTTP_POST,
+        .handler = web_api_dsp_eq_post_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &dsp_eq_post);
+
+    httpd_uri_t dsp_route_post = {
+        .uri = "/api/dsp/route",
+        .method = HTTP_POST,
+        .handler = web_api_dsp_route_post_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &dsp_route_post);
+
+    httpd_uri_t preset_get = {
+        .uri = "/api/preset",
+        .method = HTTP_GET,
+        .handler = web_api_preset_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &preset_get);
+
+    httpd_uri_t preset_post = {
+        .uri = "/api/preset",
+        .method = HTTP_POST,
+        .handler = web_api_preset_post_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &preset_post);
+
+    httpd_uri_t settings_get = {
+        .uri = "/api/settings",
+        .method = HTTP_GET,
+        .handler = web_api_settings_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &settings_get);
+
+    httpd_uri_t ws = {
+        .uri = "/ws",
+        .method = HTTP_GET,
+        .handler = web_api_ws_handler,
+        .user_ctx = NULL,
+        .is_websocket = true
+    };
+    httpd_register_uri_handler(server, &ws);
+
+    app_ctrl_register_done_cb(web_api_cmd_done);
+    app_state_register_cb(web_api_state_changed);
+    if (s_push_task_handle == NULL) {
+        xTaskCreate(web_api_push_task_handler, "WebPushTask", 3072, NULL, 2, &s_push_task_handle);
+    }
+}
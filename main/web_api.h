@@ -0,0 +1,60 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __WEB_API_H__
+#define __WEB_API_H__
+
+#include "esp_http_server.h"
+
+/* log tag */
+#define WEB_API_TAG    "WEB_API"
+
+/* URI handlers registered by web_api_register */
+#define WEB_API_URI_HANDLERS    (21)
+
+/**
+ * @brief  register the JSON API and the state push WebSocket on a running server
+ *
+ *         GET  /api/state      full state as JSON
+ *         GET  /api/coex       soft-AP coexistence state and underflows per AP state
+ *         GET  /api/trace      audio path trace records as text, oldest first
+ *         GET  /api/stalls     flash writes, the audio blocks they stalled and I2S DMA underruns
+ *         GET  /api/memory     free and largest free heap per region, stack high water marks
+ *                              and allocation counters per subsystem
+ *         GET  /api/memory/history  free heap and largest free block, sampled periodically
+ *         GET  /api/output     output sink, running format, reclocks, fades and time to first audio
+ *         GET  /api/tap        PCM tap points, the armed one and its drop counters
+ *         GET  /api/tap/stream ?point=input|xover_mid|xover_bass|limiter&decim=1|2|4|8&seconds=N,
+ *                              arms the point and streams it as chunked 16-bit WAV, 409 while
+ *                              another stream runs
+ *         POST /api/power      {"power":"on"|"off"|"toggle"}
+ *         POST /api/volume     {"volume":N} or {"step":N}
+ *         POST /api/mode       {"mode":"party"|"home"|"toggle"}
+ *         POST /api/transport  {"action":"play_pause"|"next"|"prev"}
+ *         GET  /api/dsp        sound parameters
+ *         POST /api/dsp        any of {"crossover","crossover_high","limiter","bass_trim",
+ *                              "mid_trim","high_trim","bass_delay","mid_delay","high_delay",
+ *                              "bass_decimation":true|false}, answered with the new parameters
+ *         POST /api/dsp/eq     {"band":"bass"|"mid"|"high","index":N,"type":"peak"|"low_shelf"|
+ *                              "high_shelf"|"high_pass"|"low_pass"|"off","freq","gain","q"}
+ *         POST /api/dsp/route  {"layout":"2way"|"3way"|"stereo_sub"|"mono_2way"}, {"ways":N}
+ *                              and/or {"slot":"mid_l"|"mid_r"|"bass_l"|"bass_r","band":"bass"|"mid"|
+ *                              "high"|"none","src":"left"|"right"|"sum"}, kept across reboots
+ *         GET  /api/preset     selected preset and the slots that were stored
+ *         POST /api/preset     {"preset":name} selects, {"store":name} saves the live sound into a slot
+ *         GET  /api/settings   persisted settings, pending writes and flash wear counters
+ *         GET  /ws             WebSocket, full state on connect, then deltas
+ *
+ *         Control requests are queued in app_ctrl and answered with
+ *         202 {"id":N,"status":"queued"} without waiting for them to run.
+ *         Sound parameters are applied before the answer, the audio path
+ *         crossfades to them at its next block.
+ *
+ * @param [in] server  handle of the started HTTP server
+ */
+void web_api_register(httpd_handle_t server);
+
+#endif /* __WEB_API_H__ */
@@ -0,0 +1,26 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "web_assets.h"
+
+const web_asset_t *web_assets_find(const char *uri)
+{
+    size_t len = strcspn(uri, "?#");
+
+    if (len == 1 && uri[0] == '/') {
+        uri = "/index.html";
+        len = strlen(uri);
+    }
+    for (size_t i = 0; i < web_assets_num; i++) {
+        if (strlen(web_assets[i].path) == len && strncmp(web_assets[i].path, uri, len) == 0) {
+            return &web_assets[i];
+        }
+    }
+    return NULL;
+}
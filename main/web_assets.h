@@ -0,0 +1,37 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __WEB_ASSETS_H__
+#define __WEB_ASSETS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* one gzip compressed file of the web UI, generated from main/web at build time */
+typedef struct {
+    const char    *path;    /*!< URI path, e.g. "/index.html" */
+    const char    *mime;    /*!< Content-Type */
+    const char    *etag;    /*!< strong ETag including quotes, hash of the compressed data */
+    const uint8_t *data;    /*!< gzip stream */
+    size_t        len;      /*!< gzip stream length in byte */
+} web_asset_t;
+
+/* asset table emitted by gen_web_assets.py */
+extern const web_asset_t web_assets[];
+extern const size_t web_assets_num;
+
+/**
+ * @brief  look up the asset served for a URI path
+ *
+ *         "/" maps to "/index.html", a query string is ignored.
+ *
+ * @param [in] uri  request URI
+ *
+ * @return  asset, NULL if there is none
+ */
+const web_asset_t *web_assets_find(const char *uri);
+
+#endif /* __WEB_ASSETS_H__ */
@@ -1,22 +1,20 @@
 #include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "esp_netif.h"
 #include "esp_http_server.h"
-#include "driver/gpio.h"
-
-extern void system_start(void);
-extern void system_stop(void);
-extern bool system_on;
-extern bool party_mode;
+#include "app_ctrl.h"
+#include "web_api.h"
+#include "web_assets.h"
 
 #define WIFI_SSID      "Mehrdad Speaker"
 #define WIFI_PASS      "123456789"
 #define WIFI_CHANNEL   1
 #define MAX_STA_CONN   4
-#define PARTY_MODE_LED_GPIO 2
 
 static const char *TAG = "WEB_CTRL";
 
@@ -61,61 +59,47 @@ void wifi_init_softap(void)
     ESP_LOGI(TAG, "WiFi AP started. SSID:%s password:%s", WIFI_SSID, WIFI_PASS);
 }
 
-// --- HTML Panel ---
-static const char *panel_html =
-"<!DOCTYPE html><html><head><meta charset='utf-8'><title>Mehrdad Speaker</title>"
-"<meta name='viewport' content='width=device-width,initial-scale=1'>"
-"</head><body style='background:#fafafa;font-family:sans-serif;text-align:center;padding-top:40px;'>"
-"<h2>Mehrdad Speaker Control</h2>"
-"<form method='POST'>"
-"<button name='power' value='on' style='font-size:1.1em;padding:10px 30px;margin:10px;'>روشن</button>"
-"<button name='power' value='off' style='font-size:1.1em;padding:10px 30px;margin:10px;'>خاموش</button><br><br>"
-"<button name='mode' value='party' style='font-size:1em;padding:8px 22px;margin:8px;'>پارتی مد</button>"
-"<button name='mode' value='home' style='font-size:1em;padding:8px 22px;margin:8px;'>خونه مد</button>"
-"</form>"
-"<p style='margin-top:24px;'>وضعیت اسپیکر: <b>%s</b> | حالت: <b>%s</b></p>"
-"</body></html>";
-
-// --- HTTP Handlers ---
-esp_err_t panel_get_handler(httpd_req_t *req)
+// --- Static UI: gzip assets from flash, revalidated by ETag ---
+esp_err_t asset_get_handler(httpd_req_t *req)
 {
-    char resp[1024];
-    snprintf(resp, sizeof(resp), panel_html,
-        system_on ? "روشن" : "خاموش",
-        party_mode ? "پارتی" : "خونه"
-    );
-    httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
-}
+    char etag[24];
+    const web_asset_t *asset = web_assets_find(req->uri);
 
-esp_err_t panel_post_handler(httpd_req_t *req)
-{
-    char buf[100];
-    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
-    buf[ret] = 0;
-
-    if (strstr(buf, "power=on")) {
-        if (!system_on) {
-            ESP_LOGI(TAG, "Calling system_start from web panel");
-            system_start();
-        }
-    }
-    if (strstr(buf, "power=off")) {
-        if (system_on) {
-            ESP_LOGI(TAG, "Calling system_stop from web panel");
-            system_stop();
-        }
+    if (asset == NULL) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
     }
-    if (strstr(buf, "mode=party")) {
-        party_mode = true;
-        gpio_set_level(PARTY_MODE_LED_GPIO, 1);
-    }
-    if (strstr(buf, "mode=home")) {
-        party_mode = false;
-        gpio_set_level(PARTY_MODE_LED_GPIO, 0);
+
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    // مرورگر هر بار اعتبارسنجی می‌کند؛ اگر تغییری نباشد فقط ۳۰۴ برمی‌گردد
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", etag, sizeof(etag)) == ESP_OK &&
+        strcmp(etag, asset->etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
     }
 
-    return panel_get_handler(req);
+    httpd_resp_set_type(req, asset->mime);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)asset->data, asset->len);
+}
+
+// --- Command status: /cmd?id=N ---
+esp_err_t cmd_status_get_handler(httpd_req_t *req)
+{
+    char query[32];
+    char value[12];
+    char resp[96];
+    uint32_t id = 0;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "id", value, sizeof(value)) == ESP_OK) {
+        id = strtoul(value, NULL, 10);
+    }
+    snprintf(resp, sizeof(resp), "{\"id\":%" PRIu32 ",\"status\":\"%s\"}",
+             id, app_ctrl_status_str(app_ctrl_get_status(id)));
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
 }
 
 // --- Web Server ---
@@ -123,25 +107,32 @@ void start_webserver(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
+    config.max_uri_handlers = 2 + WEB_API_URI_HANDLERS;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    /* idle WebSocket clients must not lock out new page loads */
+    config.lru_purge_enable = true;
 
     httpd_handle_t server = NULL;
     httpd_start(&server, &config);
 
-    httpd_uri_t panel = {
-        .uri = "/",
+    httpd_uri_t cmd_status = {
+        .uri = "/cmd",
         .method = HTTP_GET,
-        .handler = panel_get_handler,
+        .handler = cmd_status_get_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &panel);
+    httpd_register_uri_handler(server, &cmd_status);
 
-    httpd_uri_t panel_post = {
-        .uri = "/",
-        .method = HTTP_POST,
-        .handler = panel_post_handler,
+    web_api_register(server);
+
+    /* catch-all, has to be registered last */
+    httpd_uri_t asset = {
+        .uri = "/*",
+        .method = HTTP_GET,
+        .handler = asset_get_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &panel_post);
+    httpd_register_uri_handler(server, &asset);
 }
 
 // // --- Main Entry ---
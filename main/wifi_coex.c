@@ -0,0 +1,218 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "bt_app_core.h"
+#include "wifi_coex.h"
+
+#define WIFI_COEX_TICK_MS           (1000)
+#define WIFI_COEX_HOLD_MS           (5000)   /* streaming state must settle before the AP is reconfigured */
+#define WIFI_COEX_FULL_BEACON_TU    (100)    /* ESP-IDF default beacon interval */
+
+/* time spent and underflows seen in one AP state */
+typedef struct {
+    uint32_t seconds;
+    uint32_t underflows;
+} wifi_coex_stat_t;
+
+/*******************************
+ * STATIC FUNCTION DECLARATIONS
+ ******************************/
+
+/* station connect / disconnect events */
+static void wifi_coex_event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data);
+/* AP state to use while the AP is up */
+static wifi_coex_ap_state_t wifi_coex_up_state(bool streaming);
+/* reconfigure the soft-AP */
+static void wifi_coex_apply(wifi_coex_ap_state_t state);
+/* handler for coexistence task */
+static void wifi_coex_task_handler(void *arg);
+
+/*******************************
+ * STATIC VARIABLE DEFINITIONS
+ ******************************/
+
+static const char *s_ap_state_str[] = {"full", "throttled", "off"};
+
+static TaskHandle_t s_coex_task_handle = NULL;    /* handle of coexistence task */
+static volatile bool s_streaming = false;
+static volatile bool s_wake_req = false;
+static volatile int s_stations = 0;
+static volatile wifi_coex_ap_state_t s_state = WIFI_COEX_AP_FULL;
+static int8_t s_full_tx_power = 80;                /* 0.25 dBm units, read back at start */
+static wifi_coex_stat_t s_stats[WIFI_COEX_AP_MAX]; /* written by the coexistence task only */
+
+/*******************************
+ * STATIC FUNCTION DEFINITIONS
+ ******************************/
+
+static void wifi_coex_event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    if (event_id == WIFI_EVENT_AP_STACONNECTED) {
+        s_stations++;
+    } else if (event_id == WIFI_EVENT_AP_STADISCONNECTED && s_stations > 0) {
+        s_stations--;
+    }
+}
+
+static wifi_coex_ap_state_t wifi_coex_up_state(bool streaming)
+{
+#if CONFIG_EXAMPLE_WIFI_COEX_THROTTLE
+    if (streaming) {
+        return WIFI_COEX_AP_THROTTLED;
+    }
+#endif
+    return WIFI_COEX_AP_FULL;
+}
+
+static void wifi_coex_apply(wifi_coex_ap_state_t state)
+{
+    wifi_config_t cfg;
+
+    if (state == WIFI_COEX_AP_OFF) {
+        esp_wifi_stop();
+        s_stations = 0;
+    } else {
+        if (s_state == WIFI_COEX_AP_OFF) {
+            esp_wifi_start();
+        }
+        uint16_t beacon_interval = WIFI_COEX_FULL_BEACON_TU;
+        int8_t tx_power = s_full_tx_power;
+#if CONFIG_EXAMPLE_WIFI_COEX_THROTTLE
+        if (state == WIFI_COEX_AP_THROTTLED) {
+            beacon_interval = CONFIG_EXAMPLE_WIFI_COEX_BEACON_INTERVAL;
+            tx_power = CONFIG_EXAMPLE_WIFI_COEX_TX_POWER;
+        }
+#endif
+        /* fewer beacons leave more airtime to the A2DP link on the shared radio */
+        if (esp_wifi_get_config(WIFI_IF_AP, &cfg) == ESP_OK && cfg.ap.beacon_interval != beacon_interval) {
+            cfg.ap.beacon_interval = beacon_interval;
+            esp_wifi_set_config(WIFI_IF_AP, &cfg);
+        }
+        esp_wifi_set_max_tx_power(tx_power);
+    }
+
+    ESP_LOGI(WIFI_COEX_TAG, "soft-AP %s -> %s", s_ap_state_str[s_state], s_ap_state_str[state]);
+    s_state = state;
+}
+
+static void wifi_coex_task_handler(void *arg)
+{
+    bt_i2s_buffer_stats_t buf_stats;
+    int64_t last_ms = esp_timer_get_time() / 1000;
+    int64_t stable_since_ms = last_ms;
+    int64_t idle_since_ms = last_ms;
+    int64_t carry_ms = 0;
+    bool last_streaming = false;
+
+    bt_i2s_get_buffer_stats(&buf_stats);
+    uint32_t last_underflows = buf_stats.underflows;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WIFI_COEX_TICK_MS));
+        int64_t now_ms = esp_timer_get_time() / 1000;
+
+        /* charge time and underflows to the state they happened in */
+        bt_i2s_get_buffer_stats(&buf_stats);
+        carry_ms += now_ms - last_ms;
+        s_stats[s_state].seconds += carry_ms / 1000;
+        carry_ms %= 1000;
+        s_stats[s_state].underflows += buf_stats.underflows - last_underflows;
+        last_underflows = buf_stats.underflows;
+        last_ms = now_ms;
+
+        bool streaming = s_streaming;
+        if (streaming != last_streaming) {
+            last_streaming = streaming;
+            stable_since_ms = now_ms;
+        }
+        bool wake = s_wake_req;
+        s_wake_req = false;
+        if (wake || s_stations > 0) {
+            idle_since_ms = now_ms;
+        }
+#if CONFIG_EXAMPLE_WIFI_COEX_AP_IDLE_OFF_S == 0
+        (void)idle_since_ms;
+#endif
+
+        wifi_coex_ap_state_t target = s_state;
+        if (s_state == WIFI_COEX_AP_OFF) {
+            if (wake) {
+                target = wifi_coex_up_state(streaming);
+            }
+        } else {
+#if CONFIG_EXAMPLE_WIFI_COEX_AP_IDLE_OFF_S > 0
+            if (now_ms - idle_since_ms >= CONFIG_EXAMPLE_WIFI_COEX_AP_IDLE_OFF_S * 1000LL) {
+                target = WIFI_COEX_AP_OFF;
+            } else
+#endif
+            if (now_ms - stable_since_ms >= WIFI_COEX_HOLD_MS) {
+                target = wifi_coex_up_state(streaming);
+            }
+        }
+        if (target != s_state) {
+            wifi_coex_apply(target);
+        }
+    }
+}
+
+/********************************
+ * EXTERNAL FUNCTION DEFINITIONS
+ *******************************/
+
+void wifi_coex_start(void)
+{
+    if (s_coex_task_handle != NULL) {
+        return;
+    }
+    esp_wifi_get_max_tx_power(&s_full_tx_power);
+    esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_coex_event_handler, NULL);
+    xTaskCreate(wifi_coex_task_handler, "WifiCoexTask", 3072, NULL, 3, &s_coex_task_handle);
+}
+
+void wifi_coex_set_streaming(bool streaming)
+{
+    s_streaming = streaming;
+    if (s_coex_task_handle) {
+        xTaskNotifyGive(s_coex_task_handle);
+    }
+}
+
+void wifi_coex_wake(void)
+{
+    s_wake_req = true;
+    if (s_coex_task_handle) {
+        xTaskNotifyGive(s_coex_task_handle);
+    }
+}
+
+wifi_coex_ap_state_t wifi_coex_get_state(void)
+{
+    return s_state;
+}
+
+int wifi_coex_to_json(char *buf, size_t len)
+{
+    int n = snprintf(buf, len,
+                     "{\"state\":\"%s\",\"streaming\":%s,\"stations\":%d,"
+                     "\"full\":{\"seconds\":%" PRIu32 ",\"underflows\":%" PRIu32 "},"
+                     "\"throttled\":{\"seconds\":%" PRIu32 ",\"underflows\":%" PRIu32 "},"
+                     "\"off\":{\"seconds\":%" PRIu32 ",\"underflows\":%" PRIu32 "}}",
+                     s_ap_state_str[s_state], s_streaming ? "true" : "false", s_stations,
+                     s_stats[WIFI_COEX_AP_FULL].seconds, s_stats[WIFI_COEX_AP_FULL].underflows,
+                     s_stats[WIFI_COEX_AP_THROTTLED].seconds, s_stats[WIFI_COEX_AP_THROTTLED].underflows,
+                     s_stats[WIFI_COEX_AP_OFF].seconds, s_stats[WIFI_COEX_AP_OFF].underflows);
+    return (n < 0 || (size_t)n >= len) ? -1 : n;
+}
@@ -0,0 +1,61 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __WIFI_COEX_H__
+#define __WIFI_COEX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* log tag */
+#define WIFI_COEX_TAG    "WIFI_COEX"
+
+/* soft-AP states of the coexistence policy */
+typedef enum {
+    WIFI_COEX_AP_FULL = 0,     /*!< configured beacon interval and TX power */
+    WIFI_COEX_AP_THROTTLED,    /*!< long beacon interval, reduced TX power, slow state push */
+    WIFI_COEX_AP_OFF,          /*!< suspended until a button gesture */
+    WIFI_COEX_AP_MAX,
+} wifi_coex_ap_state_t;
+
+/**
+ * @brief  start the coexistence policy for a running soft-AP
+ *
+ *         Throttling and suspension are set by the EXAMPLE_WIFI_COEX_* options.
+ *         Ringbuffer underflows are attributed to the AP state they happened
+ *         in, so the cost of each state can be compared.
+ */
+void wifi_coex_start(void);
+
+/**
+ * @brief  tell the policy whether A2DP audio is streaming
+ *
+ * @param [in] streaming  true while the A2DP audio state is started
+ */
+void wifi_coex_set_streaming(bool streaming);
+
+/**
+ * @brief  user activity, restarts a suspended soft-AP and its idle timer
+ */
+void wifi_coex_wake(void);
+
+/**
+ * @brief  current soft-AP state
+ */
+wifi_coex_ap_state_t wifi_coex_get_state(void);
+
+/**
+ * @brief  serialise state, time and underflows per AP state as JSON
+ *
+ * @param [out] buf  output buffer
+ * @param [in]  len  output buffer size in byte
+ *
+ * @return  length of the JSON text, -1 if it does not fit
+ */
+int wifi_coex_to_json(char *buf, size_t len);
+
+#endif /* __WIFI_COEX_H__ */